@@ -21,7 +21,10 @@ limitations under the License.
 namespace tas
 {
 
-/// AES 128 encryption
+/** AES 128 encryption.
+  * Rounds by T-tables, on x86 processors with aes instructions
+  * 8 blocks are processed together, results are same.
+  */
 class TAA_LIB Aes
 {
 public:
@@ -52,16 +55,9 @@ private:
 	void encryptBlock(byte* block, uint keyn);
 	void decryptBlock(byte* block, uint keyn);
 
-	void addRoundKey(byte* block, byte* key);
-
-	void subBytes(byte* block);
-	void invSubBytes(byte* block);
-
-	void shiftRows(byte* block);
-	void invShiftRows(byte* block);
-
-	void mixColumns(byte* block);
-	void invMixColumns(byte* block);
+	/// encrypt, decrypt blocks with next key for each block
+	void encryptBlocks(byte* data, uint count, uint keyn);
+	void decryptBlocks(byte* data, uint count, uint keyn);
 
 	/// column transform for key expansion
 	uint tmColumn(uint column, byte rcon);
@@ -69,22 +65,25 @@ private:
 	byte* sbox; /// Non-linear substitution table
 	byte* rsbox; /// Inverse non-linear substitution table
 
-	/// 8 arrays of galois polynomial column by 256 uint
-	uint* ge0; /// encrypt column 0
-	uint* ge1;
-	uint* ge2;
-	uint* ge3;
+	/// 8 arrays of round transform column by 256 uint,
+	/// substitution, mix columns for each row of column
+	uint* te0; /// encrypt row 0
+	uint* te1;
+	uint* te2;
+	uint* te3;
 
-	uint* gd0; /// decrypt column 0
-	uint* gd1;
-	uint* gd2;
-	uint* gd3;
+	uint* td0; /// decrypt row 0
+	uint* td1;
+	uint* td2;
+	uint* td3;
 
 	byte* pnAes; /// penultimate ciphertext
 	byte* keyExp; /// each key expansion
+	byte* keyDec; /// each key expansion for decrypt, inverse mix columns
 	uint keyNum;
 	uint keySize; /// key expansion size
 
+	byte ni; /// aes instructions
 	byte round; /// count 10
 };
 
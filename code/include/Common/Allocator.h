@@ -26,6 +26,7 @@ limitations under the License.
  *  0x04 - memory alignment                                      *
  *  0x08 - memory pages for alloc, free                          *
  *  0x10 - winapi system alloc, free                             *
+ *  0x20 - memory pages per thread, size classes, remote free    *
  *                                                               *
  *  alloc table mode bit flags:                                  *
  *  0x01 - build list for single file ALLOC_FILE                 *
@@ -37,7 +38,8 @@ limitations under the License.
  *  0x40 - alloc info list for search memory leaks               *
  *                                                               *
  *  alloc mode:                                                  *
- *  0x09 - default, mem pages, text log                          *
+ *  0x09 - mem pages, text log                                  *
+ *  0x3D - default, mem pages per thread, text log, align        *
  *                                                               *
  *  alloc table mode:                                            *
  *  0x40 - info list for detect memory leak                      *
@@ -66,10 +68,28 @@ namespace tas
 typedef void* (*MemoryAlloc) (uint size);
 typedef void  (*MemoryFree)  (void* p);
 
+/** Allocate large block on 2 mb memory pages.
+  * Blocks from 2 mb use large pages when system allows it
+  * (MEM_LARGE_PAGES, MAP_HUGETLB, transparent huge pages),
+  * else ordinary pages. Smaller blocks use system heap.
+  * Available with and without TAA_ALLOCATOR.
+  * @param size Size in bytes.
+  * @return Memory block, aligned by 16 bytes, not initialised.
+  * @remark Throws BadAlloc if memory is not available.
+  */
+TAA_LIB void* allocatorLarge(uint_t size);
+
+/** Free block of allocatorLarge().
+  * @param p Memory block or null.
+  */
+TAA_LIB void allocatorLargeFree(void* p);
+
+#define safe_delete_large(p) (p ? (allocatorLargeFree(p), p = 0) : 0)
+
 #ifdef TAA_ALLOCATOR
 
 /// Alloc mode bit flags.
-#define ALLOCATOR_MODE 0x1D
+#define ALLOCATOR_MODE 0x3D
 #define ALLOCATOR_ALIGN 4
 
 TAA_LIB void allocatorInit();
@@ -81,6 +101,7 @@ TAA_LIB void allocatorPrintf(char* format, ...);
 TAA_LIB void allocatorSetLog(wchar_t* name);
 TAA_LIB void allocatorSetTableMode(uint mode);
 TAA_LIB void allocatorSetMemoryRoutines(MemoryAlloc memAlloc, MemoryFree memFree);
+TAA_LIB void allocatorThreadExit();
 
 void allocatorSetClientMemoryRoutines();
 
@@ -108,7 +129,10 @@ inline void allocatorGetMemorySize(char* page_size, char m = 0) {}
 /** Free memory. */
 inline void allocatorClean() {}
 
-/** Save alloc information to log. */
+/** Save alloc information to log.
+  * Counters of running threads are read without lock,
+  * exact after end of worker threads.
+  */
 inline void allocatorInfo() {}
 
 /** Print message to alloc log.
@@ -140,6 +164,12 @@ inline void allocatorSetMemoryRoutines(MemoryAlloc memAlloc, MemoryFree memFree)
   */
 inline void allocatorSetClientMemoryRoutines() {}
 
+/** Release memory pages of current thread for next thread.
+  * @remark Call before thread function returns, blocks allocated by thread stay valid.
+  * 		Mode 0x20 only.
+  */
+inline void allocatorThreadExit() {}
+
 #endif
 
 } /// namespace
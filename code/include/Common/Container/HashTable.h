@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <Common/Config.h>
 #include <Common/Bitwise.h>
+#include <Common/Allocator.h>
 
 namespace tas
 {
@@ -43,10 +44,15 @@ namespace tas
   * Table method find() check first 3 elements.
   * If item founded, return him with index,
   * else return null item with index -1.
+  *
+  * Table is accessed randomly, memory is allocated
+  * on large pages by allocatorLarge(), items are assigned
+  * without construction, type <T> must be plain data.
   */
 template<class T>
 class HashTable
 {
+	PLAIN_TYPE(T);
 	T* table;
 	uint sizen;
 public:
@@ -61,13 +67,35 @@ public:
 
 	~HashTable()
 	{
-		safe_delete_ao(table);
+		safe_delete_large(table);
 	}
 
 	void initialise(uint n)
 	{
-		table = new T[n];
+		safe_delete_large(table);
+		table = (T*) allocatorLarge((uint_t) n * sizeof(T));
 		sizen = n;
+		T item;
+		forn(n)
+		table[i] = item;
+	}
+
+	/// reset all items to null state without reallocate memory
+	void clear()
+	{
+		T item;
+		forn(sizen)
+		table[i] = item;
+	}
+
+	/// reset items of hash search positions to null state
+	void clear(uint hash)
+	{
+		uint start = hash % sizen;
+		uint msb = hash >> 8;
+		T item;
+		forn(3)
+		table[(start + i * msb) % sizen] = item;
 	}
 
 	uint size()
@@ -18,13 +18,19 @@ limitations under the License.
 
 #include <Common/Config.h>
 #include <Common/StringLib.h>
+#include <Common/Allocator.h>
 
 namespace tas
 {
 
+/** Ring buffer of plain data items.
+  * Memory is allocated by allocatorLarge(),
+  * large search buffers are placed on large pages.
+  */
 template<class T>
 class RingBuffer
 {
+	PLAIN_TYPE(T);
 public:
 	T*   buf; // buffer
 	uint bsz; // buffer size
@@ -43,7 +49,7 @@ public:
 
 	~RingBuffer()
 	{
-		safe_delete_array(buf);
+		safe_delete_large(buf);
 	}
 
 	RingBuffer& operator = (const RingBuffer& rb)
@@ -56,8 +62,8 @@ public:
 		if(rb.cnt > bsz)
 		{
 			bsz = rb.cnt;
-			safe_delete_array(buf);
-			buf = new T[bsz];
+			safe_delete_large(buf);
+			buf = (T*) allocatorLarge((uint_t) bsz * sizeof(T));
 			menset(buf, 0, bsz * sizeof(T));
 		}
 		RingBuffer& rbm = const_cast<RingBuffer&>(rb);
@@ -69,7 +75,7 @@ public:
 
 	RingBuffer& move(RingBuffer& rb)
 	{
-		safe_delete_array(buf);
+		safe_delete_large(buf);
 		buf = rb.buf;
 		bsz = rb.bsz;
 		beg = rb.beg;
@@ -83,24 +89,24 @@ public:
 
 	TAA_INLINE void clear()
 	{
-		safe_delete_array(buf);
+		safe_delete_large(buf);
 		reset();
 		bsz = 0;
 	}
 
 	TAA_INLINE void initialise(uint size)
 	{
-		safe_delete_array(buf);
+		safe_delete_large(buf);
 		bsz = size;
-		buf = new T[bsz];
+		buf = (T*) allocatorLarge((uint_t) bsz * sizeof(T));
 		menset(buf, 0, bsz * sizeof(T));
 	}
 
 	TAA_INLINE void resize(uint size)
 	{
-		T* inbuf = new T[size];
+		T* inbuf = (T*) allocatorLarge((uint_t) size * sizeof(T));
 		mencpy(inbuf, buf, bsz * sizeof(T));
-		safe_delete_array(buf);
+		safe_delete_large(buf);
 		buf = inbuf;
 		bsz = size;
 	}
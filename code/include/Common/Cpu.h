@@ -0,0 +1,55 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_Cpu_h_
+#define _TAH_Cpu_h_
+
+#include <Common/Config.h>
+
+// x86 intrinsics, used after runtime check of cpu features
+#if (defined(__i386__) or defined(__x86_64__) or defined(_M_IX86) or defined(_M_X64)) and \
+	(TAA_COMPILER == TAA_COMPILER_MSVC and TAA_COMP_VER >= 1600 or TAA_COMPILER == TAA_COMPILER_GNUC and TAA_COMP_VER >= 440)
+#define TAA_CPU_X86
+#endif
+
+// function compiled for instruction set, gcc only
+#if TAA_COMPILER == TAA_COMPILER_GNUC
+#define TAA_TARGET(t) __attribute__((target(t)))
+#else
+#define TAA_TARGET(t)
+#endif
+
+// cpu features
+#define CPU_SSE2  0x01
+#define CPU_CLMUL 0x02
+#define CPU_AES   0x04
+
+namespace tas
+{
+
+/** Processor features.
+  * @return Flags CPU_*, zero on not x86 processors.
+  * @remark Cpuid is read once.
+  */
+uint cpuFeatures();
+
+/** Time stamp counter of processor for short intervals.
+  * @return Cycles, zero on not x86 processors.
+  */
+wint cpuTicks();
+
+}
+
+#endif
@@ -21,6 +21,10 @@ limitations under the License.
 namespace tas
 {
 
+/** Crc-32, polynomial 0xEDB88320.
+  * Slicing by 16 bytes, on x86 with pclmulqdq folding by 64 bytes,
+  * selected at runtime, results are same.
+  */
 class Crc32
 {
 public:
@@ -37,8 +41,9 @@ public:
 	void reset();
 
 private:
-	uint* table;
+	uint* table; // 16 tables of 256
 	uint  crc;
+	byte  clmul;
 };
 
 }
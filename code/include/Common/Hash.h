@@ -25,6 +25,7 @@ TAA_LIB uint HashLy       (byte* str, uint len, uint hash = 0);
 TAA_LIB uint HashDjb      (byte* str, uint len);
 TAA_LIB uint HashMurmur2  (byte* key, uint len, uint seed);
 TAA_LIB uint HashMurmur2A (byte* key, uint len, uint seed);
+TAA_LIB wint HashMurmur64A(byte* key, uint len, wint seed);
 
 }
 
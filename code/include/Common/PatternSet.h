@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_PatternSet_h_
+#define _TAH_PatternSet_h_
+
+#include <Common/Config.h>
+#include <Common/StringArray.h>
+
+namespace tas
+{
+
+/** Set of name patterns compiled once for matching many names.
+  * Wildcard '*' is any characters, '?' is one character.
+  * Exact names in hash table, names with single '*' at end in prefix tree,
+  * other patterns in one NFA, all sets are checked by single pass over name.
+  */
+class PatternSet
+{
+public:
+
+	struct impl;
+	impl* _m;
+
+	PatternSet();
+	~PatternSet();
+
+	/** Compile patterns, previous patterns removed.
+	  * @param patterns Patterns, index of pattern is result of match().
+	  */
+	void compile(StringArray& patterns);
+
+	/** Match name with all patterns.
+	  * @param name Name, null terminated.
+	  * @return Least index of matched pattern, else -1.
+	  */
+	int match(const wchar_t* name);
+
+	/// count of patterns
+	uint size();
+};
+
+}
+
+#endif
@@ -48,6 +48,13 @@ limitations under the License.
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 
+// items in raw memory: copied by bytes, without destructor, checked by compiler
+#if TAA_COMPILER == TAA_COMPILER_MSVC && TAA_COMP_VER >= 1400 || TAA_COMPILER == TAA_COMPILER_GNUC && TAA_COMP_VER >= 430
+#define PLAIN_TYPE(T) typedef char plainType[__has_trivial_copy(T) && __has_trivial_assign(T) && __has_trivial_destructor(T) ? 1 : -1]
+#else
+#define PLAIN_TYPE(T) typedef char plainType
+#endif
+
 #define ALIGN_BYTE_PTR(p, n) ((char*)((uint_t)(p) + (n-1) & ~(n-1)))
 #define ALIGN_TYPE_PTR(t, p, n) ((t*)((uint_t)(p) + (n-1) & ~(n-1)))
 #define ALIGN_PTR(p, n) ((n) - ((uint_t)(p) & (n-1)))
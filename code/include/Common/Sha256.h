@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_Sha256_h_
+#define _TAH_Sha256_h_
+
+#include <Common/Config.h>
+
+namespace tas
+{
+
+/// The SHA-256 Secure Hash Algorithm, FIPS 180-4.
+class Sha256
+{
+public:
+
+	Sha256();
+	~Sha256();
+
+	/** Initialise message digest buffer. */
+	int initialise();
+
+	/** Calculate message digest.
+	  * @param block Message block data.
+	  * @param length Message block length in bytes.
+	  * @param end Last block in message.
+	  * @return Pointer to message digest array of 32 bytes.
+	  * @remark For not last input block length is multiple of 64 byte.
+	  */
+	byte* calculate(byte* block, uint length, byte end);
+
+	/** Retrieve last message digest. */
+	byte* getDigest();
+
+private:
+
+	/// compress one 64 byte block to state
+	void transform(byte* block);
+
+	uint state[8];
+	byte digest[32]; /// result, buffer, not string
+	wint total;      /// total message length in bytes
+};
+
+}
+
+#endif
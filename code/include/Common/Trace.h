@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_Trace_h_
+#define _TAH_Trace_h_
+
+#include <Common/Config.h>
+#include <Common/String.h>
+
+// events of timeline, only flag checked if trace not started
+#define TRACE_BEGIN(name, cat, arg) do { if(tas::traceEnabled) tas::traceEvent('B', name, cat, arg); } while(0)
+#define TRACE_END(name, cat, arg)   do { if(tas::traceEnabled) tas::traceEvent('E', name, cat, arg); } while(0)
+#define TRACE_SPAN(name, cat, duration, arg) do { if(tas::traceEnabled) tas::traceSpan(name, cat, duration, arg); } while(0)
+
+namespace tas
+{
+
+/// events recorded
+extern TAA_LIB byte traceEnabled;
+
+/** Start recording of events, previous events removed.
+  * Each thread records to own ring buffer, allocated by first event,
+  * oldest events of thread overwritten if buffer is full.
+  * @param events Size of ring buffer of thread, zero is 64k events.
+  */
+TAA_LIB void traceStart(uint events);
+
+/** Stop recording, events kept for traceSave.
+  */
+TAA_LIB void traceStop();
+
+/** Add event of current thread.
+  * @param phase 'B' begin, 'E' end.
+  * @param name, cat Static strings of event name and category.
+  * @param arg Value of event, bytes or index.
+  */
+TAA_LIB void traceEvent(byte phase, const char* name, const char* cat, wint arg);
+
+/** Add complete event of interval ended now.
+  * @param duration Microseconds of interval.
+  */
+TAA_LIB void traceSpan(const char* name, const char* cat, wint duration, wint arg);
+
+/** Save events in Chrome trace JSON format, for trace viewers.
+  * @remark Called after stop or while other threads not record.
+  * @return 1 success else 0.
+  */
+TAA_LIB int traceSave(const String& name);
+
+/** Free buffers of threads.
+  */
+TAA_LIB void traceClear();
+
+/** Begin event by constructor, end event by end() or destructor,
+  * so interval ends also by return from scope.
+  */
+struct TraceScope
+{
+	const char* name;
+	const char* cat;
+	wint arg;
+	byte active; // begin recorded, end not yet
+
+	TraceScope(const char* _name, const char* _cat, wint _arg)
+	{
+		name = _name;
+		cat = _cat;
+		arg = _arg;
+		active = traceEnabled;
+		if(active)
+			traceEvent('B', name, cat, arg);
+	}
+
+	~TraceScope()
+	{
+		end();
+	}
+
+	void end()
+	{
+		if(active and traceEnabled)
+			traceEvent('E', name, cat, arg);
+		active = 0;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_ArchiveStream_h_
+#define _TAH_ArchiveStream_h_
+
+#include <Common/Config.h>
+#include <Common/String.h>
+
+namespace tas
+{
+
+class FileStream;
+
+/** Stream container for pipelines, source and destination without seek.
+  * Data by frames of dictionary size, each frame coded by own coder,
+  * frame with size of compressed data before it, size and crc-32
+  * of all data in trailer after last frame.
+  */
+class TAA_LIB ArchiveStream
+{
+public:
+	ArchiveStream();
+	~ArchiveStream();
+
+	/** Compress source to end.
+	  * @param src Source stream, read only.
+	  * @param dst Destination stream, write only.
+	  * @return 1 success else 0.
+	  */
+	int compress(FileStream& src, FileStream& dst);
+
+	/** Uncompress stream to end of trailer.
+	  * @param src Compressed stream, read only.
+	  * @param dst Destination stream, write only.
+	  * @return 1 success else 0.
+	  */
+	int uncompress(FileStream& src, FileStream& dst);
+
+	/** Set compression parameters, types same as for Archive.
+	  * 0 method, 1 level, 2 threads, 3 dictionary, 4 word,
+	  * 5 cycles, 9 minimum match, 15 suffix, 20 rolz, 21 cmix.
+	  */
+	void setValue(uint_t value, byte type);
+
+	/** Return type of last error.
+	  */
+	byte getError();
+
+	/** Return last error description.
+	  */
+	String getErrorStr();
+
+private:
+	struct impl;
+	impl* _m;
+};
+
+}
+
+#endif
@@ -21,7 +21,13 @@ limitations under the License.
 namespace tas
 {
 
-/// Replace often two bytes sequences by single not using bytes
+/** Replace often n-grams by single not using bytes.
+  * Source is split to blocks of 1 mb, each block have own rules
+  * in head before block data, so stream is coded in single pass.
+  * Rules are built by Re-Pair: most frequent pair of symbols is
+  * replaced by new symbol again and again, pairs are taken from
+  * priority queue and replaced over occurrence lists, time O(n).
+  */
 class BigraphCoder: public ICoder
 {
 public:
@@ -33,18 +39,26 @@ public:
 	~BigraphCoder();
 
 	/** Initialisation.
-	  * @param mode Process mode, 1 parsing, 2 compress, 3 uncompress.
+	  * @param mode Process mode, 1 compress, 2 uncompress.
+	  * @param format Stream format, 2 blocks of n-gram rules,
+	  *    1 blocks of pairs, 0 single table at begin of stream,
+	  *    formats 0, 1 from old archives, uncompress only.
 	  * @return Positive value.
 	  */
-	int initialise(byte mode);
+	int initialise(byte mode, byte format = 2);
 
-	/** Parsing, compress, uncompress memory blocks.
+	/** Memory of coder buffers.
+	  * @param mode Process mode, 1 compress, 2 uncompress.
+	  * @return Size in bytes.
+	  */
+	static wint memory(byte mode);
+
+	/** Compress, uncompress memory blocks.
 	  * @param sm[in, out] Source, destination data.
 	  * @param flush Data to out stream.
 	  * @return See return codes in ICoder.h
 	  * @remark Destination size must be not less than 4 KB
 	  */
-	int parsing     (CoderStream* sm, byte flush);
 	int compress    (CoderStream* sm, byte flush);
 	int uncompress  (CoderStream* sm, byte flush);
 };
@@ -32,6 +32,7 @@ public:
 
 	void initialise(byte range);
 	void initialiseDecoder();
+	void reset(); /// range bounds of new stream
 	void flush();
 
 	void encodeBit(uint freq0, byte bit);
@@ -0,0 +1,156 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_BitHistory_h_
+#define _TAH_BitHistory_h_
+
+#include <Common/Config.h>
+
+namespace tas
+{
+
+/** Bit history state machine.
+  *
+  * Each state is one byte and represent pair of counts (n0, n1),
+  * updated by same rule as byte counters: increment count of
+  * coded bit, halve opposite count if greater than 2.
+  * Counts are limited, all reachable pairs take less than 256 states.
+  * State 0 is empty history (0, 0).
+  */
+class StateTable
+{
+public:
+	/// Build tables once, calls from other threads wait for end of build.
+	static void initialise();
+
+	/// Next state after bit y.
+	static byte next(byte state, byte y)
+	{
+		return table[state][y];
+	}
+
+	/// Count of y bits in state.
+	static byte count(byte state, byte y)
+	{
+		return table[state][2 + y];
+	}
+
+	/// Logistic ln(p / (1 - p)) * 256, p 16 bits, result [-2047, 2047].
+	static int stretch(uint p)
+	{
+		return stretchTable[p >> 4];
+	}
+
+	/// Inverse of stretch, result probability 16 bits.
+	static uint squash(int d)
+	{
+		if(d > 2047) d = 2047;
+		if(d < -2047) d = -2047;
+		int w = d & 127;
+		d = (d >> 7) + 16;
+		return (squashTable[d] * (128 - w) + squashTable[d + 1] * w + 64 >> 7) << 4;
+	}
+
+	/// next 0, next 1, n0, n1
+	static byte table[256][4];
+	static byte states;
+
+	static short stretchTable[4096];
+	static const short squashTable[33];
+};
+
+/// Hash table slot: bit history and hash check byte
+struct StateCounter
+{
+	byte state;
+	byte ch; // upper 8 bits of hash
+
+	StateCounter()
+	{
+		state = 0;
+		ch = 0;
+	}
+
+	void reset(byte _ch = 0)
+	{
+		state = 0;
+		ch = _ch;
+	}
+
+	/// update y bit
+	void update(byte y)
+	{
+		state = StateTable::next(state, y);
+	}
+
+	uint priority()
+	{
+		return StateTable::count(state, 0) + StateTable::count(state, 1);
+	}
+
+	uint checksum()
+	{
+		return ch;
+	}
+};
+
+/** Adaptive probability map, state to probability of 1 bit.
+  * Each context order have own map of 256 states.
+  * Probability starts from state counts and adapts
+  * with rate 1 / (n + 1.5), n limited by 255.
+  */
+class StateMap
+{
+public:
+	StateMap();
+	~StateMap();
+
+	/** Initialise maps.
+	  * @param n Maps count.
+	  */
+	void initialise(uint n);
+
+	/// Initial probabilities of all maps, memory kept.
+	void reset();
+
+	/// Probability 1 bit, 16 bits precision.
+	uint p(uint map, byte state)
+	{
+		return table[map << 8 | state] >> 16;
+	}
+
+	/// update y bit
+	void update(uint map, byte state, byte y)
+	{
+		uint& t = table[map << 8 | state];
+		uint n = t & 0xFF;
+		uint p = t >> 10;
+		if(n < 255)
+			t++;
+		if(y)
+			t += ((0x400000 - p >> 6) * reciprocal[n] >> 10) << 10;
+		else
+			t -= ((p >> 6) * reciprocal[n] >> 10) << 10;
+	}
+
+private:
+	uint* table; // probability high 22 bits, count low 8 bits
+	uint maps;
+	uint reciprocal[256]; // 65536 / (n + 1.5)
+};
+
+}
+
+#endif
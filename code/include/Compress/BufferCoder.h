@@ -0,0 +1,95 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_BufferCoder_h_
+#define _TAH_BufferCoder_h_
+
+#include <Common/Config.h>
+
+namespace tas
+{
+
+struct BufferParameters;
+
+/** Compression of memory buffers.
+  * Compressed buffer is header of 16 bytes with coder parameters
+  * and data size, then coded data, data not compressed is stored.
+  * Context keeps coder with tables between buffers of same parameters,
+  * coder is reset instead of new initialisation, one context for one thread.
+  */
+class TAA_LIB BufferCoder
+{
+public:
+
+	struct impl;
+	impl* _m;
+
+	BufferCoder();
+	~BufferCoder();
+
+	/** Maximum compressed size.
+	  * @param size Data size.
+	  */
+	static uint compressBound(uint size);
+
+	/** Compress buffer by temporary context.
+	  * @param params Coder parameters, see BufferParameters.
+	  * @return Compressed size, 0 if destination small or error.
+	  */
+	static uint compress(byte* src, uint size, byte* dst, uint dstSize, BufferParameters* params);
+
+	/** Uncompress buffer by temporary context.
+	  * @return Data size, MAX_UINT32 if destination small or buffer damaged.
+	  */
+	static uint uncompress(byte* src, uint size, byte* dst, uint dstSize);
+
+	/** Data size of compressed buffer.
+	  * @return Data size, MAX_UINT32 if buffer not recognized.
+	  */
+	static uint dataSize(byte* src, uint size);
+
+	/** Parameters of context compression, encoder created here,
+	  * reset for each next buffer of compressBuffer().
+	  * @param params[in, out] Coder parameters, effective values of encoder
+	  * after call, method 0 if method not supported.
+	  */
+	void initialise(BufferParameters* params);
+
+	/** Compress buffer by context, see compress().
+	  */
+	uint compressBuffer(byte* src, uint size, byte* dst, uint dstSize);
+
+	/** Uncompress buffer by context, coder kept for buffers of same parameters,
+	  * see uncompress().
+	  */
+	uint uncompressBuffer(byte* src, uint size, byte* dst, uint dstSize);
+};
+
+/// Parameters of buffer coder, zero values are defaults of level.
+struct BufferParameters
+{
+	BufferParameters();
+	byte method;     // 0 copy, 1 LZRE, 2 CM
+	byte level;      // [1, 9]
+	uint dictionary; // LZRE [64 kb, 256 mb], CM [64 kb, 16 mb]
+	byte minMatch;   // LZRE [2, 8]
+	half maxMatch;   // LZRE [32, 1024], CM context [4, 8]
+	half rolz;       // LZRE [16, 256]
+	byte cmix;       // LZRE context mixing of literals
+};
+
+}
+
+#endif
@@ -40,10 +40,24 @@ public:
 	  *    dictionary[in, out] Hash table size [64 kb, 16 mb].
 	  *    context[in, out] Context length [4, 8].
 	  *    level Level compression, speed [1, 9] quality.
+	  *    history Bit history states counters, enable by 1, else byte counts.
+	  *    size Uncompressed size, if zero decoder read it from first 8 bytes of stream.
 	  * @return Positive value.
 	  */
 	int initialise(CmParameters* params);
 
+	/** Coder state of new stream after initialisation with same parameters,
+	  * tables are cleared without reallocation.
+	  * @param size Uncompressed size, if zero decoder read it from stream.
+	  */
+	void reset(wint size);
+
+	/** Memory of coder tables for parameters, before initialisation.
+	  * @param params Coder parameters, same as for initialise().
+	  * @return Size in bytes.
+	  */
+	static wint memory(CmParameters* params);
+
 	/** CM compress, uncompress memory blocks.
 	  * @param sm[in, out] Source, destination data.
 	  * @param flush Data to out stream.
@@ -61,6 +75,8 @@ struct CmParameters
 	uint dictionary;
 	byte context;
 	byte level;
+	byte history;
+	wint size;
 };
 
 }
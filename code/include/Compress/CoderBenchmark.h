@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_CoderBenchmark_h_
+#define _TAH_CoderBenchmark_h_
+
+#include <Common/Config.h>
+#include <Common/String.h>
+
+namespace tas
+{
+
+struct BenchmarkResult;
+
+/** Speed of coders in memory, without files and crc.
+  * Data is loaded or generated once, then each run compress it
+  * by coder of method, level and threads, uncompress and compare.
+  * Runs are LZRE and CM levels, LZRE threads, Bigraph preprocessor.
+  */
+class TAA_LIB CoderBenchmark
+{
+public:
+	CoderBenchmark();
+	~CoderBenchmark();
+
+	/** Load data of runs from file.
+	  * @param name File name, data over 256 mb is not loaded.
+	  * @return 1 success else 0.
+	  */
+	int load(const String& name);
+
+	/** Generate data of runs, text lines and binary records.
+	  * @param size Data size.
+	  */
+	void generate(uint size);
+
+	/** Set run parameters, types same as for Archive, zero value runs all.
+	  * 0 method, 1 level, 2 threads, 3 dictionary, 16 bigraph, 21 cmix.
+	  * Bigraph runs with method only if set.
+	  */
+	void setValue(uint_t value, byte type);
+
+	/** Count of runs for parameters.
+	  */
+	uint count();
+
+	/** Compress and uncompress data by coder of run.
+	  * @param index Run [0, count()).
+	  * @param result[out] Sizes, times and check of run.
+	  * @return 1 success else 0, error of coder.
+	  */
+	int run(uint index, BenchmarkResult& result);
+
+	/** Return type of last error.
+	  */
+	byte getError();
+
+	/** Return last error description.
+	  */
+	String getErrorStr();
+
+private:
+	struct impl;
+	impl* _m;
+};
+
+/// Result of benchmark run.
+struct BenchmarkResult
+{
+	BenchmarkResult();
+	byte method;         // 1 LZRE, 2 CM, 3 Bigraph
+	byte level;
+	byte threads;
+	uint size;           // data size
+	uint packedSize;     // compressed size
+	wint compressTime;   // microseconds
+	wint uncompressTime; // microseconds
+	wint memory;         // coder tables of compression, bytes
+	byte valid;          // uncompressed data same as source
+};
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_CoderFactory_h_
+#define _TAH_CoderFactory_h_
+
+#include <Common/Config.h>
+#include <Compress/ICoder.h>
+
+// new data always modeled by bit history states,
+// byte counts only in data of old versions
+#define CODER_HISTORY 1
+
+namespace tas
+{
+
+/** Parameters of coder of any method, in, out values as in
+  * LzreParameters and CmParameters, unused by method ignored.
+  */
+struct TAA_LIB CoderParameters
+{
+	CoderParameters();
+	byte method;     // 1 lzre, 2 cm
+	byte mode;       // 1 compress, 2 uncompress
+	uint dictionary; // bytes
+	byte minMatch;
+	half maxMatch;   // lzre maximum match, cm context length
+	byte level;
+	half cycles;
+	half rolz;
+	byte suffix;
+	byte threads;
+	byte cmix;
+	byte history;
+	uint window;
+	wint size;       // cm uncompressed size, zero if in stream
+};
+
+/** Coder of method, parameters updated by coder initialisation.
+  * @return Coder, 0 if method not supported by build.
+  */
+TAA_LIB ICoder* createCoder(CoderParameters* params);
+
+/** Memory of coder tables for parameters, before initialisation.
+  * @return Size in bytes, 0 if method not supported.
+  */
+TAA_LIB wint coderMemory(CoderParameters* params);
+
+}
+
+#endif
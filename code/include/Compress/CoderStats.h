@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_CoderStats_h_
+#define _TAH_CoderStats_h_
+
+#include <Common/Config.h>
+
+// stages of archive job
+#define STAGE_READ   0 // files, archive read
+#define STAGE_CRC    1
+#define STAGE_FILTER 2 // exe, delta filters and bigraph
+#define STAGE_MATCH  3 // match finding of lzre
+#define STAGE_CODE   4 // entropy coding
+#define STAGE_CRYPT  5
+#define STAGE_WRITE  6 // archive, files write
+#define STAGE_COUNT  7
+
+namespace tas
+{
+
+/** Time and counters of archive job by stages.
+  * Stage times are measured by blocks, coder time is split to
+  * match finding and entropy coding by cycles of sampled codes.
+  * LZRE counts codes by type and dictionary searches.
+  */
+struct TAA_LIB CoderStats
+{
+	CoderStats();
+
+	wint time[STAGE_COUNT];  // microseconds
+	wint bytes[STAGE_COUNT]; // input bytes of stage
+	wint codes[5];           // lzre literal, match, repeat, rolz, long
+	wint lookups;            // lzre dictionary searches
+	wint hits;               // searches with found prefix
+	wint cycles[2];          // sampled cycles of match finding, entropy coding
+
+	/// zero all values
+	void reset();
+
+	/// move part of coding time to match finding by sampled cycles
+	void splitCoderTime();
+
+	/// name of stage in json and trace
+	static const char* stageName(uint stage);
+
+	/** Values as json object.
+	  * @param dst Text buffer of 1 kb.
+	  * @return Text length.
+	  */
+	uint json(char* dst);
+};
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_DeltaFilter_h_
+#define _TAH_DeltaFilter_h_
+
+#include <Common/Config.h>
+
+// maximum distance between bytes of same field
+#define DELTA_STRIDE_MAX 32
+
+namespace tas
+{
+
+/** Delta of records with fixed size before compression.
+  * Byte is replaced by difference with byte one stride before,
+  * columns of tables, samples of audio, pixels of images
+  * become small values with less entropy.
+  */
+class DeltaFilter
+{
+public:
+	DeltaFilter();
+	~DeltaFilter();
+
+	/** Find stride by entropy of differences in begin of file.
+	  * @param data First block of file.
+	  * @return Stride [1, 32], 0 if data is not records.
+	  */
+	static byte detect(byte* data, uint size);
+
+	/** Start of file.
+	  * @param mode Process mode, 1 encode, 2 decode.
+	  * @param stride Distance between bytes of same field.
+	  */
+	void reset(byte mode, byte stride);
+
+	/// convert data in place, continue previous data, any size
+	void process(byte* data, uint size);
+
+private:
+	byte history[DELTA_STRIDE_MAX]; // last stride bytes of source data
+	byte index;  // history position
+	byte stride;
+	byte mode;   // process mode
+};
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _TAH_ExeFilter_h_
+#define _TAH_ExeFilter_h_
+
+#include <Common/Config.h>
+
+namespace tas
+{
+
+/** Branch conversion of x86, x64 code before compression.
+  * Relative targets of call E8 and jump E9 are replaced by absolute
+  * by position in file, so calls of same function are same bytes.
+  * Displacement in range 2^24 only, result stays in the range,
+  * decoder finds same instructions. File is processed by segments
+  * of 64 kb from begin, instruction over segment end not converted.
+  */
+class ExeFilter
+{
+public:
+	ExeFilter();
+	~ExeFilter();
+
+	/** Test begin of file for executable of x86, x64:
+	  * ELF, PE, Mach-O headers.
+	  * @param data First block of file.
+	  * @return 1 executable, else 0.
+	  */
+	static byte detect(byte* data, uint size);
+
+	/** Start of file.
+	  * @param mode Process mode, 1 encode, 2 decode.
+	  */
+	void reset(byte mode);
+
+	/** Convert data in place, position in file after previous data.
+	  * @remark Size multiple of 64 kb except last data of file,
+	  * each call starts scan at segment begin, so encoder and decoder
+	  * get same result only with data split by segments.
+	  */
+	void process(byte* data, uint size);
+
+private:
+	wint pos;  // file position
+	byte mode; // process mode
+};
+
+}
+
+#endif
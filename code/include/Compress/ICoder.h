@@ -54,6 +54,8 @@ struct CoderStream
 	}
 };
 
+struct CoderStats;
+
 /// Base interface for coder.
 class ICoder
 {
@@ -66,6 +68,11 @@ public:
 	virtual int compress    (CoderStream* sm, byte flush) = 0;
 	virtual int uncompress  (CoderStream* sm, byte flush) = 0;
 
+	/** Counters of coder added to stats, coder without counters ignore it.
+	  * @param stats Stats of job or 0 for disable.
+	  */
+	virtual void setStats(CoderStats* stats) {}
+
 	virtual ~ICoder() {}
 };
 
@@ -46,10 +46,24 @@ public:
 	  *    suffix Maximum count suffix nodes in search tree [1, 128].
 	  *    threads[in, out] Compression threads number [1, 2].
 	  *    cmix Context mixing state, enable by 1, else disable.
+	  *    history Context mixing by bit history states, enable by 1, else byte counts.
+	  *    window[in, out] Long matches window above dictionary [dictionary, 1 gb], 0 disable.
 	  * @return Positive value.
 	  */
 	int initialise(LzreParameters* params);
 
+	/** Coder state of new stream after initialisation with same parameters.
+	  * Tables are cleared without reallocation, for short streams
+	  * only positions written by previous stream.
+	  */
+	void reset();
+
+	/** Memory of coder tables for parameters, before initialisation.
+	  * @param params Coder parameters, same as for initialise().
+	  * @return Size in bytes.
+	  */
+	static wint memory(LzreParameters* params);
+
 	/** LZRE compress, uncompress memory blocks.
 	  * @param sm[in, out] Source, destination data.
 	  * @param flush Data to out stream.
@@ -58,6 +72,11 @@ public:
 	  */
 	int compress   (CoderStream* sm, byte flush);
 	int uncompress (CoderStream* sm, byte flush);
+
+	/** Encoder counts codes by type, dictionary searches
+	  * and cycles of sampled codes, see CoderStats.
+	  */
+	void setStats(CoderStats* stats);
 };
 
 /// LZRE coder parameters
@@ -74,6 +93,8 @@ struct LzreParameters
 	byte suffix;
 	byte threads;
 	byte cmix;
+	byte history;
+	uint window;
 };
 
 }
@@ -16,6 +16,12 @@ limitations under the License.
 #include <Common/Aes.h>
 #include <Common/Math.h>
 #include <Common/StringLib.h>
+#include <Common/Cpu.h>
+
+#ifdef TAA_CPU_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
 
 namespace tas
 {
@@ -24,19 +30,22 @@ Aes::Aes()
 {
 	round = 10;
 	keyExp = 0;
+	keyDec = 0;
 	keyNum = 0;
+	keySize = 0;
+	ni = (cpuFeatures() & (CPU_SSE2 | CPU_AES)) == (CPU_SSE2 | CPU_AES);
 
-	ge0 = (uint*) (new byte[8736]);
-	ge1 = ge0 + 256;
-	ge2 = ge1 + 256;
-	ge3 = ge2 + 256;
+	te0 = (uint*) (new byte[8736]);
+	te1 = te0 + 256;
+	te2 = te1 + 256;
+	te3 = te2 + 256;
 
-	gd0 = ge3 + 256;
-	gd1 = gd0 + 256;
-	gd2 = gd1 + 256;
-	gd3 = gd2 + 256;
+	td0 = te3 + 256;
+	td1 = td0 + 256;
+	td2 = td1 + 256;
+	td3 = td2 + 256;
 
-	sbox = (byte*) (gd3 + 256);
+	sbox = (byte*) (td3 + 256);
 	rsbox = sbox + 256;
 	pnAes = rsbox + 256;
 
@@ -68,39 +77,44 @@ Aes::Aes()
 		rsbox[sbox[i]] = i;
 	}
 
-	// 8 tables of galois polynomial column by 256 uint
+	// 8 tables of galois polynomial column by 256 uint,
+	// byte substituted before multiply
 	forn(256)
 	{
 #define xtime(x) ((x << 1) ^ (((x & 0x80) != 0) * 0x1B))
-#define UI(p0, p1, p2, p3) (p0 | p1 << 8 | p2 << 16 | p3 << 24)
+#define UI(p0, p1, p2, p3) ((uint)p0 | p1 << 8 | p2 << 16 | (uint)p3 << 24)
 
-		byte p1 = i;
+		byte p1 = sbox[i];
 		byte p2 = xtime(p1);
+		byte p3 = p2 ^ p1;
+
+		te0[i] = UI(p2, p1, p1, p3);
+		te1[i] = UI(p3, p2, p1, p1);
+		te2[i] = UI(p1, p3, p2, p1);
+		te3[i] = UI(p1, p1, p3, p2);
+
+		p1 = rsbox[i];
+		p2 = xtime(p1);
 		byte p4 = xtime(p2);
 		byte p8 = xtime(p4);
 
-		byte p3  = p2 ^ p1;
 		byte p09 = p8 ^ p1;
 		byte p11 = p8 ^ p2 ^ p1;
 		byte p13 = p8 ^ p4 ^ p1;
 		byte p14 = p8 ^ p4 ^ p2;
 
-		ge0[i] = UI(p2, p1, p1, p3);
-		ge1[i] = UI(p3, p2, p1, p1);
-		ge2[i] = UI(p1, p3, p2, p1);
-		ge3[i] = UI(p1, p1, p3, p2);
-
-		gd0[i] = UI(p14, p09, p13, p11);
-		gd1[i] = UI(p11, p14, p09, p13);
-		gd2[i] = UI(p13, p11, p14, p09);
-		gd3[i] = UI(p09, p13, p11, p14);
+		td0[i] = UI(p14, p09, p13, p11);
+		td1[i] = UI(p11, p14, p09, p13);
+		td2[i] = UI(p13, p11, p14, p09);
+		td3[i] = UI(p09, p13, p11, p14);
 	}
 }
 
 Aes::~Aes()
 {
-	safe_delete_array(ge0);
+	safe_delete_array(te0);
 	safe_delete_array(keyExp);
+	safe_delete_array(keyDec);
 }
 
 void Aes::encrypt(byte* data, uint size, uint pos)
@@ -110,46 +124,24 @@ void Aes::encrypt(byte* data, uint size, uint pos)
 	byte mod = size % 16;
 	// key index
 	uint keyn = (pos / 16) % keyNum;
-	if(mod) // ciphertext stealing
-	{
-		blockCount++;
-		goto aesmod;
-	}
 
-	forn(blockCount)
-	{
-		encryptBlock(data, keyn);
-		data += 16;
-		keyn = (keyn + 1) % keyNum;
-	}
-	return;
+	encryptBlocks(data, blockCount, keyn);
 
-aesmod:
-	forn(blockCount)
+	// ciphertext stealing, last part encrypted with penultimate
+	// ciphertext and takes its head
+	if(mod)
 	{
-		if(!mod or i != blockCount-1)
-			encryptBlock(data, keyn);
-
-		if(mod)
+		byte* pnd = data + (blockCount - 1) * 16;
+		byte* last = pnd + 16;
+		keyn = (keyn + blockCount) % keyNum;
+		form(u, mod)
 		{
-			if(i == blockCount-2) // penultimate
-			{
-				form(u, mod)
-				pnAes[u] = data[u];
-			}
-			else if(i == blockCount-1) // last
-			{
-				byte* pnd = data - 16;
-				form(u, mod)
-				pnd[u] = data[u];
-				encryptBlock(pnd, keyn);
-				// copy penultimate ciphertext to last block
-				form(u, mod)
-				data[u] = pnAes[u];
-			}
+			pnAes[u] = pnd[u];
+			pnd[u] = last[u];
 		}
-		data += 16;
-		keyn = (keyn + 1) % keyNum;
+		encryptBlock(pnd, keyn);
+		form(u, mod)
+		last[u] = pnAes[u];
 	}
 }
 
@@ -160,91 +152,188 @@ void Aes::decrypt(byte* data, uint size, uint pos)
 	byte mod = size % 16;
 	// key index
 	uint keyn = (pos / 16) % keyNum;
-	if(mod) // ciphertext stealing
+
+	if(!mod)
 	{
-		blockCount++;
-		goto aesmod;
+		decryptBlocks(data, blockCount, keyn);
+		return;
 	}
 
-	forn(blockCount)
+	// ciphertext stealing, penultimate block was encrypted
+	// last, with key of last block
+	decryptBlocks(data, blockCount - 1, keyn);
+	byte* pnd = data + (blockCount - 1) * 16;
+	byte* last = pnd + 16;
+	keyn = (keyn + blockCount - 1) % keyNum;
+	decryptBlock(pnd, (keyn + 1) % keyNum);
+	form(u, mod)
 	{
-		decryptBlock(data, keyn);
-		data += 16;
-		keyn = (keyn + 1) % keyNum;
+		pnAes[u] = pnd[u];
+		pnd[u] = last[u];
 	}
-	return;
+	decryptBlock(pnd, keyn);
+	form(u, mod)
+	last[u] = pnAes[u];
+}
 
-aesmod:
-	forn(blockCount)
-	{
-		if(mod and i == blockCount-2)
-			keyn = (keyn + 1) % keyNum;
+#ifdef TAA_CPU_X86
+// blocks in flight
+#define AES_NI_BLOCKS 8
 
-		if(!mod or i != blockCount-1)
-			decryptBlock(data, keyn);
+TAA_TARGET("sse2,aes")
+static void aesniEncrypt(byte* data, uint count, byte* keyExp, uint keySize,
+	uint keyNum, uint keyn, byte round)
+{
+	__m128i b[AES_NI_BLOCKS];
+	byte* k[AES_NI_BLOCKS];
+	while(count)
+	{
+		uint n = MIN(count, AES_NI_BLOCKS);
+		forn(n)
+		{
+			k[i] = keyExp + keyn * keySize;
+			keyn = keyn + 1 == keyNum ? 0 : keyn + 1;
+			b[i] = _mm_xor_si128(_mm_loadu_si128((__m128i*)(data + i * 16)), _mm_loadu_si128((__m128i*)k[i]));
+		}
+		form(r, round - 1)
+		{
+			forn(n)
+			b[i] = _mm_aesenc_si128(b[i], _mm_loadu_si128((__m128i*)(k[i] + r * 16 + 16)));
+		}
+		forn(n)
+		{
+			b[i] = _mm_aesenclast_si128(b[i], _mm_loadu_si128((__m128i*)(k[i] + round * 16)));
+			_mm_storeu_si128((__m128i*)(data + i * 16), b[i]);
+		}
+		data += n * 16;
+		count -= n;
+	}
+}
 
-		if(mod)
+TAA_TARGET("sse2,aes")
+static void aesniDecrypt(byte* data, uint count, byte* keyDec, uint keySize,
+	uint keyNum, uint keyn, byte round)
+{
+	__m128i b[AES_NI_BLOCKS];
+	byte* k[AES_NI_BLOCKS];
+	while(count)
+	{
+		uint n = MIN(count, AES_NI_BLOCKS);
+		forn(n)
 		{
-			if(i == blockCount-2) // penultimate, last ciphertext
-			{
-				form(u, mod)
-				pnAes[u] = data[u];
-			}
-			else if(i == blockCount-1) // last, penultimate ciphertext
-			{
-				keyn = keyn == 0 ? keyNum-1 : keyn-1;
-				byte* pnd = data - 16;
-				form(u, mod)
-				pnd[u] = data[u];
-				decryptBlock(pnd, keyn);
-				// copy penultimate ciphertext to last block
-				form(u, mod)
-				data[u] = pnAes[u];
-			}
+			k[i] = keyDec + keyn * keySize;
+			keyn = keyn + 1 == keyNum ? 0 : keyn + 1;
+			b[i] = _mm_xor_si128(_mm_loadu_si128((__m128i*)(data + i * 16)), _mm_loadu_si128((__m128i*)k[i]));
+		}
+		form(r, round - 1)
+		{
+			forn(n)
+			b[i] = _mm_aesdec_si128(b[i], _mm_loadu_si128((__m128i*)(k[i] + r * 16 + 16)));
+		}
+		forn(n)
+		{
+			b[i] = _mm_aesdeclast_si128(b[i], _mm_loadu_si128((__m128i*)(k[i] + round * 16)));
+			_mm_storeu_si128((__m128i*)(data + i * 16), b[i]);
 		}
+		data += n * 16;
+		count -= n;
+	}
+}
+#endif
+
+void Aes::encryptBlocks(byte* data, uint count, uint keyn)
+{
+#ifdef TAA_CPU_X86
+	if(ni)
+	{
+		aesniEncrypt(data, count, keyExp, keySize, keyNum, keyn, round);
+		return;
+	}
+#endif
+	forn(count)
+	{
+		encryptBlock(data, keyn);
+		data += 16;
+		keyn = keyn + 1 == keyNum ? 0 : keyn + 1;
+	}
+}
+
+void Aes::decryptBlocks(byte* data, uint count, uint keyn)
+{
+#ifdef TAA_CPU_X86
+	if(ni)
+	{
+		aesniDecrypt(data, count, keyDec, keySize, keyNum, keyn, round);
+		return;
+	}
+#endif
+	forn(count)
+	{
+		decryptBlock(data, keyn);
 		data += 16;
-		if(!mod or i < blockCount-2)
-			keyn = (keyn + 1) % keyNum;
+		keyn = keyn + 1 == keyNum ? 0 : keyn + 1;
 	}
 }
 
+// byte r of column c
+#define CB(s, c, r) ((s)[c] >> (r) * 8 & 0xFF)
+
 void Aes::encryptBlock(byte* block, uint keyn)
 {
-	byte* key = keyExp + keyn * keySize;
+	uint* key = (uint*)(keyExp + keyn * keySize);
+	uint* bk = (uint*)block;
+	uint s[4], t[4];
 
-	addRoundKey(block, key);
-	key += 16;
+	forn(4)
+	s[i] = bk[i] ^ key[i];
+	key += 4;
 
-	// rounds
-	forn(round)
+	// rounds, sub bytes, shift rows, mix columns, add round key
+	form(r, round - 1)
 	{
-		subBytes(block);
-		shiftRows(block);
-		if(i < round-1)
-			mixColumns(block);
-		addRoundKey(block, key);
-		key += 16;
+		t[0] = te0[CB(s, 0, 0)] ^ te1[CB(s, 1, 1)] ^ te2[CB(s, 2, 2)] ^ te3[CB(s, 3, 3)] ^ key[0];
+		t[1] = te0[CB(s, 1, 0)] ^ te1[CB(s, 2, 1)] ^ te2[CB(s, 3, 2)] ^ te3[CB(s, 0, 3)] ^ key[1];
+		t[2] = te0[CB(s, 2, 0)] ^ te1[CB(s, 3, 1)] ^ te2[CB(s, 0, 2)] ^ te3[CB(s, 1, 3)] ^ key[2];
+		t[3] = te0[CB(s, 3, 0)] ^ te1[CB(s, 0, 1)] ^ te2[CB(s, 1, 2)] ^ te3[CB(s, 2, 3)] ^ key[3];
+		s[0] = t[0];
+		s[1] = t[1];
+		s[2] = t[2];
+		s[3] = t[3];
+		key += 4;
 	}
+
+	// last round without mix columns
+	forn(4)
+	bk[i] = UI(sbox[CB(s, i, 0)], sbox[CB(s, i + 1 & 3, 1)], sbox[CB(s, i + 2 & 3, 2)], sbox[CB(s, i + 3 & 3, 3)]) ^ key[i];
 }
 
 void Aes::decryptBlock(byte* block, uint keyn)
 {
-	byte* key = keyExp + keyn * keySize + keySize - 16;
+	uint* key = (uint*)(keyDec + keyn * keySize);
+	uint* bk = (uint*)block;
+	uint s[4], t[4];
 
-	addRoundKey(block, key);
-	key -= 16;
+	forn(4)
+	s[i] = bk[i] ^ key[i];
+	key += 4;
 
-	// rounds
-	forn(round)
+	// rounds, inverse shift rows, sub bytes, mix columns, add round key
+	form(r, round - 1)
 	{
-		invShiftRows(block);
-		invSubBytes(block);
-		addRoundKey(block, key);
-		// if(i < 9)
-		if(i < round-1)
-			invMixColumns(block);
-		key -= 16;
+		t[0] = td0[CB(s, 0, 0)] ^ td1[CB(s, 3, 1)] ^ td2[CB(s, 2, 2)] ^ td3[CB(s, 1, 3)] ^ key[0];
+		t[1] = td0[CB(s, 1, 0)] ^ td1[CB(s, 0, 1)] ^ td2[CB(s, 3, 2)] ^ td3[CB(s, 2, 3)] ^ key[1];
+		t[2] = td0[CB(s, 2, 0)] ^ td1[CB(s, 1, 1)] ^ td2[CB(s, 0, 2)] ^ td3[CB(s, 3, 3)] ^ key[2];
+		t[3] = td0[CB(s, 3, 0)] ^ td1[CB(s, 2, 1)] ^ td2[CB(s, 1, 2)] ^ td3[CB(s, 0, 3)] ^ key[3];
+		s[0] = t[0];
+		s[1] = t[1];
+		s[2] = t[2];
+		s[3] = t[3];
+		key += 4;
 	}
+
+	// last round without mix columns
+	forn(4)
+	bk[i] = UI(rsbox[CB(s, i, 0)], rsbox[CB(s, i + 3 & 3, 1)], rsbox[CB(s, i + 2 & 3, 2)], rsbox[CB(s, i + 1 & 3, 3)]) ^ key[i];
 }
 
 void Aes::keyExpansion(byte* key, uint size)
@@ -256,7 +345,9 @@ void Aes::keyExpansion(byte* key, uint size)
 	// From each key block (16 bytes) generate 10 keys + input key
 	// 11 * 16 = 176 bytes
 	safe_delete_array(keyExp);
+	safe_delete_array(keyDec);
 	keyExp = new byte[keyNum * keySize];
+	keyDec = new byte[keyNum * keySize];
 
 	// pointer to current key
 	uint *kp = (uint*)keyExp;
@@ -277,7 +368,7 @@ void Aes::keyExpansion(byte* key, uint size)
 		kp += 4;
 
 		// generate N keys for N rounds, N * 4 columns
-		form(u, round * 4)
+		for(int u = 0; u < round * 4; u++)
 		{
 			// u % nk
 			if(u % 4 == 0)
@@ -287,6 +378,25 @@ void Aes::keyExpansion(byte* key, uint size)
 		}
 		kp += round * 4;
 	}
+
+	// decrypt keys in reverse order, inner keys with inverse mix columns
+	forn(keyNum)
+	{
+		uint* ke = (uint*)(keyExp + i * keySize);
+		uint* kd = (uint*)(keyDec + i * keySize);
+		form(r, round + 1)
+		{
+			uint* k = ke + (round - r) * 4;
+			form(c, 4)
+			{
+				uint w = k[c];
+				if(r == 0 or r == round)
+					kd[r*4 + c] = w;
+				else
+					kd[r*4 + c] = td0[sbox[w & 0xFF]] ^ td1[sbox[w >> 8 & 0xFF]] ^ td2[sbox[w >> 16 & 0xFF]] ^ td3[sbox[w >> 24]];
+			}
+		}
+	}
 }
 
 void Aes::setRounds(byte roundn)
@@ -314,108 +424,4 @@ uint Aes::tmColumn(uint column, byte rcon)
 	return column;
 }
 
-void Aes::addRoundKey(byte* block_, byte* key_)
-{
-	uint* block = (uint*)block_;
-	uint* key = (uint*)key_;
-	forn(4)
-	block[i] ^= key[i];
-}
-
-void Aes::subBytes(byte* block)
-{
-	forn(16)
-	block[i] = sbox[block[i]];
-}
-
-void Aes::invSubBytes(byte* block)
-{
-	forn(16)
-	block[i] = rsbox[block[i]];
-}
-
-void Aes::shiftRows(byte* block)
-{
-	// shift row 1 by 1 left
-	// 1 5 9 13
-	// 5 9 13 1
-	byte t = block[1];
-	forn(3)
-	block[i * 4 + 1] = block[i * 4 + 5];
-	block[13] = t;
-
-	// shift row 2 by 2
-	// 2  6  10 14
-	// 10 14 2  6
-	t = block[2];
-	block[2] = block[10];
-	block[10] = t;
-	t = block[6];
-	block[6] = block[14];
-	block[14] = t;
-
-	// shift row 3 by 3 (to right by 1)
-	// 3 7 11 15
-	// 15 3 7 11
-	t = block[15];
-	forn(3)
-	block[15 - i * 4] = block[11 - i * 4];
-	block[3] = t;
-}
-
-void Aes::invShiftRows(byte* block)
-{
-	// shift row 1 by 1 right
-	// 1 5 9 13
-	// 13 1 5 9
-	byte t = block[13];
-	forn(3)
-	block[13 - i * 4] = block[9 - i * 4];
-	block[1] = t;
-
-	// shift row 2 by 2
-	// 2  6  10 14
-	// 10 14 2  6
-	t = block[2];
-	block[2] = block[10];
-	block[10] = t;
-	t = block[6];
-	block[6] = block[14];
-	block[14] = t;
-
-	// shift row 3 by 3 (to left by 1)
-	// 3 7 11 15
-	// 7 11 15 3
-	t = block[3];
-	forn(3)
-	block[i * 4 + 3] = block[i * 4 + 7];
-	block[15] = t;
-}
-
-void Aes::mixColumns(byte* block)
-{
-	// each column
-	byte* c = block;
-	uint* v = (uint*)block;
-	forn(4)
-	{
-		*v = ge0[c[0]] ^ ge1[c[1]] ^ ge2[c[2]] ^ ge3[c[3]];
-		c += 4;
-		v++;
-	}
-}
-
-void Aes::invMixColumns(byte* block)
-{
-	// each column
-	byte* c = block;
-	uint* v = (uint*)block;
-	forn(4)
-	{
-		*v = gd0[c[0]] ^ gd1[c[1]] ^ gd2[c[2]] ^ gd3[c[3]];
-		c += 4;
-		v++;
-	}
-}
-
-}
+}
\ No newline at end of file
@@ -29,12 +29,40 @@ limitations under the License.
 #include <Common/container/Array.h>
 #include <Common/StringLib.h>
 
-#if ALLOCATOR_MODE & 0x10 and TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+#if ALLOCATOR_MODE & 0x30 and TAA_PLATFORM == TAA_PLATFORM_WINDOWS
 #include <Common/platform/swindows.h>
 #endif
 
 #define PATH_SEP '/'
 
+// thread local storage, atomic operations for per thread memory pages
+#if ALLOCATOR_MODE & 0x20
+#if TAA_COMPILER == TAA_COMPILER_MSVC
+#define ALLOC_THREAD __declspec(thread)
+#define alloc_cas(o, c, n) InterlockedCompareExchangePointer((void* volatile*)&(o), n, c)
+#define alloc_xchg(o, n) InterlockedExchangePointer((void* volatile*)&(o), n)
+#define alloc_cas_int(o, c, n) InterlockedCompareExchange((volatile long*)&(o), n, c)
+#define alloc_set_int(o, v) InterlockedExchange((volatile long*)&(o), v)
+#else
+#define ALLOC_THREAD __thread
+#define alloc_cas(o, c, n) __sync_val_compare_and_swap(&(o), c, n)
+#define alloc_xchg(o, n) __sync_lock_test_and_set(&(o), n)
+#define alloc_cas_int(o, c, n) __sync_val_compare_and_swap(&(o), c, n)
+#define alloc_set_int(o, v) (__sync_synchronize(), (o) = (v))
+#endif
+#define ALLOC_LOCK while(alloc_cas_int(alc->listLock, 0, 1) != 0);
+#define ALLOC_UNLOCK alloc_set_int(alc->listLock, 0);
+#else
+#define ALLOC_LOCK
+#define ALLOC_UNLOCK
+#endif
+
+// size classes by 16 bytes, header included
+#define ALLOC_CLASS_STEP 16
+#define ALLOC_CLASS_MAX 1024
+#define ALLOC_CLASSES (ALLOC_CLASS_MAX / ALLOC_CLASS_STEP + 1)
+#define ALLOC_HEAD 16
+
 #define _printf
 #define _line
 
@@ -96,58 +124,108 @@ void _conv_bytes_s(char* so, uint bytes, uint prec, byte width = 0);
 #include "MemoryPage.hpp"
 #endif
 
-struct AllocStor
+struct AllocCache;
+
+/** Block header in mode 0x20, placed before user data.
+  * Size is last, ALLOCATOR_SIZE(p) works as in mode 0x02.
+  */
+struct AllocHead
+{
+	union
+	{
+		AllocCache* owner; // thread memory pages
+		AllocHead* next; // free list, remote free queue
+	};
+	half offset; // user data offset from block
+	half sclass; // size class, 0 memory page block
+	uint size;
+};
+
+/** Memory state of thread, single for all threads without mode 0x20.
+  * Blocks freed by other threads are pushed to remote queue
+  * and returned to memory pages by owner thread.
+  */
+struct AllocCache
 {
 #if ALLOCATOR_MODE & 0x08
 	MemoryPage* memPage;
 #endif
-
-	uint allocatorTableMode;
+	AllocCache* next; // list of all caches
+	AllocHead* remote; // remote free queue, lock-free stack
+	AllocHead* classFree[ALLOC_CLASSES];
+	uint active; // used by thread
 
 	uint allocCount;
 	uint allocSize;
 	uint allocSizeMax;
 	uint freeCount;
-	uint freeSize;
 
 	char* file; // allocatorSrc__() data
 	uint  line;
 	uint  alignSize;
 
-	Array<AllocInfo*, AllocSys<AllocInfo*> > list;
 #if TAA_PLATFORM == TAA_PLATFORM_LINUX
 	Array<uint, AllocSys<uint> > stack;
 #endif
 
-	FILE* fileLog;
-	wchar_t* fileName;
-
-	AllocStor()
+	AllocCache()
 	{
 #if ALLOCATOR_MODE & 0x08
 		memPage = 0;
 #endif
-		allocatorTableMode = 0;
+		next = 0;
+		remote = 0;
+		forn(ALLOC_CLASSES) classFree[i] = 0;
+		active = 0;
 		allocCount = 0;
 		allocSize = 0;
 		allocSizeMax = 0;
 		freeCount = 0;
-		freeSize = 0;
 		file = 0;
 		line = 0;
 		alignSize = 0;
-		fileLog = 0;
-		fileName = 0;
 #if TAA_PLATFORM == TAA_PLATFORM_LINUX
 		stack.reserve(16);
 #endif
 	}
 };
 
+struct AllocStor
+{
+	AllocCache* caches; // first is main thread
+
+	uint allocatorTableMode;
+	uint freeSize;
+	uint pageSize;
+	uint chunkSize;
+	uint listLock;
+
+	Array<AllocInfo*, AllocSys<AllocInfo*> > list;
+
+	FILE* fileLog;
+	wchar_t* fileName;
+
+	AllocStor()
+	{
+		caches = 0;
+		allocatorTableMode = 0;
+		freeSize = 0;
+		pageSize = 0;
+		chunkSize = 0;
+		listLock = 0;
+		fileLog = 0;
+		fileName = 0;
+	}
+};
+
 static AllocStor* alc = 0;
 
-static void _push_alloc_list(void* p, uint size);
-static bool _erase_alloc_list(void* p);
+#if ALLOCATOR_MODE & 0x20
+static ALLOC_THREAD AllocCache* threadCache = 0;
+#endif
+
+static void _push_alloc_list(AllocCache* ac, void* p, uint size);
+static bool _erase_alloc_list(AllocCache* ac, void* p);
 
 struct MemLeak
 {
@@ -192,45 +270,175 @@ void allocatorSetMemoryRoutines(MemoryAlloc memAllocl, MemoryFree memFreel)
 	userMemoryFree = memFreel;
 }
 
-void* memAlloc(uint size)
+void* memAlloc(AllocCache* ac, uint size)
 {
 #if ALLOCATOR_MODE & 0x08
-	assert(alc);
-	assert(alc->memPage);
-	// _printu(alc->alignSize);
+	assert(ac);
+	assert(ac->memPage);
+	// _printu(ac->alignSize);
 	// _printu(size);
-	void* mp = MemoryPageAlloc(alc->memPage, size, alc->alignSize);
-	alc->alignSize = 0;
+	void* mp = MemoryPageAlloc(ac->memPage, size, ac->alignSize);
+	ac->alignSize = 0;
 	return mp;
 #else
 	return SysAlloc(size);
 #endif
 }
 
-void memFree(void* p)
+void memFree(AllocCache* ac, void* p)
 {
 	if(!p) return;
 #if ALLOCATOR_MODE & 0x08
 #if ALLOCATOR_MODE & 0x02
 	PSIZE(p) = 0;
 #endif
-	MemoryPageFree(alc->memPage, p);
+	MemoryPageFree(ac->memPage, p);
 #else
 	SysFree(p);
 #endif
 }
 
+static AllocCache* cacheCreate()
+{
+#if ALLOCATOR_MODE & 0x08
+	char* mem = (char*) SysAlloc(sizeof(AllocCache) + sizeof(MemoryPage) + 16);
+#else
+	char* mem = (char*) SysAlloc(sizeof(AllocCache));
+#endif
+	AllocCache* ac = new(mem) AllocCache;
+#if ALLOCATOR_MODE & 0x08
+	ac->memPage = MemoryPageCreate(ALIGN_BYTE_PTR(mem + sizeof(AllocCache), 16));
+	if(alc->pageSize)
+		MemoryPageSetSize(ac->memPage, alc->pageSize, alc->chunkSize);
+#endif
+	return ac;
+}
+
+/// Memory state of current thread.
+static AllocCache* allocCache()
+{
+#if ALLOCATOR_MODE & 0x20
+	AllocCache* ac = threadCache;
+	if(ac) return ac;
+
+	// take cache of finished thread
+	for(ac = alc->caches; ac; ac = ac->next)
+		if(alloc_cas_int(ac->active, 0, 1) == 0)
+			break;
+
+	if(!ac)
+	{
+		ac = cacheCreate();
+		ac->active = 1;
+		AllocCache* first = 0;
+		do
+		{
+			first = alc->caches;
+			ac->next = first;
+		}
+		while((AllocCache*) alloc_cas(alc->caches, first, ac) != first);
+	}
+	threadCache = ac;
+	return ac;
+#else
+	return alc->caches;
+#endif
+}
+
+#if ALLOCATOR_MODE & 0x20
+
+static void cacheRelease(AllocCache* ac, AllocHead* h)
+{
+	ac->allocSize -= h->size;
+	if(h->sclass)
+	{
+		h->next = ac->classFree[h->sclass];
+		ac->classFree[h->sclass] = h;
+	}
+	else
+		memFree(ac, (char*)(h + 1) - h->offset);
+}
+
+/// Return blocks freed by other threads.
+static void cacheDrain(AllocCache* ac)
+{
+	AllocHead* h = (AllocHead*) alloc_xchg(ac->remote, 0);
+	while(h)
+	{
+		AllocHead* next = h->next;
+		cacheRelease(ac, h);
+		h = next;
+	}
+}
+
+static void* cacheAlloc(AllocCache* ac, uint size)
+{
+	if(ac->remote)
+		cacheDrain(ac);
+
+	uint head = MAX(ac->alignSize, ALLOC_HEAD);
+	uint sclass = 0;
+	char* mem = 0;
+	AllocHead* h = 0;
+
+	// small blocks by size classes, reused without memory pages
+	if(!ac->alignSize and size + head <= ALLOC_CLASS_MAX)
+	{
+		sclass = (size + head + ALLOC_CLASS_STEP - 1) / ALLOC_CLASS_STEP;
+		h = ac->classFree[sclass];
+		if(h)
+		{
+			ac->classFree[sclass] = h->next;
+			h->owner = ac;
+			h->size = size;
+			return h + 1;
+		}
+		mem = (char*) memAlloc(ac, sclass * ALLOC_CLASS_STEP);
+	}
+	else
+		mem = (char*) memAlloc(ac, size + head);
+
+	if(!mem) return 0;
+
+	h = (AllocHead*)(mem + head) - 1;
+	h->owner = ac;
+	h->offset = head;
+	h->sclass = sclass;
+	h->size = size;
+	return h + 1;
+}
+
+static void cacheFree(AllocCache* ac, void* p)
+{
+	AllocHead* h = (AllocHead*) p - 1;
+	AllocCache* owner = h->owner;
+	if(owner == ac)
+		return cacheRelease(ac, h);
+
+	// block of other thread
+	AllocHead* first = 0;
+	do
+	{
+		first = owner->remote;
+		h->next = first;
+	}
+	while((AllocHead*) alloc_cas(owner->remote, first, h) != first);
+}
+
+#endif
+
 void* operator_new(uint_t size)
 {
 	assert(alc);
 	// _printu(size);
 
+	AllocCache* ac = allocCache();
 	void* p = 0;
 
 	if(size == 0)
 		size = 1;
 #if TAA_PLATFORM == TAA_PLATFORM_LINUX
-	if(!alc->file)
+	if(!ac->file)
 	{
 		p = SysAlloc(size);
 		if(p == 0)
@@ -243,9 +451,11 @@ void* operator_new(uint_t size)
 	// if(ALLOCATOR_MODE_TABLE & 0x40)
 	// usize += sizeof(uint_t);
 
-#if ALLOCATOR_MODE & 0x02
+#if ALLOCATOR_MODE & 0x20
+	p = cacheAlloc(ac, usize);
+#elif ALLOCATOR_MODE & 0x02
 	usize += sizeof(uint);
-	p = memAlloc(usize);
+	p = memAlloc(ac, usize);
 	if(p)
 	{
 		char* pc = (char*) p;
@@ -254,25 +464,27 @@ void* operator_new(uint_t size)
 		p = pc;
 	}
 #else
-	p = memAlloc(usize);
+	p = memAlloc(ac, usize);
 #endif
 
 	if(p == 0)
 		throw BadAlloc();
 
-	alc->allocCount++;
-	alc->allocSize += size;
-	if(alc->allocSize > alc->allocSizeMax)
-		alc->allocSizeMax = alc->allocSize;
+	ac->allocCount++;
+	ac->allocSize += size;
+	if(ac->allocSize > ac->allocSizeMax)
+		ac->allocSizeMax = ac->allocSize;
 
 	if(ALLOCATOR_MODE_TABLE & 0x40)
 	{
-		_push_alloc_list(p, size);
+		ALLOC_LOCK
+		_push_alloc_list(ac, p, size);
+		ALLOC_UNLOCK
 		// p += 4;
 		// p = (uint_t*) p + 1;
 	}
 
-	alc->file = 0;
+	ac->file = 0;
 	return p;
 }
 
@@ -280,60 +492,89 @@ void operator_delete(void* p)
 {
 	if(!alc or !p) return;
 
+	AllocCache* ac = allocCache();
+
 #if TAA_PLATFORM == TAA_PLATFORM_LINUX
-	if(!alc->stack.size() || alc->stack.last() != (uint) p)
+	if(!ac->stack.size() || ac->stack.last() != (uint) p)
 	{
 		SysFree(p);
 		return;
 	}
-	alc->stack.pop();
+	ac->stack.pop_back();
 #endif
 
-	// alc->freeCount++;
+	// ac->freeCount++;
 
 	if((ALLOCATOR_MODE_TABLE & 0x42) == 0x40)
 	{
-		if(_erase_alloc_list(p))
-			alc->freeCount++;
+		ALLOC_LOCK
+		if(_erase_alloc_list(ac, p))
+			ac->freeCount++;
+		ALLOC_UNLOCK
 		// p = (uint*) p - 1;
 	}
 	else
-		alc->freeCount++;
-
-#if ALLOCATOR_MODE & 0x02
-	if(alc->file)
-		alc->allocSize -= PSIZEH(p);
-	memFree((char*)p-sizeof(uint));
+		ac->freeCount++;
+
+#if ALLOCATOR_MODE & 0x20
+	cacheFree(ac, p);
+#elif ALLOCATOR_MODE & 0x02
+	if(ac->file)
+		ac->allocSize -= PSIZEH(p);
+	memFree(ac, (char*)p-sizeof(uint));
 #else
-	memFree(p);
+	memFree(ac, p);
 #endif
 
-	alc->file = 0;
+	ac->file = 0;
 }
 
 void allocatorInit()
 {
 	uint msz = 1024;
 	char* mem = (char*) SysAlloc(msz);
-	char* sme = mem;
 
 	alc = new(mem) AllocStor;
 	mem += sizeof(AllocStor);
 
-#if ALLOCATOR_MODE & 0x08
-	alc->memPage = MemoryPageCreate(mem);
-	mem += sizeof(MemoryPage) + 10;
-#endif
 	alc->fileName = reinterpret_cast<wchar_t*>(mem);
 	stwcpy(alc->fileName, L"allocator.log");
+
+	// main thread
+	alc->caches = cacheCreate();
+	alc->caches->active = 1;
+#if ALLOCATOR_MODE & 0x20
+	threadCache = alc->caches;
+#endif
+}
+
+void allocatorThreadExit()
+{
+#if ALLOCATOR_MODE & 0x20
+	AllocCache* ac = threadCache;
+	if(!alc or !ac or ac == alc->caches)
+		return;
+
+	// memory pages stay with cache for next thread
+	cacheDrain(ac);
+	ac->file = 0;
+	ac->alignSize = 0;
+#if TAA_PLATFORM == TAA_PLATFORM_LINUX
+	ac->stack.clear();
+#endif
+	threadCache = 0;
+	alloc_set_int(ac->active, 0);
+#endif
 }
 
 bool allocatorValid(void* p, uint size)
 {
 	if(!p) return 0;
-#if ALLOCATOR_MODE & 0x08
+#if ALLOCATOR_MODE & 0x20
+	return PSIZEH((char*)p) == size;
+#elif ALLOCATOR_MODE & 0x08
 #if ALLOCATOR_MODE & 0x02
-	return MemoryPageValid(alc->memPage, (char*)p-sizeof(uint), size);
+	return MemoryPageValid(alc->caches->memPage, (char*)p-sizeof(uint), size);
 #else
 	return 0;
 #endif
@@ -345,7 +586,7 @@ uint allocatorSize(void* p)
 {
 	if(!p) return 0;
 
-#if ALLOCATOR_MODE & 0x02
+#if ALLOCATOR_MODE & 0x22
 	return PSIZEH((char*)p);
 #endif
 
@@ -363,17 +604,18 @@ void allocatorSrc(const char* file, uint line, byte mode, uint ptr)
 {
 	// _printf("SRC | %u | %u | %s\n", mode, line, _file_name(file));
 	assert(alc && "call alloc_init() before call operators new ..");
-	alc->file = (char*)file;
-	alc->line = line;
+	AllocCache* ac = allocCache();
+	ac->file = (char*)file;
+	ac->line = line;
 	// append delete pointer to stack
 #if TAA_PLATFORM == TAA_PLATFORM_LINUX
-	if(mode) alc->stack.push_back(ptr);
+	if(mode) ac->stack.push_back(ptr);
 #endif
 }
 
 void allocatorAlign(uint align)
 {
-	alc->alignSize = align;
+	allocCache()->alignSize = align;
 }
 
 void allocatorSetLog(wchar_t* name)
@@ -409,14 +651,18 @@ void allocatorPrintf(char* format, ...)
 void allocatorSetMemorySize(uint page_size, uint chunk_size)
 {
 #if ALLOCATOR_MODE & 0x08
-	MemoryPageSetSize(alc->memPage, page_size, chunk_size);
+	// applied to caches of new threads too
+	alc->pageSize = page_size;
+	alc->chunkSize = chunk_size;
+	for(AllocCache* ac = alc->caches; ac; ac = ac->next)
+		MemoryPageSetSize(ac->memPage, page_size, chunk_size);
 #endif
 }
 
 void allocatorGetMemorySize(char* page_size, char m)
 {
 #if ALLOCATOR_MODE & 0x08
-	MemoryPageGetSizes(alc->memPage, page_size, m);
+	MemoryPageGetSizes(allocCache()->memPage, page_size, m);
 #endif
 }
 
@@ -424,23 +670,55 @@ void allocatorInfo()
 {
 	char cvs[3][16] = {0};
 
-	_conv_bytes_s(cvs[0], alc->allocSizeMax, 1, 3);
+	// statistics of all threads, peak is sum of thread peaks
+	uint allocCount = 0;
+	uint allocSizeMax = 0;
+	uint freeCount = 0;
+	uint pageCountMax = 0;
+	uint pageSizeMax = 0;
+	uint threads = 0;
+	for(AllocCache* ac = alc->caches; ac; ac = ac->next)
+	{
+#if ALLOCATOR_MODE & 0x20
+		// queue of running thread drained only by own thread
+		if(ac == threadCache)
+			cacheDrain(ac);
+		else if(alloc_cas_int(ac->active, 0, 1) == 0)
+		{
+			cacheDrain(ac);
+			alloc_set_int(ac->active, 0);
+		}
+#endif
+		allocCount += ac->allocCount;
+		allocSizeMax += ac->allocSizeMax;
+		freeCount += ac->freeCount;
+#if ALLOCATOR_MODE & 0x08
+		pageCountMax += ac->memPage->allocCountMax;
+		pageSizeMax += ac->memPage->allocSizeMax;
+#endif
+		threads++;
+	}
+
+	_conv_bytes_s(cvs[0], allocSizeMax, 1, 3);
 	_conv_bytes_s(cvs[1], alc->freeSize, 1, 3);
 
 #if ALLOCATOR_MODE & 0x01
 	if(alc->fileLog)
 		allocatorPrintf("\n");
 #if ALLOCATOR_MODE & 0x08
-	MemoryPageInfo(alc->memPage);
+	MemoryPageInfo(alc->caches->memPage, pageCountMax, pageSizeMax);
+#if ALLOCATOR_MODE & 0x20
+	allocatorPrintf("threads         %u\n", threads);
+#endif
 	allocatorPrintf("\n");
 #endif
-#if ALLOCATOR_MODE & 0x02
-	allocatorPrintf("allocate query %u, size %s\n", alc->allocCount, cvs[0]);
+#if ALLOCATOR_MODE & 0x22
+	allocatorPrintf("allocate query %u, size %s\n", allocCount, cvs[0]);
 #else
-	allocatorPrintf("allocate query %u\n", alc->allocCount);
+	allocatorPrintf("allocate query %u\n", allocCount);
 #endif
-	int delMiss = alc->allocCount - alc->freeCount;
-	allocatorPrintf("deletion query %u", alc->freeCount);
+	int delMiss = allocCount - freeCount;
+	allocatorPrintf("deletion query %u", freeCount);
 	if(delMiss != 0)
 	{
 		allocatorPrintf("\ndeletion %s %u", delMiss < 0 ? "wrong" : "missed", delMiss < 0 ? -delMiss : delMiss);
@@ -489,14 +767,15 @@ void allocatorInfo()
 
 			allocatorPrintf("|================================================================|");
 
-			memFree(table);
+			SysFree(table);
 
 			/// clear list memory
 			forn(alc->list.size())
-			memFree(alc->list[i]);
+			SysFree(alc->list[i]);
 			alc->list.clear();
 #if TAA_PLATFORM == TAA_PLATFORM_LINUX
-			alc->stack.clear();
+			for(AllocCache* ac = alc->caches; ac; ac = ac->next)
+				ac->stack.clear();
 #endif
 		}
 	}
@@ -510,19 +789,26 @@ void allocatorInfo()
 
 void allocatorClean()
 {
+	AllocCache* ac = alc->caches;
+	while(ac)
+	{
+		AllocCache* next = ac->next;
 #if ALLOCATOR_MODE & 0x08
-	MemoryPageClear(alc->memPage);
+		MemoryPageClear(ac->memPage);
 #endif
+		SysFree(ac);
+		ac = next;
+	}
 	SysFree(alc);
 	alc = 0;
 }
 
-void _push_alloc_list(void* p, uint size)
+void _push_alloc_list(AllocCache* ac, void* p, uint size)
 {
-	int fs = stdrchr((char*) alc->file, PATH_SEP) + 1;
+	int fs = stdrchr((char*) ac->file, PATH_SEP) + 1;
 
 	if(ALLOCATOR_MODE_TABLE & 0x01)
-		if(stdcmp(alc->file + fs, ALLOC_FILE))
+		if(stdcmp(ac->file + fs, ALLOC_FILE))
 			return;
 
 	if(ALLOCATOR_MODE_TABLE & 0x30)
@@ -532,9 +818,9 @@ void _push_alloc_list(void* p, uint size)
 		{
 			bool state = 0;
 			if(ALLOCATOR_MODE_TABLE & 0x20)
-				state = stdcmp(alc->list[i]->file, alc->file + fs);
+				state = stdcmp(alc->list[i]->file, ac->file + fs);
 			else if(ALLOCATOR_MODE_TABLE & 0x10)
-				state = (stdcmp(alc->list[i]->file, alc->file + fs) and alc->list[i]->line == alc->line);
+				state = (stdcmp(alc->list[i]->file, ac->file + fs) and alc->list[i]->line == ac->line);
 			if(state)
 			{
 				alc->list[i]->allocCount++;
@@ -544,33 +830,34 @@ void _push_alloc_list(void* p, uint size)
 		}
 	}
 
-	uint len = stdlen((char*)alc->file) - fs + 2;
+	uint len = stdlen((char*)ac->file) - fs + 2;
 	uint memsz[3] = {sizeof(AllocInfo), len, 0};
 	forn(2) memsz[2] += memsz[i];
 
-	char* mem = (char*) memAlloc(memsz[2]);
+	// list is shared by threads, system memory
+	char* mem = (char*) SysAlloc(memsz[2]);
 
 	AllocInfo* nfo = (AllocInfo*) mem;
 	nfo->address = (uint_t) p;
 	nfo->size = size;
-	nfo->line = alc->line;
+	nfo->line = ac->line;
 	nfo->allocCount = 1;
 	nfo->file = (char*) mem + memsz[0];
-	stdcpy(nfo->file, (char*)alc->file + fs); // file name without path
+	stdcpy(nfo->file, (char*)ac->file + fs); // file name without path
 
 	// *((uint*) p) = alc->list.size();
 
 	alc->list.push_back(nfo);
 }
 
-bool _erase_alloc_list(void* p)
+bool _erase_alloc_list(AllocCache* ac, void* p)
 {
 	int fs = 0;
 	if(ALLOCATOR_MODE_TABLE & 0x21)
-		fs = stdrchr((char*) alc->file, PATH_SEP) + 1;
+		fs = stdrchr((char*) ac->file, PATH_SEP) + 1;
 
 	if(ALLOCATOR_MODE_TABLE & 0x01)
-		if(stdcmp(alc->file + fs, ALLOC_FILE))
+		if(stdcmp(ac->file + fs, ALLOC_FILE))
 			return 1;
 
 	/// restore index list
@@ -582,12 +869,12 @@ bool _erase_alloc_list(void* p)
 	{
 		if(ALLOCATOR_MODE_TABLE & 0x20)
 		{
-			if(stdcmp(alc->list[i]->file, alc->file + fs))
+			if(stdcmp(alc->list[i]->file, ac->file + fs))
 			{
 				alc->list[i]->allocCount--;
 				if(alc->list[i]->allocCount == 0)
 				{
-					memFree(alc->list[i]);
+					SysFree(alc->list[i]);
 					alc->list.erase_swap(i);
 				}
 				return 1;
@@ -598,7 +885,7 @@ bool _erase_alloc_list(void* p)
 			if(alc->list[i]->address == (uint_t) p)
 			{
 				alc->freeSize += alc->list[i]->size;
-				memFree(alc->list[i]);
+				SysFree(alc->list[i]);
 				/// erase from array
 				alc->list.erase_swap(i);
 				return 1;
@@ -610,7 +897,7 @@ bool _erase_alloc_list(void* p)
 
 MemLeak* _build_list(uint& mln)
 {
-	MemLeak* memLeak = (MemLeak*) memAlloc(sizeof(MemLeak) * alc->list.size());
+	MemLeak* memLeak = (MemLeak*) SysAlloc(sizeof(MemLeak) * alc->list.size());
 	mln = 0;
 
 	forn(alc->list.size())
@@ -706,4 +993,170 @@ void _conv_bytes_s(char* so, uint bytes, uint prec, byte width)
 
 } /// namespace
 
-#endif
\ No newline at end of file
+#endif
+
+/*****************************************************************
+ *                                                               *
+ *  Large blocks on 2 mb memory pages, for coder tables.         *
+ *  Used with and without TAA_ALLOCATOR.                         *
+ *                                                               *
+ *****************************************************************/
+
+#include <Common/Allocator.h>
+#include <Common/platform/cpp.h>
+#include <stdlib.h>
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+#include <Common/platform/swindows.h>
+#elif TAA_PLATFORM == TAA_PLATFORM_LINUX
+#include <sys/mman.h>
+#endif
+
+// large page size, smaller blocks from heap
+#define LARGE_PAGE (2 * 1024 * 1024)
+// block header size, keep data aligned
+#define LARGE_HEAD 64
+
+namespace tas
+{
+
+struct LargeHead
+{
+	char* base;  // start of block
+	uint_t size; // mapped size, header included
+	uint map; // 0 heap, 1 mapped pages
+};
+
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+
+// large page size, 0 if process can't lock memory
+static uint_t largePageSize()
+{
+	static int state = -1;
+	if(state < 0)
+	{
+		state = 0;
+		HANDLE token = 0;
+		TOKEN_PRIVILEGES tp;
+		if(OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		{
+			tp.PrivilegeCount = 1;
+			tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			if(LookupPrivilegeValue(0, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) and
+			        AdjustTokenPrivileges(token, 0, &tp, 0, 0, 0) and GetLastError() == ERROR_SUCCESS)
+				state = 1;
+			CloseHandle(token);
+		}
+	}
+	return state ? GetLargePageMinimum() : 0;
+}
+
+static void* largeMap(uint_t& size)
+{
+	void* p = 0;
+	uint_t page = largePageSize();
+	if(page)
+	{
+		uint_t lsize = (size + page - 1) & ~(page - 1);
+		p = VirtualAlloc(0, lsize, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if(p)
+		{
+			size = lsize;
+			return p;
+		}
+	}
+	return VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+static void largeUnmap(void* p, uint_t size)
+{
+	VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#elif TAA_PLATFORM == TAA_PLATFORM_LINUX
+
+static void* largeMap(uint_t& size)
+{
+	void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	// reserved huge pages
+	uint_t lsize = (size + LARGE_PAGE - 1) & ~(uint_t)(LARGE_PAGE - 1);
+	p = mmap(0, lsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(p != MAP_FAILED)
+	{
+		size = lsize;
+		return p;
+	}
+#endif
+	// transparent huge pages, region aligned by large page
+	uint_t msize = size + LARGE_PAGE;
+	char* m = (char*) mmap(0, msize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(m == MAP_FAILED)
+		return 0;
+	char* a = ALIGN_BYTE_PTR(m, LARGE_PAGE);
+	if(a != m)
+		munmap(m, a - m);
+	uint_t tail = m + msize - (a + size);
+	if(tail)
+		munmap(a + size, tail);
+#ifdef MADV_HUGEPAGE
+	madvise(a, size, MADV_HUGEPAGE);
+#endif
+	return a;
+}
+
+static void largeUnmap(void* p, uint_t size)
+{
+	munmap(p, size);
+}
+
+#else
+
+static void* largeMap(uint_t& size)
+{
+	return 0;
+}
+
+static void largeUnmap(void* p, uint_t size)
+{
+}
+
+#endif
+
+void* allocatorLarge(uint_t size)
+{
+	uint_t msize = size + LARGE_HEAD;
+	char* mem = 0;
+	uint map = 0;
+	if(size >= LARGE_PAGE)
+	{
+		mem = (char*) largeMap(msize);
+		map = 1;
+	}
+	if(!mem)
+	{
+		mem = (char*) malloc(msize + 16);
+		map = 0;
+	}
+	if(!mem)
+		throw BadAlloc();
+
+	// heap block aligned by 16 bytes, pages are aligned
+	char* data = ALIGN_BYTE_PTR(mem + LARGE_HEAD, 16);
+	LargeHead* head = (LargeHead*)(data - LARGE_HEAD);
+	head->base = mem;
+	head->size = msize;
+	head->map = map;
+	return data;
+}
+
+void allocatorLargeFree(void* p)
+{
+	if(!p) return;
+	LargeHead* head = (LargeHead*)((char*) p - LARGE_HEAD);
+	if(head->map)
+		largeUnmap(head->base, head->size);
+	else
+		free(head->base);
+}
+
+} /// namespace
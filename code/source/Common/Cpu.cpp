@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Common/Cpu.h>
+
+#ifdef TAA_CPU_X86
+#if TAA_COMPILER == TAA_COMPILER_MSVC
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace tas
+{
+
+uint cpuFeatures()
+{
+	static uint features = MAX_UINT32;
+	if(features != MAX_UINT32)
+		return features;
+
+	uint f = 0;
+#ifdef TAA_CPU_X86
+	uint r[4] = {0};
+#if TAA_COMPILER == TAA_COMPILER_MSVC
+	__cpuid((int*)r, 1);
+#else
+	__get_cpuid(1, &r[0], &r[1], &r[2], &r[3]);
+#endif
+	// edx 26, ecx 1, ecx 25
+	if(r[3] & 1 << 26)
+	{
+		f |= CPU_SSE2;
+		if(r[2] & 1 << 1)
+			f |= CPU_CLMUL;
+		if(r[2] & 1 << 25)
+			f |= CPU_AES;
+	}
+#endif
+	features = f;
+	return f;
+}
+
+wint cpuTicks()
+{
+#ifdef TAA_CPU_X86
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+}
@@ -14,14 +14,106 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <Common/Crc32.h>
+#include <Common/Cpu.h>
+
+#ifdef TAA_CPU_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+// little endian 4 bytes
+#define LE32(p) ((p)[0] | (p)[1] << 8 | (p)[2] << 16 | (uint)(p)[3] << 24)
 
 namespace tas
 {
 
+#ifdef TAA_CPU_X86
+/*
+	Folding by carry-less multiply, Intel "Fast CRC Computation
+	Using PCLMULQDQ Instruction", constants for reflected polynomial.
+	Length multiple of 16, not less 64.
+*/
+TAA_TARGET("sse2,pclmul")
+static uint crcClmul(byte* buf, uint len, uint crc)
+{
+	__m128i k1k2 = _mm_setr_epi32(0x54442BD4, 0x01, 0xC6E41596, 0x01);
+	__m128i k3k4 = _mm_setr_epi32(0x751997D0, 0x01, 0xCCAA009E, 0x00);
+	__m128i k5 = _mm_setr_epi32(0x63CD6124, 0x01, 0, 0);
+	__m128i poly = _mm_setr_epi32(0xDB710641, 0x01, 0xF7011641, 0x01);
+	__m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((__m128i*)(buf + 0x00));
+	x2 = _mm_loadu_si128((__m128i*)(buf + 0x10));
+	x3 = _mm_loadu_si128((__m128i*)(buf + 0x20));
+	x4 = _mm_loadu_si128((__m128i*)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	buf += 64;
+	len -= 64;
+
+	// fold 4 x 128 bits
+	x0 = k1k2;
+	while(len >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((__m128i*)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((__m128i*)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((__m128i*)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((__m128i*)(buf + 0x30)));
+		buf += 64;
+		len -= 64;
+	}
+
+	// fold to 128 bits
+	x0 = k3k4;
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+	while(len >= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((__m128i*)buf)), x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	// fold to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask);
+	x1 = _mm_clmulepi64_si128(x1, k5, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_and_si128(x1, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif
+
 Crc32::Crc32()
 {
 	crc = 0xFFFFFFFF;
 	table = 0;
+	clmul = 0;
 }
 
 Crc32::~Crc32()
@@ -31,7 +123,8 @@ Crc32::~Crc32()
 
 void Crc32::tableInit()
 {
-	table = new uint[256];
+	safe_delete_array(table);
+	table = new uint[16 * 256];
 	uint n, i, j;
 	for(i = 0; i < 256; i++)
 	{
@@ -40,10 +133,46 @@ void Crc32::tableInit()
 			n = n & 1 ? (n >> 1) ^ 0xEDB88320 : n >> 1;
 		table[i] = n;
 	}
+
+	// table k is crc of byte followed by k zero bytes
+	for(i = 256; i < 16 * 256; i++)
+		table[i] = (table[i-256] >> 8) ^ table[table[i-256] & 0xFF];
+
+	clmul = (cpuFeatures() & (CPU_SSE2 | CPU_CLMUL)) == (CPU_SSE2 | CPU_CLMUL);
 }
 
 void Crc32::calculate(byte* buf, uint len)
 {
+#ifdef TAA_CPU_X86
+	if(clmul and len >= 64)
+	{
+		uint n = len & ~15;
+		crc = crcClmul(buf, n, crc);
+		buf += n;
+		len -= n;
+	}
+#endif
+
+	// slicing by 16
+	uint* t = table;
+	while(len >= 16)
+	{
+		uint a = crc ^ LE32(buf);
+		uint b = LE32(buf + 4);
+		uint c = LE32(buf + 8);
+		uint d = LE32(buf + 12);
+		crc = t[15*256 + (a & 0xFF)] ^ t[14*256 + (a >> 8 & 0xFF)] ^
+			t[13*256 + (a >> 16 & 0xFF)] ^ t[12*256 + (a >> 24)] ^
+			t[11*256 + (b & 0xFF)] ^ t[10*256 + (b >> 8 & 0xFF)] ^
+			t[9*256 + (b >> 16 & 0xFF)] ^ t[8*256 + (b >> 24)] ^
+			t[7*256 + (c & 0xFF)] ^ t[6*256 + (c >> 8 & 0xFF)] ^
+			t[5*256 + (c >> 16 & 0xFF)] ^ t[4*256 + (c >> 24)] ^
+			t[3*256 + (d & 0xFF)] ^ t[2*256 + (d >> 8 & 0xFF)] ^
+			t[1*256 + (d >> 16 & 0xFF)] ^ t[d >> 24];
+		buf += 16;
+		len -= 16;
+	}
+
 	while(len--)
 		crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
 }
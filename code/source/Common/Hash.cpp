@@ -131,4 +131,54 @@ uint HashMurmur2A(byte* key, uint len, uint seed)
 	return h;
 }
 
+wint HashMurmur64A(byte* key, uint len, wint seed)
+{
+	const wint m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	wint h = seed ^ (len * m);
+
+	const byte* data = (const byte*) key;
+	const byte* end = data + (len & ~7);
+
+	while(data != end)
+	{
+		wint k = *(wint*)data;
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+
+		data += 8;
+	}
+
+	switch(len & 7)
+	{
+	case 7:
+		h ^= (wint) data[6] << 48;
+	case 6:
+		h ^= (wint) data[5] << 40;
+	case 5:
+		h ^= (wint) data[4] << 32;
+	case 4:
+		h ^= (wint) data[3] << 24;
+	case 3:
+		h ^= (wint) data[2] << 16;
+	case 2:
+		h ^= (wint) data[1] << 8;
+	case 1:
+		h ^= (wint) data[0];
+		h *= m;
+	};
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
 }
\ No newline at end of file
@@ -29,6 +29,9 @@ limitations under the License.
 	Removes address header.
 	Implements memory pool for allocate small fixed size blocks.
 	This method decrease fragmentation of data.
+
+	Mode 0x20
+	Each thread have own MemoryPage, not shared between threads.
 */
 
 byte alignSize(void* address, byte align);
@@ -526,14 +529,15 @@ void MemoryPageClear(MemoryPage* mp)
 	mp->list.clear();
 }
 
-void MemoryPageInfo(MemoryPage* mp)
+// count, size of system allocations summed by threads
+void MemoryPageInfo(MemoryPage* mp, uint allocCountMax, uint allocSizeMax)
 {
 	char cvs[3][20] = {0};
 	_conv_bytes_s(cvs[0], mp->pageSize, 1);
 	_conv_bytes_s(cvs[1], mp->chunkSize, 1);
-	_conv_bytes_s(cvs[2], mp->allocSizeMax, 1);
+	_conv_bytes_s(cvs[2], allocSizeMax, 1);
 	allocatorPrintf("memory page     %s\npool   block    %s\nsystem allocate %u, size %s\nsystem deletion %u\n",
-	                cvs[0], cvs[1], mp->allocCountMax, cvs[2], mp->allocCountMax);
+	                cvs[0], cvs[1], allocCountMax, cvs[2], allocCountMax);
 }
 
 void MemoryPageSetSize(MemoryPage* mp, uint size, uint chunks)
@@ -0,0 +1,354 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Common/PatternSet.h>
+#include <Common/Hash.h>
+#include <Common/StringLib.h>
+
+// empty hash slot, node without pattern
+#define PATTERN_NONE 0xFFFFFFFF
+
+namespace tas
+{
+
+/// prefix tree node, children as list of siblings
+struct PatternNode
+{
+	wchar_t ch;
+	uint child;   // first child, 0 none
+	uint next;    // next sibling, 0 none
+	uint pattern; // least index of pattern ends in node
+};
+
+struct PatternSet::impl
+{
+	uint count;
+
+	// exact names, open addressing
+	Array<wchar_t> text;
+	Array<uint> textOffset;
+	Array<uint> textLength;
+	Array<uint> exact; // pattern index in slot
+	uint exactMask;
+
+	// prefixes of patterns ends with '*', root is node 0
+	Array<PatternNode> tree;
+
+	// NFA of all wildcard patterns, state is position in pattern,
+	// token 0 is accept state of pattern
+	Array<wchar_t> token;
+	Array<uint> accept; // pattern index by state
+	Array<uint> start;
+	Array<uint> mark;   // generation of state in list
+	Array<uint> listCur;
+	Array<uint> listNext;
+	uint generation;
+
+	impl()
+	{
+		count = 0;
+		exactMask = 0;
+		generation = 0;
+	}
+
+	void clear()
+	{
+		count = 0;
+		exactMask = 0;
+		generation = 0;
+		text.clear();
+		textOffset.clear();
+		textLength.clear();
+		exact.clear();
+		tree.clear();
+		token.clear();
+		accept.clear();
+		start.clear();
+		mark.clear();
+		listCur.clear();
+		listNext.clear();
+	}
+
+	static uint hash(const wchar_t* s, uint length)
+	{
+		return HashMurmur2((byte*) s, length * sizeof(wchar_t), 0);
+	}
+
+	static bool equal(const wchar_t* a, const wchar_t* b, uint length)
+	{
+		forn(length)
+		{
+			if(a[i] != b[i])
+				return 0;
+		}
+		return 1;
+	}
+
+	void addExact(uint index, const wchar_t* s, uint length)
+	{
+		uint offset = text.size();
+		text.resize(offset + length);
+		mencpy(text.begin() + offset, (void*) s, length * sizeof(wchar_t));
+		textOffset[index] = offset;
+		textLength[index] = length;
+
+		// same name with less index stays in slot
+		uint h = hash(s, length) & exactMask;
+		while(exact[h] != PATTERN_NONE)
+		{
+			uint e = exact[h];
+			if(textLength[e] == length and equal(text.begin() + textOffset[e], s, length))
+				return;
+			h = h + 1 & exactMask;
+		}
+		exact[h] = index;
+	}
+
+	void addPrefix(uint index, const wchar_t* s, uint length)
+	{
+		uint node = 0;
+		forn(length)
+		{
+			uint child = tree[node].child;
+			while(child and tree[child].ch != s[i])
+				child = tree[child].next;
+			if(!child)
+			{
+				PatternNode n;
+				n.ch = s[i];
+				n.child = 0;
+				n.next = tree[node].child;
+				n.pattern = PATTERN_NONE;
+				child = tree.size();
+				tree.push_back(n);
+				tree[node].child = child;
+			}
+			node = child;
+		}
+		tree[node].pattern = MIN(tree[node].pattern, index);
+	}
+
+	void addWildcard(uint index, const wchar_t* s, uint length)
+	{
+		start.push_back(token.size());
+		forn(length)
+		{
+			// repeated '*' is one state
+			if(s[i] == '*' and i and s[i - 1] == '*')
+				continue;
+			token.push_back(s[i]);
+			accept.push_back(PATTERN_NONE);
+		}
+		token.push_back(0);
+		accept.push_back(index);
+	}
+
+	/// add state to list with states after '*', empty sequence
+	void addState(uint state, uint* list, uint& size)
+	{
+		wchar_t* t = token.begin();
+		uint* m = mark.begin();
+		while(m[state] != generation)
+		{
+			m[state] = generation;
+			list[size++] = state;
+			if(t[state] != '*')
+				break;
+			state++;
+		}
+	}
+
+	void nextGeneration()
+	{
+		if(++generation == 0)
+		{
+			forn(mark.size())
+			mark[i] = 0;
+			generation = 1;
+		}
+	}
+
+	uint matchExact(const wchar_t* name, uint length)
+	{
+		uint h = hash(name, length) & exactMask;
+		while(exact[h] != PATTERN_NONE)
+		{
+			uint e = exact[h];
+			if(textLength[e] == length and equal(text.begin() + textOffset[e], name, length))
+				return e;
+			h = h + 1 & exactMask;
+		}
+		return PATTERN_NONE;
+	}
+
+	uint matchPrefix(const wchar_t* name)
+	{
+		PatternNode* t = tree.begin();
+		uint node = 0;
+		uint best = t[0].pattern;
+		for(const wchar_t* s = name; *s; s++)
+		{
+			uint child = t[node].child;
+			while(child and t[child].ch != *s)
+				child = t[child].next;
+			if(!child)
+				break;
+			node = child;
+			best = MIN(best, t[node].pattern);
+		}
+		return best;
+	}
+
+	uint matchWildcard(const wchar_t* name)
+	{
+		wchar_t* t = token.begin();
+		uint* cur = listCur.begin();
+		uint* next = listNext.begin();
+		uint curSize = 0;
+
+		nextGeneration();
+		forn(start.size())
+		addState(start[i], cur, curSize);
+
+		for(const wchar_t* s = name; *s and curSize; s++)
+		{
+			nextGeneration();
+			uint nextSize = 0;
+			forn(curSize)
+			{
+				uint state = cur[i];
+				wchar_t c = t[state];
+				if(c == '*')
+					addState(state, next, nextSize);
+				else if(c == '?' or (c and c == *s))
+					addState(state + 1, next, nextSize);
+			}
+			uint* temp = cur;
+			cur = next;
+			next = temp;
+			curSize = nextSize;
+		}
+
+		uint best = PATTERN_NONE;
+		forn(curSize)
+		{
+			if(!t[cur[i]])
+				best = MIN(best, accept[cur[i]]);
+		}
+		return best;
+	}
+};
+
+PatternSet::PatternSet()
+{
+	_m = new impl;
+}
+
+PatternSet::~PatternSet()
+{
+	safe_delete(_m);
+}
+
+void PatternSet::compile(StringArray& patterns)
+{
+	_m->clear();
+	uint count = patterns.size();
+	_m->count = count;
+	_m->textOffset.resize(count);
+	_m->textLength.resize(count);
+
+	// kind of pattern: 0 exact, 1 prefix, 2 wildcard
+	byte* kind = new byte[count];
+	uint exactCount = 0;
+	forn(count)
+	{
+		String& pattern = patterns[i];
+		uint length = pattern.length();
+		uint stars = 0;
+		uint marks = 0;
+		form(u, length)
+		{
+			if(pattern[u] == '*')
+				stars++;
+			else if(pattern[u] == '?')
+				marks++;
+		}
+		if(!stars and !marks)
+			kind[i] = 0;
+		else if(stars == 1 and !marks and pattern[length - 1] == '*')
+			kind[i] = 1;
+		else
+			kind[i] = 2;
+		if(kind[i] == 0)
+			exactCount++;
+	}
+
+	// hash slots not less twice of names
+	if(exactCount)
+	{
+		uint slots = 16;
+		while(slots < exactCount * 2)
+			slots <<= 1;
+		_m->exact.resize(slots);
+		forn(slots)
+		_m->exact[i] = PATTERN_NONE;
+		_m->exactMask = slots - 1;
+	}
+
+	PatternNode root;
+	root.ch = 0;
+	root.child = 0;
+	root.next = 0;
+	root.pattern = PATTERN_NONE;
+	_m->tree.push_back(root);
+
+	forn(count)
+	{
+		String& pattern = patterns[i];
+		if(kind[i] == 0)
+			_m->addExact(i, pattern.p(), pattern.length());
+		else if(kind[i] == 1)
+			_m->addPrefix(i, pattern.p(), pattern.length() - 1);
+		else
+			_m->addWildcard(i, pattern.p(), pattern.length());
+	}
+	safe_delete_array(kind);
+
+	uint states = _m->token.size();
+	_m->mark.resize(states);
+	_m->listCur.resize(states);
+	_m->listNext.resize(states);
+	forn(states)
+	_m->mark[i] = 0;
+}
+
+int PatternSet::match(const wchar_t* name)
+{
+	uint best = PATTERN_NONE;
+	if(_m->exactMask)
+		best = _m->matchExact(name, stwlen((wchar_t*) name));
+	if(_m->tree.size())
+		best = MIN(best, _m->matchPrefix(name));
+	if(_m->start.size())
+		best = MIN(best, _m->matchWildcard(name));
+	return best == PATTERN_NONE ? -1 : (int) best;
+}
+
+uint PatternSet::size()
+{
+	return _m->count;
+}
+
+}
@@ -0,0 +1,140 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Common/Sha256.h>
+#include <Common/StringLib.h>
+
+#define ROTR(x, n) ((x) >> (n) | (x) << (32 - (n)))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define EP1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+namespace tas
+{
+
+// first 32 bits of fractional parts of cube roots of first 64 primes
+static const uint table[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+Sha256::Sha256()
+{
+	initialise();
+}
+
+Sha256::~Sha256()
+{
+}
+
+byte* Sha256::getDigest()
+{
+	return digest;
+}
+
+int Sha256::initialise()
+{
+	total = 0;
+	state[0] = 0x6A09E667;
+	state[1] = 0xBB67AE85;
+	state[2] = 0x3C6EF372;
+	state[3] = 0xA54FF53A;
+	state[4] = 0x510E527F;
+	state[5] = 0x9B05688C;
+	state[6] = 0x1F83D9AB;
+	state[7] = 0x5BE0CD19;
+	return 1;
+}
+
+void Sha256::transform(byte* block)
+{
+	uint w[64];
+	forn(16)
+	w[i] = (uint) block[i * 4] << 24 | block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 | block[i * 4 + 3];
+	for(uint i = 16; i < 64; i++)
+		w[i] = SIG1(w[i - 2]) + w[i - 7] + SIG0(w[i - 15]) + w[i - 16];
+
+	uint a = state[0], b = state[1], c = state[2], d = state[3];
+	uint e = state[4], f = state[5], g = state[6], h = state[7];
+	forn(64)
+	{
+		uint t1 = h + EP1(e) + CH(e, f, g) + table[i] + w[i];
+		uint t2 = EP0(a) + MAJ(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+byte* Sha256::calculate(byte* block, uint length, byte end)
+{
+	assert(end ? 1 : length % 64 == 0);
+	total += length;
+
+	uint full = length / 64;
+	forn(full)
+	transform(block + i * 64);
+
+	if(!end)
+		return digest;
+
+	// rest, 80h, zeros, message length in bits big endian
+	byte last[128];
+	uint mod = length % 64;
+	uint size = mod < 56 ? 64 : 128;
+	menset(last, 0, size);
+	mencpy(last, block + full * 64, mod);
+	last[mod] = 0x80;
+	wint bits = total << 3;
+	forn(8)
+	last[size - 1 - i] = (byte)(bits >> i * 8);
+	transform(last);
+	if(size == 128)
+		transform(last + 64);
+
+	forn(8)
+	{
+		digest[i * 4] = (byte)(state[i] >> 24);
+		digest[i * 4 + 1] = (byte)(state[i] >> 16);
+		digest[i * 4 + 2] = (byte)(state[i] >> 8);
+		digest[i * 4 + 3] = (byte) state[i];
+	}
+	return digest;
+}
+
+}
@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Common/Trace.h>
+#include <Common/Timer.h>
+#include <Common/FileStream.h>
+#include <stdio.h>
+
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+#include <Common/platform/swindows.h>
+#endif
+
+// thread local buffer, lock of threads list
+#if TAA_COMPILER == TAA_COMPILER_MSVC
+#define TRACE_THREAD __declspec(thread)
+#define trace_cas_int(o, c, n) InterlockedCompareExchange((volatile long*)&(o), n, c)
+#define trace_set_int(o, v) InterlockedExchange((volatile long*)&(o), v)
+#else
+#define TRACE_THREAD __thread
+#define trace_cas_int(o, c, n) __sync_val_compare_and_swap(&(o), c, n)
+#define trace_set_int(o, v) (__sync_synchronize(), (o) = (v))
+#endif
+#define TRACE_LOCK while(trace_cas_int(traceLock, 0, 1) != 0);
+#define TRACE_UNLOCK trace_set_int(traceLock, 0);
+
+#define TRACE_EVENTS (1 << 16)
+
+namespace tas
+{
+
+struct TraceEvent
+{
+	wint time;     // microseconds from start
+	wint duration; // of complete event
+	wint arg;
+	const char* name;
+	const char* cat;
+	byte phase;
+};
+
+/// ring buffer of thread
+struct TraceBuffer
+{
+	TraceEvent* events;
+	uint count;  // recorded events, position by mask
+	uint thread; // from 1 by first event
+	TraceBuffer* next;
+};
+
+byte traceEnabled = 0;
+
+static Timer traceTimer;
+static TraceBuffer* traceList = 0;
+static uint traceSize = TRACE_EVENTS; // power of 2
+static uint traceThreads = 0;
+static uint traceGeneration = 0;      // buffers of threads from start
+static int traceLock = 0;
+static TRACE_THREAD TraceBuffer* traceLocal = 0;
+static TRACE_THREAD uint traceLocalGeneration = 0;
+
+/// event place in ring of thread, buffer added by first event after start
+static TraceEvent* traceNext()
+{
+	if(traceLocalGeneration != traceGeneration)
+	{
+		TraceBuffer* buffer = new TraceBuffer;
+		buffer->events = new TraceEvent[traceSize];
+		buffer->count = 0;
+		TRACE_LOCK
+		buffer->thread = ++traceThreads;
+		buffer->next = traceList;
+		traceList = buffer;
+		TRACE_UNLOCK
+		traceLocal = buffer;
+		traceLocalGeneration = traceGeneration;
+	}
+	return &traceLocal->events[traceLocal->count++ & (traceSize - 1)];
+}
+
+void traceStart(uint events)
+{
+	traceEnabled = 0;
+	traceClear();
+	traceSize = 1;
+	while(traceSize < (events ? events : TRACE_EVENTS))
+		traceSize <<= 1;
+	traceTimer.reset();
+	traceEnabled = 1;
+}
+
+void traceStop()
+{
+	traceEnabled = 0;
+}
+
+void traceEvent(byte phase, const char* name, const char* cat, wint arg)
+{
+	wint time = traceTimer.getMicroseconds();
+	TraceEvent* e = traceNext();
+	e->time = time;
+	e->duration = 0;
+	e->arg = arg;
+	e->name = name;
+	e->cat = cat;
+	e->phase = phase;
+}
+
+void traceSpan(const char* name, const char* cat, wint duration, wint arg)
+{
+	wint time = traceTimer.getMicroseconds();
+	TraceEvent* e = traceNext();
+	e->time = time > duration ? time - duration : 0;
+	e->duration = duration;
+	e->arg = arg;
+	e->name = name;
+	e->cat = cat;
+	e->phase = 'X';
+}
+
+int traceSave(const String& name)
+{
+	FileStream file;
+	if(!file.open(name, 0))
+		return 0;
+
+	typedef unsigned long long ull;
+	char line[0x200];
+	int ret = 1;
+	int n = sprintf(line, "{\"traceEvents\":[\n");
+	ret &= file.storeBuffer(line, n) == (uint) n;
+
+	byte first = 1;
+	for(TraceBuffer* buffer = traceList; buffer; buffer = buffer->next)
+	{
+		n = sprintf(line, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+		            first ? "" : ",\n", buffer->thread, buffer->thread);
+		ret &= file.storeBuffer(line, n) == (uint) n;
+		first = 0;
+
+		// oldest events overwritten, end events may be without begin
+		uint begin = buffer->count > traceSize ? buffer->count - traceSize : 0;
+		for(uint i = begin; i < buffer->count and ret; i++)
+		{
+			TraceEvent& e = buffer->events[i & (traceSize - 1)];
+			n = sprintf(line, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,",
+			            e.name, e.cat, e.phase, (ull) e.time);
+			if(e.phase == 'X')
+				n += sprintf(line + n, "\"dur\":%llu,", (ull) e.duration);
+			n += sprintf(line + n, "\"pid\":1,\"tid\":%u,\"args\":{\"value\":%llu}}", buffer->thread, (ull) e.arg);
+			ret &= file.storeBuffer(line, n) == (uint) n;
+		}
+	}
+
+	n = sprintf(line, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	ret &= file.storeBuffer(line, n) == (uint) n;
+	return ret;
+}
+
+void traceClear()
+{
+	TRACE_LOCK
+	while(traceList)
+	{
+		TraceBuffer* buffer = traceList;
+		traceList = buffer->next;
+		safe_delete_array(buffer->events);
+		safe_delete(buffer);
+	}
+	traceThreads = 0;
+	// buffers of threads added again by next events
+	traceGeneration++;
+	TRACE_UNLOCK
+}
+
+}
@@ -19,13 +19,21 @@ limitations under the License.
 #include <Common/ConvertBytes.h>
 #include <Common/Bitwise.h>
 #include <Common/Crc32.h>
+#include <Common/Hash.h>
+#include <Common/Sha256.h>
 #include <Common/StringLib.h>
 #include <Common/UString.h>
 #include <Common/Timer.h>
 #include <Common/FileAccess.h>
 #include <Common/Aes.h>
 #include <Common/Math.h>
+#include <Common/PatternSet.h>
+#include <Common/Trace.h>
 #include <Compress/ICoder.h>
+#include <Compress/CoderStats.h>
+#include <Compress/CoderFactory.h>
+#include <Compress/ExeFilter.h>
+#include <Compress/DeltaFilter.h>
 #include <Common/container/Array.h>
 #include <Common/container/SmartPtr.h>
 #ifdef TAA_ARCHIVARIUS_COMPRESS
@@ -42,6 +50,16 @@ limitations under the License.
 #include <sys/resource.h>
 #endif
 
+#ifdef TAA_ARCHIVARIUS_THREAD
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+#include <Common/Thread.h>
+#define CRYPT_RET uint WINAPI
+#elif TAA_PLATFORM == TAA_PLATFORM_LINUX
+#include <pthread.h>
+#define CRYPT_RET void*
+#endif
+#endif
+
 #include <stdio.h>
 #include <time.h>
 #include <Common/platform/assert.h>
@@ -49,12 +67,52 @@ limitations under the License.
 namespace tas
 {
 
-// signature arv3, little endian, 4 byte
-#define ARCHIVE_SIGNATURE 0x33767261
+// signature arv4, little endian, 4 byte, directory after data
+#define ARCHIVE_SIGNATURE 0x34767261
+// signature arv3, file heads and names before data
+#define ARCHIVE_SIGNATURE_V3 0x33767261
+
+// compression level of directory stream
+#define DIRECTORY_LEVEL 5
 
 // memory block size for reading, writing
 #define BLOCK_SIZE 65536
 
+// filters of file data, delta stride in high bits
+#define FILTER_EXE 1
+#define FILTER_DELTA 2
+
+// first block of file tested for compression, smaller files compressed
+#define STORE_SIZE_MIN (1 << 14)
+
+// kind of file data by first block
+#define DATA_BINARY 0
+#define DATA_TEXT 1
+#define DATA_STORE 2
+
+// method of text in auto method, cm only on desktop
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+#define AUTO_TEXT_METHOD 2
+#else
+#define AUTO_TEXT_METHOD 1
+#endif
+
+// content defined chunks, average 64K by high 16 bits of gear hash
+#define CHUNK_MIN (1 << 14)
+#define CHUNK_MAX (1 << 18)
+#define CHUNK_MASK 0xFFFF000000000000ULL
+
+// content sketch of file for order by similar data, bands of
+// minimum hashes of 8 byte shingles in first block
+#define SKETCH_BANDS 4
+#define SKETCH_ROWS 2
+
+// encryption block, multiple of 16
+#define CRYPT_BLOCK (1 << 20)
+// encryption block part for thread, threads count
+#define CRYPT_PART (1 << 18)
+#define CRYPT_THREADS 4
+
 #pragma pack(push,1)
 struct ArchiveHeader
 {
@@ -76,7 +134,50 @@ struct ArchiveFileHeader
 	uint time[2]; // last modified time
 #endif
 };
+
+/** Files directory after data, arv4.
+  * Stream of records in order of files: shared prefix length with
+  * previous name, suffix length, suffix of UTF-8 name, size by varint
+  * with duplicate flag in low bit, distance to file with same data if
+  * duplicate, crc, time. Stream packed by LZRE, encrypted with names.
+  */
+struct ArchiveDirectory
+{
+	uint size;       // in archive, without crypt padding
+	uint sizeRaw;    // records stream
+	uint crc;        // records stream
+	byte method;     // 0 store, 1 lzre
+	byte dictionary; // 2 ^ n
+	byte minMatch;
+	half maxMatch;
+};
 #pragma pack(pop)
+
+// 7 bits in byte from low bits, high bit is continuation
+static byte* storeVarint(byte* p, wint value)
+{
+	while(value >= 0x80)
+	{
+		*p++ = (byte) value | 0x80;
+		value >>= 7;
+	}
+	*p++ = (byte) value;
+	return p;
+}
+
+static wint loadVarint(byte*& p)
+{
+	wint value = 0;
+	for(uint shift = 0; shift < 64; shift += 7)
+	{
+		byte b = *p++;
+		value |= (wint) (b & 0x7F) << shift;
+		if(b < 0x80)
+			break;
+	}
+	return value;
+}
+
 struct ArchiveFileList
 {
 	String name;
@@ -101,6 +202,428 @@ struct ArchiveFileList
 	}
 };
 
+/** Files table of opened archive, arrays by file index.
+  * Names in one block from single read of heads, each name ends with null.
+  */
+struct ArchiveFileTable
+{
+	Array<wint> size; // uncompressed
+	Array<wint> pos;
+	Array<uint> crc;
+	Array<uint> source; // file with same data, index of file if own data
+	Array<uint> filter; // filter of file data, 0 none
+	Array<byte> stored; // data without compression after compressed stream
+	Array<byte> segment; // compressed stream of file data
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+	Array<uint> time; // last modified time, 2 values of file
+#endif
+	Array<uint> nameOffset; // count + 1, last is end of names
+	Array<wchar_t> names;
+
+	uint count()
+	{
+		return crc.size();
+	}
+
+	wchar_t* name(uint i)
+	{
+		return names.begin() + nameOffset.begin()[i];
+	}
+
+	uint nameLength(uint i)
+	{
+		return nameOffset.begin()[i + 1] - nameOffset.begin()[i] - 1;
+	}
+
+	void resize(uint n)
+	{
+		size.resize(n);
+		pos.resize(n);
+		crc.resize(n);
+		source.resize(n);
+		filter.resize(n);
+		stored.resize(n);
+		segment.resize(n);
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+		time.resize(n * 2);
+#endif
+		nameOffset.resize(n + 1);
+	}
+
+	void clear()
+	{
+		size.clear();
+		pos.clear();
+		crc.clear();
+		source.clear();
+		filter.clear();
+		stored.clear();
+		segment.clear();
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+		time.clear();
+#endif
+		nameOffset.clear();
+		names.clear();
+	}
+};
+
+/** Content defined chunks of files data for repeats beyond dictionary.
+  * Boundary of chunk by gear rolling hash, chunk with same size and SHA-256
+  * digest as chunk before is replaced by reference to it, references by triples:
+  * literal bytes before reference, length, distance back in files data.
+  */
+struct ArchiveChunker
+{
+	wint gear[256];
+	Array<byte> data; // current chunk
+	uint size;
+	wint roll;
+	byte boundary;
+	wint pos;     // current chunk in files data
+	wint literal; // bytes after previous reference
+
+	// index of chunks, open addressing, empty slot is size 0
+	Array<wint> slotHash;   // of index, not for equality
+	Array<byte> slotDigest; // SHA-256 of chunk, 32 bytes per slot
+	Array<wint> slotPos;
+	Array<uint> slotSize;
+	uint slotsUsed;
+	Sha256 sha;
+
+	uint repeats;
+	wint repeatsSize;
+
+	ArchiveChunker()
+	{
+		forn(256)
+		gear[i] = HashMurmur64A((byte*) &i, sizeof(i), 0x9E3779B97F4A7C15ULL);
+		data.resize(CHUNK_MAX);
+		size = 0;
+		roll = 0;
+		boundary = 0;
+		pos = 0;
+		literal = 0;
+		slotsUsed = 0;
+		repeats = 0;
+		repeatsSize = 0;
+		resizeIndex(1 << 12);
+	}
+
+	void resizeIndex(uint slots)
+	{
+		Array<wint> hash;
+		Array<byte> digest;
+		Array<wint> position;
+		Array<uint> length;
+		hash.resize(slots);
+		digest.resize(slots * 32);
+		position.resize(slots);
+		length.resize(slots);
+		forn(slots)
+		length[i] = 0;
+		uint mask = slots - 1;
+		forn(slotSize.size())
+		{
+			if(!slotSize[i])
+				continue;
+			uint h = (uint) slotHash[i] & mask;
+			while(length[h])
+				h = h + 1 & mask;
+			hash[h] = slotHash[i];
+			mencpy(&digest[h * 32], &slotDigest[i * 32], 32);
+			position[h] = slotPos[i];
+			length[h] = slotSize[i];
+		}
+		slotHash = hash;
+		slotDigest = digest;
+		slotPos = position;
+		slotSize = length;
+	}
+
+	/// add data to chunk until boundary, return count of added bytes
+	uint fill(byte* src, uint n)
+	{
+		byte* d = data.begin();
+		uint i = 0;
+		while(i < n and !boundary)
+		{
+			byte b = src[i++];
+			d[size++] = b;
+			roll = (roll << 1) + gear[b];
+			if((size >= CHUNK_MIN and !(roll & CHUNK_MASK)) or size == CHUNK_MAX)
+				boundary = 1;
+		}
+		return i;
+	}
+
+	/// chunk of slot is same as current, digest compared by hash and size equal
+	byte same(uint h, wint hash, byte* digest)
+	{
+		if(slotHash[h] != hash or slotSize[h] != size)
+			return 0;
+		byte* d = &slotDigest[h * 32];
+		forn(32)
+		if(d[i] != digest[i])
+			return 0;
+		return 1;
+	}
+
+	/** Complete current chunk, repeated chunk to references.
+	  * @return 1 if chunk is new data, 0 if reference.
+	  */
+	byte complete(Array<wint>& refs)
+	{
+		wint hash = HashMurmur64A(data.begin(), size, 0);
+		sha.initialise();
+		byte* digest = sha.calculate(data.begin(), size, 1);
+		uint mask = slotSize.size() - 1;
+		uint h = (uint) hash & mask;
+		while(slotSize[h] and !same(h, hash, digest))
+			h = h + 1 & mask;
+
+		byte fresh = !slotSize[h];
+		if(fresh)
+		{
+			slotHash[h] = hash;
+			mencpy(&slotDigest[h * 32], digest, 32);
+			slotPos[h] = pos;
+			slotSize[h] = size;
+			literal += size;
+			if(++slotsUsed * 2 > slotSize.size())
+				resizeIndex(slotSize.size() * 2);
+		}
+		else
+		{
+			refs.push_back(literal);
+			refs.push_back(size);
+			refs.push_back(pos - slotPos[h]);
+			literal = 0;
+			repeats++;
+			repeatsSize += size;
+		}
+		pos += size;
+		size = 0;
+		boundary = 0;
+		return fresh;
+	}
+
+	/// data coded without chunks, literal bytes for next reference
+	void skip(uint n)
+	{
+		pos += n;
+		literal += n;
+	}
+};
+
+/// order of appended file, same extension, then name, size
+struct ArchiveFileOrder
+{
+	wint ext;   // hash of extension in lower case, 0 without extension
+	wint size;
+	uint name;  // name after path
+	uint index; // in appended files
+	wint group; // first file of similar data, then file in order by names
+};
+
+/// compare of files order by names or by groups of similar data
+struct ArchiveFileCompare
+{
+	StringArray* files;
+	byte similar;
+
+	int operator()(const ArchiveFileOrder& a, const ArchiveFileOrder& b)
+	{
+		if(similar)
+			return a.group < b.group ? -1 : a.group > b.group;
+		if(a.ext != b.ext)
+			return a.ext < b.ext ? -1 : 1;
+		wchar_t* na = (*files)[a.index].p() + a.name;
+		wchar_t* nb = (*files)[b.index].p() + b.name;
+		while(*na and *na == *nb)
+		{
+			na++;
+			nb++;
+		}
+		if(*na != *nb)
+			return *na < *nb ? -1 : 1;
+		if(a.size != b.size)
+			return a.size < b.size ? -1 : 1;
+		return a.index < b.index ? -1 : a.index > b.index;
+	}
+};
+
+// part of encryption block
+struct CryptPart
+{
+	Aes* aes;
+	byte* data;
+	uint size;
+	uint pos;
+	byte dec;
+};
+
+static void cryptPart(CryptPart* part)
+{
+	if(part->dec)
+		part->aes->decrypt(part->data, part->size, part->pos);
+	else
+		part->aes->encrypt(part->data, part->size, part->pos);
+}
+
+#if defined(TAA_ARCHIVARIUS_THREAD) and (TAA_PLATFORM == TAA_PLATFORM_WINDOWS or TAA_PLATFORM == TAA_PLATFORM_LINUX)
+#define CRYPT_WORKERS
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+// auto reset events of xp, start event for each thread, waits in lock by while
+#define crypt_lock(w) EnterCriticalSection(&(w)->lock)
+#define crypt_unlock(w) LeaveCriticalSection(&(w)->lock)
+#define crypt_wait_start(w, i) (crypt_unlock(w), WaitForSingleObject((w)->start[i], INFINITE), crypt_lock(w))
+#define crypt_wait_done(w) (crypt_unlock(w), WaitForSingleObject((w)->done, INFINITE), crypt_lock(w))
+#define crypt_wake_start(w) forn(CRYPT_THREADS - 1) SetEvent((w)->start[i])
+#define crypt_wake_done(w) SetEvent((w)->done)
+#else
+#define crypt_lock(w) pthread_mutex_lock(&(w)->lock)
+#define crypt_unlock(w) pthread_mutex_unlock(&(w)->lock)
+#define crypt_wait_start(w, i) pthread_cond_wait(&(w)->start, &(w)->lock)
+#define crypt_wait_done(w) pthread_cond_wait(&(w)->done, &(w)->lock)
+#define crypt_wake_start(w) pthread_cond_broadcast(&(w)->start)
+#define crypt_wake_done(w) pthread_cond_broadcast(&(w)->done)
+#endif
+
+/** Threads of encryption parts, started once for archive.
+  * Each run wakes threads for all parts except last,
+  * last part and parts without thread done by caller.
+  */
+struct CryptWorkers
+{
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+	CRITICAL_SECTION lock;
+	HANDLE start[CRYPT_THREADS - 1];
+	HANDLE done;
+	uint* threads[CRYPT_THREADS - 1];
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	pthread_t threads[CRYPT_THREADS - 1];
+#endif
+	CryptPart* parts;
+	uint count;      // started threads
+	uint indexes;    // parts index of thread by start order
+	uint active;     // parts of threads in run
+	uint pending;    // threads not finished run
+	uint generation; // of run
+	byte exit;
+
+	CryptWorkers();
+	~CryptWorkers();
+
+	/// crypt parts, return after end of all parts
+	void run(CryptPart* part, uint n);
+};
+
+static CRYPT_RET crypt_thread(void* param)
+{
+	CryptWorkers* w = (CryptWorkers*) param;
+	uint generation = 0;
+	crypt_lock(w);
+	uint index = w->indexes++;
+	while(1)
+	{
+		while(w->generation == generation and !w->exit)
+			crypt_wait_start(w, index);
+		if(w->exit)
+			break;
+		generation = w->generation;
+		CryptPart* part = index < w->active ? &w->parts[index] : 0;
+		crypt_unlock(w);
+		if(part)
+			cryptPart(part);
+		crypt_lock(w);
+		if(!--w->pending)
+			crypt_wake_done(w);
+	}
+	crypt_unlock(w);
+	return 0;
+}
+
+CryptWorkers::CryptWorkers()
+{
+	parts = 0;
+	count = 0;
+	indexes = 0;
+	active = 0;
+	pending = 0;
+	generation = 0;
+	exit = 0;
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+	InitializeCriticalSection(&lock);
+	forn(CRYPT_THREADS - 1)
+	start[i] = CreateEvent(0, FALSE, FALSE, 0);
+	done = CreateEvent(0, FALSE, FALSE, 0);
+	forn(CRYPT_THREADS - 1)
+	{
+		threads[count] = thread_create(crypt_thread, this);
+		if(threads[count])
+			count++;
+	}
+#else
+	pthread_mutex_init(&lock, 0);
+	pthread_cond_init(&start, 0);
+	pthread_cond_init(&done, 0);
+	forn(CRYPT_THREADS - 1)
+	{
+		if(pthread_create(&threads[count], 0, crypt_thread, this) == 0)
+			count++;
+	}
+#endif
+}
+
+CryptWorkers::~CryptWorkers()
+{
+	crypt_lock(this);
+	exit = 1;
+	crypt_wake_start(this);
+	crypt_unlock(this);
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+	forn(count)
+	{
+		thread_close_wait(threads[i], INFINITE);
+	}
+	forn(CRYPT_THREADS - 1)
+	CloseHandle(start[i]);
+	CloseHandle(done);
+	DeleteCriticalSection(&lock);
+#else
+	forn(count)
+	pthread_join(threads[i], 0);
+	pthread_cond_destroy(&start);
+	pthread_cond_destroy(&done);
+	pthread_mutex_destroy(&lock);
+#endif
+}
+
+void CryptWorkers::run(CryptPart* part, uint n)
+{
+	crypt_lock(this);
+	parts = part;
+	active = MIN(n - 1, count);
+	pending = count;
+	generation++;
+	crypt_wake_start(this);
+	crypt_unlock(this);
+
+	for(uint i = active; i < n; i++)
+		cryptPart(&part[i]);
+
+	crypt_lock(this);
+	while(pending)
+		crypt_wait_done(this);
+	crypt_unlock(this);
+}
+#else
+struct CryptWorkers;
+#endif
+
 struct Archive::impl
 {
 	byte errorId;
@@ -108,7 +631,8 @@ struct Archive::impl
 
 	FileStream archive;
 	ArchiveHeader arcHead;
-	Array<ArchiveFileList*> fileList;
+	ArchiveFileTable fileTable;
+	Array<ArchiveFileList*> fileList; // items of table for file manager, cleared with table
 	Array<uint>* cutPaths;
 	TextStream* log;
 	Aes encryption;
@@ -116,6 +640,7 @@ struct Archive::impl
 	byte archiveHeadSize;
 	byte archiveHeadSizeTotal;
 	byte archiveFileHeadSize;
+	wint dataEnd; // directory position, arv3 end of archive
 	wint sourceFileSize;
 	uint totalFileHeadSize;
 	uint dataPos;
@@ -134,12 +659,33 @@ struct Archive::impl
 	uint encodeSuffix; // [11]
 
 	uint matchRolzOut;
+	uint encodeHistory; // bit history states, cmix
+	uint bigraphFormat; // 0 single table, 1 blocks of pairs, 2 blocks of rules
+	uint encodeWindow;  // lzre long matches window, 0 disable
+	uint longWindow;    // window of coder, dictionary by 4^n
 
 	uint paramsOpen[11];
 	uint paramsCur[11];
 
-	wint bigraphSize; // file
+	// repeated chunks of files data, triples of ArchiveChunker,
+	// decoding state: next triple, literal bytes before it, position
+	Array<wint> chunkRefs;
+	uint chunkRef;
+	wint chunkLiteral;
+	wint chunkPos;
+
+	wint storedSize; // data of stored files at end of archive data
+
+	// compressed streams one after another, first by props of header,
+	// size of stream in archive
+	Array<uint> segmentProps;
+	Array<wint> segmentSize;
+
+	wint bigraphSize; // preprocessed stream
+	wint memoryLimit; // coder, buffers memory, 0 no limit
+	wint memoryUsage;
 	byte deleteState;
+	byte sortSimilar; // order of files by similar data
 
 	String decFile; // uncompressed file
 	String decPath; // extract dir
@@ -158,7 +704,8 @@ struct Archive::impl
 	UString cryptString;
 	UString cryptStringSave;
 	uint   cryptLength; // key
-	byte*  cryptBuffer; // 512 byte
+	byte*  cryptBuffer; // encryption block, CRYPT_BLOCK + 16 byte
+	CryptWorkers* cryptWorkers; // threads started by first data of parts
 	uint   cryptBufferSize;
 	Crc32  crc;
 
@@ -167,8 +714,12 @@ struct Archive::impl
 
 	byte* mem;
 	byte* memEnc;
+	byte* memBigraph;
 
 	Timer timer;
+	Timer stageTimer;    // stages of stats, not reset
+	CoderStats stats;    // stages of last append, extract
+	char statsText[0x400];
 	uint msecondsp;
 	uint mseconds;
 	uint seconds;
@@ -184,9 +735,147 @@ struct Archive::impl
 	int list();
 	int checkCrypt();
 
-	int sortFileExt(StringArray& filesIn, StringArray& filesOut);
+	/** Order of appended files by extension, name and size,
+	  * files with similar data after first of them if sortSimilar.
+	  */
+	int sortFiles(StringArray& filesIn, StringArray& filesOut);
+
+	/** MinHash sketch of first block of file, rows of minimum hashes.
+	  * @param sketch[out] SKETCH_BANDS * SKETCH_ROWS values.
+	  * @return 0 if file is less 8 bytes or not opened.
+	  */
+	byte sketchFile(const String& name, wint* sketch);
+
+	/// build file list items from files table once
+	void buildFileList();
 	void logTime(uint filesCount);
 	ICoder* createMethod(byte mode);
+
+	/// encoding properties of archive header from current parameters
+	uint encodeProps();
+
+	/// parameters from encoding properties
+	void decodeProps(uint props);
+
+	/** Encoder of next stream by parameters of user and method,
+	  * cm stream starts with size of data.
+	  * @param size Data of stream.
+	  * @return Encoding properties of stream.
+	  */
+	uint beginSegment(SmartPtr<ICoder>& encoder, byte method, wint size, wint& cryptPos);
+
+	/** Store files directory after data, names crypt applies to directory.
+	  * @param names UTF-8 names one after another, lengths in heads.
+	  * @param source Index of previous file with same data, else own index.
+	  * @param filter Filter of file data, 0 none.
+	  * @param stored File data stored without compression.
+	  * @param segment Compressed stream of file data, streams in segmentProps.
+	  * @return Size of directory in archive.
+	  */
+	uint storeDirectory(FileStream& file, ArchiveFileHeader* fileHeads, byte* names,
+	                    uint* source, uint* filter, byte* stored, byte* segment, uint filesCount);
+
+	/** Read directory from end of data.
+	  * @param names[out] UTF-8 names one after another, lengths to heads.
+	  * @param source[out] Index of file with same data, else own index.
+	  * @param filter[out] Filter of file data, 0 none.
+	  * @param stored[out] File data stored without compression.
+	  * @param segment[out] Compressed stream of file data, streams to segmentProps.
+	  * @return Size of directory in archive, 0 if damaged.
+	  */
+	uint readDirectory(ArchiveFileHeader* fileHeads, Array<byte>& names,
+	                   uint* source, uint* filter, byte* stored, byte* segment, uint filesCount);
+
+	/** Search appended files with same data, by size, then by hash of data,
+	  * then by compare of data with first file of same hash.
+	  * @param source[out] Index of first file with same data, else own index.
+	  * @return Size of data without duplicates.
+	  */
+	wint dedupFiles(StringArray& files, ArchiveFileHeader* fileHeads, uint* source, uint filesCount);
+
+	/// hash of file data by blocks, 0 if file not opened
+	wint hashFile(const String& name);
+
+	/** Search appended files with incompressible data by first block.
+	  * @param kind[out] Kind of own data of file, DATA_STORE without compression.
+	  * @param text Search text data in all files.
+	  * @return Size of stored data.
+	  */
+	wint sniffFiles(StringArray& files, ArchiveFileHeader* fileHeads, uint* source,
+	                byte* kind, byte text, uint filesCount);
+
+	/** Test data for compression: order 0 entropy near 8 bits
+	  * and few repeats found by hash of 4 bytes.
+	  * @return 1 if data is incompressible.
+	  */
+	byte incompressible(byte* data, uint size);
+
+	/// 1 if data without zero bytes and with few control codes
+	byte textData(byte* data, uint size);
+
+	/// 1 if data of files is same
+	int compareFiles(const String& name0, const String& name1);
+
+	/** LZRE directory stream, mode 1 compress, 2 uncompress.
+	  * @param dir[in, out] Parameters of coder, sizes.
+	  * @return 0 if stream damaged.
+	  */
+	int codeDirectory(byte* src, uint size, Array<byte>& dst, ArchiveDirectory& dir, byte mode);
+
+	/// memory of encoder and archive buffers for current parameters
+	wint encodeMemory();
+
+	/** Shrink dictionary, then match hash of LZRE to memory limit,
+	  * parameters not less minimum, chosen values to console.
+	  */
+	void fitMemory();
+	int compressBlock(SmartPtr<ICoder>& encoder, CoderStream* sm, byte flush, wint& cryptPos);
+
+	/// add time from begin and bytes to stage of stats and trace
+	void stageEnd(byte stage, wint begin, wint bytes)
+	{
+		wint time = stageTimer.getMicroseconds() - begin;
+		stats.time[stage] += time;
+		stats.bytes[stage] += bytes;
+		TRACE_SPAN(CoderStats::stageName(stage), stage == STAGE_READ or stage == STAGE_WRITE ? "io" :
+		           stage == STAGE_MATCH or stage == STAGE_CODE ? "coder" : "data", time, bytes);
+	}
+
+	/// progress to callback, traced for time of gui
+	int callEvent(wint* data)
+	{
+		TRACE_BEGIN("callback", "gui", 0);
+		int ret = event_callback(data);
+		TRACE_END("callback", "gui", 0);
+		return ret;
+	}
+
+	/// data by blocks to bigraph if enabled, then to encoder
+	int encodeData(SmartPtr<ICoder>& encoder, SmartPtr<BigraphCoder>& encoderBigraph,
+	               CoderStream* coderStream, CoderStream* bigraphStream,
+	               byte* data, uint size, byte flush, wint& cryptPos);
+
+	/** Decoded files data to file, repeated chunks copied from file
+	  * after literal bytes of references.
+	  * @return 0 if reference out of written data.
+	  */
+	int storeDecoded(FileStream& file, byte* data, uint size);
+
+	/// key expansion from crypt string, encryption block
+	void cryptInit();
+
+	/** Encrypt stream by blocks, stream is encrypted as single data
+	  * from position 0, block store without last 16 bytes
+	  * for ciphertext stealing at end, file is not rewound.
+	  * @param flush End of stream, stream less 16 bytes padded with zeros.
+	  * @return Count of padding bytes.
+	  */
+	uint cryptStore(FileStream& file, byte* data, uint size, wint& cryptPos, byte flush);
+
+	/** Encrypt, decrypt data in place, parts of data by position to threads.
+	  * @param size Multiple of 16, else end of stream.
+	  */
+	void cryptData(byte* data, uint size, wint pos, byte dec);
 	int getTime();
 	char* getUnicode(const String& wides);
 	int logWriteLinef(const char* fmt, ...);
@@ -204,6 +893,7 @@ Archive::Archive()
 	_m->archiveHeadSizeTotal = 0;
 	_m->archiveHeadSize = sizeof(ArchiveHeader);
 	_m->archiveFileHeadSize = sizeof(ArchiveFileHeader);
+	_m->dataEnd = 0;
 	_m->sourceFileSize = 0;
 	_m->totalFileHeadSize = 0;
 	_m->dataPos = 0;
@@ -214,13 +904,24 @@ Archive::Archive()
 	_m->encodeBigraph = 0;
 	_m->encodeCmix = 0;
 	_m->bigraphSize = 0;
+	_m->chunkRef = 0;
+	_m->chunkLiteral = 0;
+	_m->chunkPos = 0;
+	_m->storedSize = 0;
+	_m->memoryLimit = 0;
+	_m->memoryUsage = 0;
 	_m->deleteState = 0;
+	_m->sortSimilar = 0;
 	_m->dictSize = 0;
 	_m->matchMax = 0;
 	_m->matchCycles = 0;
 	_m->matchMin = 0;
 	_m->matchRolz = 0;
 	_m->matchRolzOut = 0;
+	_m->encodeHistory = 0;
+	_m->bigraphFormat = 0;
+	_m->encodeWindow = 0;
+	_m->longWindow = 0;
 	_m->encodeSuffix = 0;
 	_m->cryptState = 0;
 	_m->cryptLength = 0;
@@ -233,11 +934,13 @@ Archive::Archive()
 	_m->ratioUn = 0;
 	_m->mem = 0;
 	_m->memEnc = 0;
+	_m->memBigraph = 0;
 	_m->buffer.reserve(1024);
 	_m->bufferu.reserve(1024);
 	_m->format.reserve(1024);
 	_m->formated.reserve(1024);
-	_m->cryptBuffer = new byte[512];
+	_m->cryptBuffer = 0;
+	_m->cryptWorkers = 0;
 	_m->cryptBufferSize = 0;
 	_m->crc.tableInit();
 	_m->msecondsp = 0;
@@ -251,7 +954,11 @@ Archive::~Archive()
 	close();
 	safe_delete_array(_m->mem);
 	safe_delete_array(_m->memEnc);
+	safe_delete_array(_m->memBigraph);
 	safe_delete_array(_m->cryptBuffer);
+#ifdef CRYPT_WORKERS
+	safe_delete(_m->cryptWorkers);
+#endif
 	safe_delete(_m);
 }
 
@@ -299,12 +1006,18 @@ int Archive::resetCrypt()
 
 int Archive::append(StringArray& files)
 {
-	return _m->append(files);
+	_m->stats.reset();
+	int ret = _m->append(files);
+	_m->stats.splitCoderTime();
+	return ret;
 }
 
 int Archive::extract(void* _files)
 {
-	return _m->extract(_files);
+	_m->stats.reset();
+	int ret = _m->extract(_files);
+	_m->stats.splitCoderTime();
+	return ret;
 }
 
 int Archive::remove(StringArray& files)
@@ -345,7 +1058,7 @@ int Archive::impl::open(const String& name, byte _mode)
 	}
 
 	// check header signature
-	if(arcHead.signature != ARCHIVE_SIGNATURE)
+	if(arcHead.signature != ARCHIVE_SIGNATURE and arcHead.signature != ARCHIVE_SIGNATURE_V3)
 	{
 		errorId = 3;
 		errorStr = "Archive format not supported";
@@ -364,25 +1077,7 @@ int Archive::impl::open(const String& name, byte _mode)
 	// open state
 	mode = 2;
 
-	// decode props
-	uint props = arcHead.encodeProps;
-	encodeMethod = props & 0x0F;
-	if(encodeMethod and encodeMethod < 3)
-	{
-		encodeLevel = (props >> 28) & 0x0F;
-		dictSize = 1 << ((props >> 23) & 0x1F);
-		if(encodeMethod == 1)
-		{
-			matchMax = 1 << ((props >> 19) & 0x0F);
-			matchMin = (props >> 15) & 0x0F;
-			matchRolz = (props >> 13) & 0x03;
-			encodeThreads = (props >> 11) & 0x03;
-			encodeCmix = (props >> 10) & 0x01;
-		}
-		if(encodeMethod == 2)
-			matchMax = (props >> 19) & 0x0F;
-		encodeBigraph = (props >> 4) & 0x01;
-	}
+	decodeProps(arcHead.encodeProps);
 
 	// save all params
 	uint* param = &encodeMethod;
@@ -415,106 +1110,182 @@ int Archive::impl::open(const String& name, byte _mode)
 
 	uint filesCount = arcHead.filesCount;
 
-	// build files list
 	ArchiveFileHeader* fileHeads = new ArchiveFileHeader[filesCount];
-	String fileName;
-	fileList.reserve(filesCount);
-
-	// read file heads
-	archive.readBuffer(fileHeads, filesCount * archiveFileHeadSize);
+	Array<byte> namesData;
+	uint namesSize = 0;
+	fileList.clear_ptr();
+	fileTable.resize(filesCount);
+	uint* source = fileTable.source.begin();
+	uint* filter = fileTable.filter.begin();
+	byte* stored = fileTable.stored.begin();
+	byte* segment = fileTable.segment.begin();
 
-	wint totalSize = 0;
-	if(cryptState & 1)
-	{
-		forn(filesCount)
-		totalSize += fileHeads[i].nameLen;
-		if(totalSize < 16)
-			totalSize = 16;
-	}
+	// one stream by props of header, other streams in directory
+	segmentProps.resize(1);
+	segmentSize.resize(1);
+	segmentProps[0] = arcHead.encodeProps;
 
-	uint cryptPos = 0;
-	uint cryptPosw = 0;
+	cryptBufferSize = 0;
 	if(cryptState & 1)
 	{
 		assert(cryptLength);
-		encryption.keyExpansion((byte*)cryptString.p(), cryptLength);
+		cryptInit();
 	}
 
-	// read file names
-	UString& fileNameUni = bufferu;
-	forn(filesCount)
+	if(arcHead.signature == ARCHIVE_SIGNATURE)
 	{
-		ArchiveFileList* list = new ArchiveFileList;
-		fileNameUni.clear();
-
-		if((cryptState & 1) == 0)
+		// directory after data
+		uint dirSize = readDirectory(fileHeads, namesData, source, filter, stored, segment, filesCount);
+		if(!dirSize)
 		{
-			fileNameUni.reserve(fileHeads[i].nameLen + 10);
-			archive.readBuffer(fileNameUni.p(), fileHeads[i].nameLen);
-			fileNameUni[fileHeads[i].nameLen] = 0;
-			fileNameUni.update();
-			list->name.assign(fileNameUni.p(), fileHeads[i].nameLen);
-		}
-
-		// decrypt name
-		if(cryptState & 1)
-		{
-			fileNameUni.reserve(fileHeads[i].nameLen + 10);
-			form(u, fileHeads[i].nameLen)
-			{
-				if(cryptBufferSize == 0)
-				{
-					cryptBufferSize = 512;
-					if(cryptBufferSize > totalSize)
-						cryptBufferSize = totalSize;
-					if(totalSize > 512 and totalSize < 528)
-						cryptBufferSize = 480;
-					totalSize -= cryptBufferSize;
-					archive.readBuffer(cryptBuffer, cryptBufferSize);
-					encryption.decrypt(cryptBuffer, cryptBufferSize, cryptPos);
-					cryptPos += cryptBufferSize;
-					cryptPosw = 0;
-				}
-				fileNameUni[u] = cryptBuffer[cryptPosw++];
-				cryptBufferSize--;
-			}
-			fileNameUni[fileHeads[i].nameLen] = 0;
-			fileNameUni.update();
-			list->name.assign(fileNameUni.p(), fileHeads[i].nameLen);
+			errorId = 5;
+			errorStr = "Archive is damaged";
+			safe_delete_array(fileHeads);
+			archive.close();
+			return 0;
 		}
-		form(u, list->name.length())
+		forn(filesCount)
+		namesSize += fileHeads[i].nameLen;
+		totalFileHeadSize = dirSize;
+		dataPos = archiveHeadSize;
+		dataEnd = dataPos + arcHead.dataSize;
+		archive.seekw(dataPos, 0);
+	}
+	else
+	{
+		// read file heads, then all names by one read
+		archive.readBuffer(fileHeads, filesCount * archiveFileHeadSize);
+		forn(filesCount)
 		{
-			if(list->name[u] == PATH_SEP_REV)
-				list->name[u] = PATH_SEP;
+			namesSize += fileHeads[i].nameLen;
+			source[i] = i;
+			filter[i] = 0;
+			stored[i] = 0;
+			segment[i] = 0;
 		}
-		list->size = fileHeads[i].size;
-		list->crc = fileHeads[i].crc;
-		sourceFileSize += fileHeads[i].size;
-		list->pos = 0;
+		totalFileHeadSize = filesCount * archiveFileHeadSize + namesSize;
+
+		// crypt stream less 16 bytes padded
+		uint namesRead = namesSize;
+		if(cryptState & 1 and namesRead < 16)
+			namesRead = 16;
+		namesData.resize(namesRead);
+		archive.readBuffer(namesData.begin(), namesRead);
+		if(cryptState & 1)
+			cryptData(namesData.begin(), namesRead, 0, 1);
+		dataPos = archive.tellw();
+		dataEnd = archiveSize;
+	}
+
+	// names in UTF-16 not longer than in UTF-8
+	fileTable.names.resize(namesSize + filesCount);
+	wchar_t* names = fileTable.names.begin();
+	uint* nameOffset = fileTable.nameOffset.begin();
+	byte* nameData = namesData.begin();
+	uint offset = 0;
+	String& fileName = buffer;
+	forn(filesCount)
+	{
+		uint nameLen = fileHeads[i].nameLen;
+		nameOffset[i] = offset;
+		fileName.clear();
+		fileName.assign((char*) nameData, nameLen);
+		mencpy(names + offset, fileName.p(), fileName.length() * sizeof(wchar_t));
+		offset += fileName.length();
+		names[offset++] = 0;
+		nameData += nameLen;
+
+		fileTable.size[i] = fileHeads[i].size;
+		fileTable.crc[i] = fileHeads[i].crc;
 #if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
-		list->time[0] = fileHeads[i].time[0];
-		list->time[1] = fileHeads[i].time[1];
+		fileTable.time[i * 2] = fileHeads[i].time[0];
+		fileTable.time[i * 2 + 1] = fileHeads[i].time[1];
 #endif
-		fileList.push_back(list);
-		totalFileHeadSize += archiveFileHeadSize + fileHeads[i].nameLen;
+		sourceFileSize += fileHeads[i].size;
 	}
+	nameOffset[filesCount] = offset;
 	totalFileHeadSize += archiveHeadSize;
 
+	forn(offset)
+	{
+		if(names[i] == PATH_SEP_REV)
+			names[i] = PATH_SEP;
+	}
+
 	// read preprocessed bigraph file size
 	if(encodeBigraph)
 		bigraphSize = arcHead.procSize;
 
-	// save offset to data
-	dataPos = archive.tellw();
+	wint* filePos = fileTable.pos.begin();
+	wint* fileSize = fileTable.size.begin();
+
+	// stored files after compressed stream, encrypted by files,
+	// file less 16 bytes padded, empty file without data
+	storedSize = 0;
+	forn(filesCount)
+	{
+		if(source[i] == i and stored[i])
+			storedSize += cryptState & 2 and fileSize[i] and fileSize[i] < 16 ? 16 : fileSize[i];
+	}
+	if(storedSize > arcHead.dataSize)
+	{
+		errorId = 5;
+		errorStr = "Archive is damaged";
+		safe_delete_array(fileHeads);
+		archive.close();
+		return 0;
+	}
+
+	// streams one after another, first stream is rest of data
+	uint segments = segmentProps.size();
+	segmentSize[0] = arcHead.dataSize - storedSize;
+	for(uint s = 1; s < segments; s++)
+	{
+		if(segmentSize[s] > segmentSize[0])
+		{
+			errorId = 5;
+			errorStr = "Archive is damaged";
+			safe_delete_array(fileHeads);
+			archive.close();
+			return 0;
+		}
+		segmentSize[0] -= segmentSize[s];
+	}
+
+	// decoded streams one after another in temp file
+	Array<wint> segmentPos;
+	segmentPos.resize(segments);
+	forn(segments)
+	segmentPos[i] = 0;
+	forn(filesCount)
+	{
+		if(source[i] == i and !stored[i])
+			segmentPos[segment[i]] += fileSize[i];
+	}
+	wint decoded = 0;
+	forn(segments)
+	{
+		wint size = segmentPos[i];
+		segmentPos[i] = decoded;
+		decoded += size;
+	}
 
-	wint pos = encodeMethod ? 0 : archive.tellw();
-	forn(fileList.size())
+	wint pos = encodeMethod ? 0 : dataPos;
+	wint posStored = dataEnd - storedSize;
+	forn(filesCount)
 	{
-		fileList[i]->pos = pos;
-		if(!encodeMethod and cryptState & 2 and fileList[i]->size < 16) // AES 128
-			pos += 16;
+		// duplicate has data of first same file
+		if(source[i] != i)
+		{
+			filePos[i] = filePos[source[i]];
+			continue;
+		}
+		wint& next = stored[i] ? posStored : segments > 1 ? segmentPos[segment[i]] : pos;
+		filePos[i] = next;
+		if((!encodeMethod or stored[i]) and cryptState & 2 and fileSize[i] and fileSize[i] < 16) // AES 128
+			next += 16;
 		else
-			pos += fileList[i]->size;
+			next += fileSize[i];
 	}
 
 	ratioIn = archiveSize * 100 / sourceFileSize;
@@ -531,7 +1302,11 @@ int Archive::impl::close(byte smode)
 	totalFileHeadSize = 0;
 	deleteState = 0;
 	archive.close();
+	fileTable.clear();
 	fileList.clear_ptr();
+	chunkRefs.clear();
+	segmentProps.clear();
+	segmentSize.clear();
 	safe_delete(log);
 	if(pathDelete and decPath.length())
 	{
@@ -577,10 +1352,10 @@ int Archive::impl::append(StringArray& files)
 		errorStr = "No appending files";
 		return 0;
 	}
-	if(!range(encodeMethod, 2, 0))
+	if(!range(encodeMethod, 3, 0))
 	{
 		errorId = 3;
-		errorStr = "Encoding method not in range [0, 2]";
+		errorStr = "Encoding method not in range [0, 3]";
 		return 0;
 	}
 
@@ -625,7 +1400,7 @@ int Archive::impl::append(StringArray& files)
 	if(encodeMethod)
 	{
 		StringArray filesOut;
-		sortFileExt(files, filesOut);
+		sortFiles(files, filesOut);
 		files = filesOut;
 	}
 
@@ -643,16 +1418,14 @@ int Archive::impl::append(StringArray& files)
 
 	sourceFileSize = 0;
 
-	// store files heads [empty]
-	archive.storeBuffer(fileHeads, filesCount * archiveFileHeadSize);
-
-	wint cryptTotal = 0;
 	wint cryptPos = 0;
+	cryptBufferSize = 0;
 	if(cryptState & 3)
-		encryption.keyExpansion((byte*)cryptString.p(), cryptLength);
+		cryptInit();
 
-	// store files list
-	totalFileHeadSize = archiveHeadSize;
+	// files names for directory after data
+	Array<byte> names;
+	uint namesSize = 0;
 	forn(filesCount)
 	{
 		// exist archive
@@ -688,63 +1461,99 @@ int Archive::impl::append(StringArray& files)
 		getUnicode(buffer);
 		fileHeads[i].nameLen = bufferu.length();
 		fileHeads[i].size = fileSize(files[i]);
-		archiveSize += archiveFileHeadSize + fileHeads[i].size + fileHeads[i].nameLen;
 		sourceFileSize += fileHeads[i].size;
-		totalFileHeadSize += archiveFileHeadSize + fileHeads[i].nameLen;
 #if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
 		fileTimeValue(files[i], fileHeads[i].time, 2);
 #endif
 
-		// crypt file name
-		if(cryptState & 1)
-		{
-			form(u, fileHeads[i].nameLen)
-			{
-				cryptBuffer[cryptBufferSize++] = bufferu[u];
-				cryptTotal++;
-				if(cryptBufferSize == 512 or (u == fileHeads[i].nameLen-1 and i == filesCount-1))
-				{
-					if(cryptBufferSize < 16)
-					{
-						if(cryptTotal < 16)
-						{
-							// padding with zeros
-							form(q, 16 - cryptBufferSize)
-							cryptBuffer[q + cryptBufferSize] = 0;
-							cryptBufferSize = 16;
-						}
-						else
-						{
-							// stealing from penultimate block to first block
-							// copy penultimate block size to next block
-							form(q, 16 - cryptBufferSize)
-							cryptBuffer[q + cryptBufferSize] = cryptBuffer[q + cryptBufferSize + 496];
-							form(q, cryptBufferSize)
-							cryptBuffer[q + 16] = cryptBuffer[q + 496];
-							archive.seekw(-16, 1);
-							encryption.encrypt(cryptBuffer, 16, cryptPos);
-							archive.storeBuffer(cryptBuffer, cryptBufferSize + 16);
-							cryptBufferSize = 0;
-						}
-					}
-					// crypt, save
-					if(cryptBufferSize)
-					{
-						encryption.encrypt(cryptBuffer, cryptBufferSize, cryptPos);
-						archive.storeBuffer(cryptBuffer, cryptBufferSize);
-					}
-					cryptPos += cryptBufferSize;
-					cryptBufferSize = 0;
-				}
-			}
-		}
-		else
-			archive.storeBuffer(bufferu.p(), fileHeads[i].nameLen);
+		if(names.capacity() < namesSize + fileHeads[i].nameLen)
+			names.reserve((namesSize + fileHeads[i].nameLen) * 2);
+		names.resize(namesSize + fileHeads[i].nameLen);
+		mencpy(names.begin() + namesSize, bufferu.p(), fileHeads[i].nameLen);
+		namesSize += fileHeads[i].nameLen;
 	}
 
-	uint memSize = BLOCK_SIZE;
-	if(!mem) mem = new byte[memSize];
-	uint readBytes = 0;
+	// files with same data stored once
+	uint* fileSource = new uint[filesCount];
+	dedupFiles(files, fileHeads, fileSource, filesCount);
+
+	// filter by first block of file
+	uint* fileFilter = new uint[filesCount];
+	ExeFilter exeFilter;
+	DeltaFilter deltaFilter;
+	forn(filesCount)
+	fileFilter[i] = 0;
+
+	// incompressible files stored after compressed streams, text for auto method
+	byte* fileKind = new byte[filesCount];
+	byte* fileStored = new byte[filesCount];
+	forn(filesCount)
+	fileKind[i] = DATA_BINARY;
+	if(encodeMethod)
+		sniffFiles(files, fileHeads, fileSource, fileKind, encodeMethod == 3, filesCount);
+	// stored files bypass chunker, only whole duplicates of them removed
+	forn(filesCount)
+	fileStored[i] = fileKind[fileSource[i]] == DATA_STORE;
+
+	// streams by methods one after another, auto method without empty streams
+	byte segmentMethod[2];
+	uint segments = 0;
+	byte* fileSegment = new byte[filesCount];
+	forn(filesCount)
+	fileSegment[i] = 0;
+	if(encodeMethod and encodeMethod < 3)
+		segmentMethod[segments++] = encodeMethod;
+	else if(encodeMethod == 3)
+	{
+		for(byte method = 1; method <= 2; method++)
+		{
+			byte used = 0;
+			forn(filesCount)
+			{
+				if(fileSource[i] != i or !fileHeads[i].size or fileStored[i])
+					continue;
+				byte fileMethod = fileKind[i] == DATA_TEXT ? AUTO_TEXT_METHOD : 1;
+				if(fileMethod != method)
+					continue;
+				fileSegment[i] = segments;
+				used = 1;
+			}
+			if(used)
+				segmentMethod[segments++] = method;
+		}
+		forn(filesCount)
+		fileSegment[i] = fileSegment[fileSource[i]];
+	}
+
+	// files of streams, then stored files, first order of stream
+	uint* fileOrder = new uint[filesCount];
+	uint segmentFirst[3];
+	uint orderCount = 0;
+	form(s, segments + 1)
+	{
+		segmentFirst[s] = orderCount;
+		forn(filesCount)
+		{
+			if(s < segments ? !fileStored[i] and fileSegment[i] == s : fileStored[i] or !segments)
+				fileOrder[orderCount++] = i;
+		}
+	}
+
+	// last file with data ends stream, data size for cm stream
+	uint segmentLast[2] = {0};
+	wint segmentData[2] = {0};
+	forn(filesCount)
+	{
+		if(fileSource[i] == i and fileHeads[i].size and !fileStored[i])
+		{
+			segmentLast[fileSegment[i]] = i;
+			segmentData[fileSegment[i]] += fileHeads[i].size;
+		}
+	}
+
+	uint memSize = BLOCK_SIZE;
+	if(!mem) mem = new byte[memSize];
+	uint readBytes = 0;
 	wint curSize = 0;
 	wint totSize = 0;
 	uint curNum = 0;
@@ -756,6 +1565,25 @@ int Archive::impl::append(StringArray& files)
 	SmartPtr<ICoder> encoder;
 	SmartPtr<BigraphCoder> encoderBigraph;
 	CoderStream coderStream;
+	CoderStream bigraphStream;
+
+	// repeats beyond dictionary of lzre, cm needs data size before coding
+	SmartPtr<ArchiveChunker> chunker;
+	byte chunking = 0;
+	forn(segments)
+	{
+		if(segmentMethod[i] == 1)
+			chunking = 1;
+	}
+	if(chunking)
+		chunker.set(new ArchiveChunker);
+	chunkRefs.clear();
+	segmentProps.resize(segments);
+	segmentSize.resize(segments);
+
+	// preprocessed stream for one method
+	if(encodeMethod == 3)
+		encodeBigraph = 0;
 
 	if(encodeMethod)
 	{
@@ -774,25 +1602,20 @@ int Archive::impl::append(StringArray& files)
 
 		if(encodeBigraph)
 		{
+			if(!memBigraph) memBigraph = new byte[memEncSize];
 			encoderBigraph.set(new BigraphCoder);
 			encoderBigraph->initialise(1);
+			bigraphStream.src = mem;
+			bigraphStream.dst = memBigraph;
+			coderStream.src = memBigraph;
+			bigraphFormat = 2;
 		}
 
-		encoder.set(createMethod(0));
+		encodeHistory = CODER_HISTORY;
 
-		// cm decoder need source file size
-		if(encodeMethod == 2)
-			arcHead.dataSize = 8;
-		if(encodeMethod == 2 and encodeBigraph == 0)
-		{
-			if(cryptState & 2)
-			{
-				mencpy(cryptBuffer, &sourceFileSize, 8);
-				cryptBufferSize += 8;
-			}
-			else
-				archive.storeWint(sourceFileSize);
-		}
+		// parameters of user for each stream
+		uint* param = &encodeMethod;
+		forn(11) paramsCur[i] = param[i];
 	}
 
 	byte exits = 0;
@@ -802,355 +1625,262 @@ int Archive::impl::append(StringArray& files)
 	archiveHeadSizeTotal = archive.tellw();
 
 	/*
-		0: preprocessing parsing
-		1: preprocessing encode
-		2: compression
-		N: encryption
+		preprocessing bigraph in memory,
+		output to compression, encryption
 	*/
 
-	byte mainLoop = encodeBigraph ? 3 : 1;
-	String bigraphFile;
-	FileStream appendFileBigraph;
 	wint sourceSize = sourceFileSize;
-	cryptPos = 0;
-	cryptBufferSize = 0;
+	memSize = BLOCK_SIZE;
+	curNum = 1;
+	totSize = 0;
 
-	form(j, mainLoop)
+	// store files to archive
+	wint segmentPos[3];
+	uint segmentCur = 0;
+	form(order, filesCount)
 	{
-		byte crccalc = 0;
-		if(mainLoop == 1 or j == 1 or (j == 2 and !encodeBigraph))
-			crccalc = 1;
+		// stream by own method for next files, then stored files
+		while(segmentCur <= segments and order == segmentFirst[segmentCur])
+		{
+			// stored files encrypted from start, after end of compressed streams
+			if(cryptState & 2 and cryptBufferSize)
+				cryptStore(archive, 0, 0, cryptPos, 1);
+			segmentPos[segmentCur] = archive.tellw();
+			if(segmentCur < segments)
+				segmentProps[segmentCur] = beginSegment(encoder, segmentMethod[segmentCur], segmentData[segmentCur], cryptPos);
+			segmentCur++;
+		}
 
+		uint i = fileOrder[order];
+		byte stored = fileStored[i];
+		byte method = stored or !segments ? 0 : segmentMethod[fileSegment[i]];
+		byte evtUpd = 1;
 		memSize = BLOCK_SIZE;
-		curNum = 1;
-		totSize = 0;
-		uint filesn = files.size();
-		// 2: compression
-		if(j == 2 and encodeBigraph)
-			filesn = 1;
-
-		// bigraph encode
-		if(j == 1)
-		{
-			bigraphFile.reserve(1024);
-			buffer = "dla.bg.";
-			generateFileName(bigraphFile, buffer, 0, 6);
-			bigraphFile.update();
-			int state = appendFileBigraph.open(bigraphFile, 0);
-			assert(state);
-			encoderBigraph->initialise(2);
-		}
-
-		// store files to archive
-		forn(filesn)
-		{
-			byte evtUpd = 1;
-			memSize = BLOCK_SIZE;
-			bool state = 0;
-			// step 1: encode from bigraph parsing
-			// step 2: compress from bigraph data
-			if(j == 2 and encodeBigraph)
-			{
-				buffer = bigraphFile;
-				curSize = fileSize(bigraphFile.p());
-				sourceSize = curSize;
-				// to archive bigraph file size after crc
-				arcHead.procSize = sourceSize;
-			}
-			else
-			{
-				buffer = files[i];
-				curSize = fileHeads[i].size;
-			}
-
-			/* cm decoder need source file size */
-			if(j == 2 and encodeMethod == 2)
-			{
-				if(cryptState & 2)
-				{
-					mencpy(cryptBuffer, &sourceSize, 8);
-					cryptBufferSize += 8;
-				}
-				else
-					archive.storeWint(sourceSize);
-			}
-
-			if(!appendFile.open(buffer, 1))
-			{
-				errorId = 4;
-				errorStr.format("Can not open file %ls", buffer.p());
-				return 0;
-			}
-
-			crc.reset();
+		buffer = files[i];
+		curSize = fileHeads[i].size;
 
-			if(!encodeMethod)
-				cryptPos = 0;
-
-			while(curSize)
-			{
-				if(encodeMethod == 0 and cryptState & 2 and
-				        curSize > memSize and curSize < memSize + 16)
-					memSize -= 128;
+		// duplicate has data of first same file
+		byte duplicate = fileSource[i] != i;
+		if(duplicate)
+		{
+			totSize += curSize;
+			curSize = 0;
+		}
+		else if(!appendFile.open(buffer, 1))
+		{
+			errorId = 4;
+			errorStr.format("Can not open file %ls", buffer.p());
+			return 0;
+		}
 
-				readBytes = appendFile.readBuffer(mem, memSize);
+		TraceScope traceFile("file", "file", i);
+		crc.reset();
+		if(!encodeMethod or stored)
+			cryptPos = 0;
 
-				assert(readBytes);
-				curSize -= readBytes;
-				totSize += readBytes;
+		while(curSize)
+		{
+			wint stage = stageTimer.getMicroseconds();
+			readBytes = appendFile.readBuffer(mem, memSize);
+			stageEnd(STAGE_READ, stage, readBytes);
 
-				// encode after bigraph
-				if(j == 2 and encodeBigraph)
-				{
-					curNum = clamp(totSize / (sourceSize / filesCount), filesCount, 1);
-				}
+			assert(readBytes);
+			curSize -= readBytes;
+			totSize += readBytes;
 
-				// crc source files
-				if(crccalc)
-					crc.calculate(mem, readBytes);
+			// crc source files
+			stage = stageTimer.getMicroseconds();
+			crc.calculate(mem, readBytes);
+			stageEnd(STAGE_CRC, stage, readBytes);
 
-				// crypt stream
-				if(encodeMethod == 0 and cryptState & 2)
+			if(encodeMethod and !stored)
+			{
+				stage = stageTimer.getMicroseconds();
+				if(curSize + readBytes == fileHeads[i].size)
 				{
-					// padding with zeros
-					if(readBytes < 16)
-					{
-						form(u, 16 - readBytes)
-						mem[u + readBytes] = 0;
-						readBytes = 16;
-					}
-					encryption.encrypt(mem, readBytes, cryptPos);
-					cryptPos += readBytes;
+					byte stride = 0;
+					if(ExeFilter::detect(mem, readBytes))
+						fileFilter[i] = FILTER_EXE;
+					else if((stride = DeltaFilter::detect(mem, readBytes)) != 0)
+						fileFilter[i] = FILTER_DELTA | stride << 8;
+					exeFilter.reset(1);
+					deltaFilter.reset(1, stride ? stride : 1);
 				}
-
-				if(encodeMethod)
+				if(fileFilter[i] == FILTER_EXE)
+					exeFilter.process(mem, readBytes);
+				else if(fileFilter[i])
+					deltaFilter.process(mem, readBytes);
+				stageEnd(STAGE_FILTER, stage, fileFilter[i] ? readBytes : 0);
+
+				byte end = curSize == 0 and i == segmentLast[fileSegment[i]];
+				int ret = IS_OK;
+				if(chunking and method == 1)
 				{
-					byte end = curSize == 0 and i == filesn - 1;
-					coderStream.srcAvail = readBytes;
-
-					int ret = IS_STREAM_END;
-					while(ret == IS_STREAM_END)
-					{
-						coderStream.dstAvail = memEncSize;
-						if(encodeBigraph and j == 0)
-							ret = encoderBigraph->parsing(&coderStream, end);
-						else if(j == 1)
-						{
-							ret = encoderBigraph->compress(&coderStream, end);
-							appendFileBigraph.storeBuffer(coderStream.dst, coderStream.dstAvail);
-						}
-						else
-						{
-							ret = encoder->compress(&coderStream, end);
-							assert(coderStream.dstAvail != 0);
-
-							// crypt stream
-							if(cryptState & 2)
-							{
-								form(u, coderStream.dstAvail)
-								{
-									cryptBuffer[cryptBufferSize++] = coderStream.dst[u];
-									if(cryptBufferSize == 512 or (u == coderStream.dstAvail-1 and end))
-									{
-										if(cryptBufferSize < 16) // coverage complete [00]
-										{
-											if(coderStream.dstTotal < 16)
-											{
-												// padding with zeros
-												arcHead.dataSize += 16 - cryptBufferSize;
-												form(q, 16 - cryptBufferSize)
-												cryptBuffer[q + cryptBufferSize] = 0;
-												cryptBufferSize = 16;
-											}
-											else
-											{
-												// stealing from penultimate block to first block
-												// copy penultimate block size to next block
-												form(q, 16 - cryptBufferSize)
-												cryptBuffer[q + cryptBufferSize] = cryptBuffer[q + cryptBufferSize + 496];
-												form(q, cryptBufferSize)
-												cryptBuffer[q + 16] = cryptBuffer[q + 496];
-												archive.seekw(-16, 1);
-												encryption.encrypt(cryptBuffer, 16, cryptPos);
-												archive.storeBuffer(cryptBuffer, cryptBufferSize + 16);
-												cryptBufferSize = 0;
-											}
-										}
-										// crypt, save
-										if(cryptBufferSize)
-										{
-											encryption.encrypt(cryptBuffer, cryptBufferSize, cryptPos);
-											archive.storeBuffer(cryptBuffer, cryptBufferSize);
-										}
-										cryptPos += cryptBufferSize;
-										cryptBufferSize = 0;
-									}
-								}
-							}
-							else
-								archive.storeBuffer(coderStream.dst, coderStream.dstAvail);
-						}
-					}
-					if(ret != IS_OK)
+					// new chunks to coder, repeated chunks to references
+					byte* data = mem;
+					uint size = readBytes;
+					while(size and ret == IS_OK)
 					{
-						if(encodeBigraph and j == 0)
+						uint n = chunker->fill(data, size);
+						data += n;
+						size -= n;
+						byte last = end and !size;
+						if(chunker->boundary or last)
 						{
-							_printf("\nstop bigraph\n");
-							encodeBigraph = 0;
-							j++;
-							break;
-						}
-						else
-						{
-							errorId = 5;
-							errorStr = "Compression fail";
-							return 0;
+							uint chunkSize = chunker->size;
+							if(chunker->complete(chunkRefs))
+								ret = encodeData(encoder, encoderBigraph, &coderStream, &bigraphStream,
+								                 chunker->data.begin(), chunkSize, last, cryptPos);
+							else if(last)
+								ret = encodeData(encoder, encoderBigraph, &coderStream, &bigraphStream,
+								                 0, 0, 1, cryptPos);
 						}
 					}
 				}
 				else
-					archive.storeBuffer(mem, readBytes);
-
-				if(log)
 				{
-					getTime();
-					progress = totSize * 100 / sourceSize;
-					stdprintf("\rProgress %3u | %u / %u | %02u:%02u:%03u",
-					          progress, curNum, filesCount, minutes, seconds, msecondsp);
+					// positions of references in all decoded streams
+					if(chunking)
+						chunker->skip(readBytes);
+					ret = encodeData(encoder, encoderBigraph, &coderStream, &bigraphStream,
+					                 mem, readBytes, end, cryptPos);
 				}
-
-				if(event_callback)
+				if(ret != IS_OK)
 				{
-					/* [0] total processed size
-						[1] total need process size [maximum]
-						[2] compression ratio
-						[3] current count processed files
-						[4] total files count
-						[5] current file name
-						[6] time pointer to array of 3 elements: minutes seconds mseconds
-					*/
-					eventData[0] = totSize;
-					eventData[1] = sourceSize;
-					eventData[2] = coderStream.dstTotal * 100 / totSize;
-					eventData[3] = curNum;
-					eventData[4] = filesCount;
-					eventData[5] = 0;
-					if(evtUpd == 1)
-					{
-						uint in = curNum - 1;
-						eventData[5] = (wint) &files[in];
-						evtUpd = 0;
-					}
-					timeCur[0] = minutes;
-					timeCur[1] = seconds;
-					timeCur[2] = mseconds;
-					eventData[6] = (wint) timeCur;
-					if(!event_callback(eventData))
-					{
-						exits = 1;
-						break;
-					}
+					errorId = 5;
+					errorStr = "Compression fail";
+					return 0;
 				}
 			}
+			else if(cryptState & 2)
+				cryptStore(archive, mem, readBytes, cryptPos, curSize == 0);
+			else
+			{
+				stage = stageTimer.getMicroseconds();
+				archive.storeBuffer(mem, readBytes);
+				stageEnd(STAGE_WRITE, stage, readBytes);
+			}
 
-			appendFile.close();
-			if(crccalc)
-				fileHeads[i].crc = crc.get();
+			if(log)
+			{
+				getTime();
+				progress = totSize * 100 / sourceSize;
+				stdprintf("\rProgress %3u | %u / %u | %02u:%02u:%03u",
+				          progress, curNum, filesCount, minutes, seconds, msecondsp);
+			}
 
-			if(exits)
+			if(event_callback)
 			{
-				if(log)
-					log->writeLine("\nAppending stoped");
-				safe_delete_array(fileHeads);
-				safe_delete_array(filesRep);
-				if(bigraphFile.length())
+				/* [0] total processed size
+					[1] total need process size [maximum]
+					[2] compression ratio
+					[3] current count processed files
+					[4] total files count
+					[5] current file name
+					[6] time pointer to array of 3 elements: minutes seconds mseconds
+				*/
+				eventData[0] = totSize;
+				eventData[1] = sourceSize;
+				eventData[2] = coderStream.dstTotal * 100 / totSize;
+				eventData[3] = curNum;
+				eventData[4] = filesCount;
+				eventData[5] = 0;
+				if(evtUpd == 1)
 				{
-					appendFileBigraph.close();
-					removeFile(bigraphFile);
+					uint in = curNum - 1;
+					eventData[5] = (wint) &files[in];
+					evtUpd = 0;
+				}
+				timeCur[0] = minutes;
+				timeCur[1] = seconds;
+				timeCur[2] = mseconds;
+				eventData[6] = (wint) timeCur;
+				if(!callEvent(eventData))
+				{
+					exits = 1;
+					break;
 				}
-				return 0;
 			}
+		}
 
-			if(log and crccalc)
-			{
-				uint skip = skipFileLen;
-				if(modeUpdate and filesRep[i])
-					skip = decPathLen;
-				else if(!skip and files[i][1] == ':')
-					skip = files[i].findr(PATH_SEP) + 1;
-				if(pathArchive.length() and !filesRep[i])
-					buffer.format("%ls\\%ls", pathArchive.p(), files[i].p() + skip);
-				else
-					buffer.assign(files[i], skip);
-				log->writeLine(getUnicode(buffer));
-			}
-			curNum++;
+		appendFile.close();
+		traceFile.end();
+		fileHeads[i].crc = duplicate ? fileHeads[fileSource[i]].crc : crc.get();
+		if(duplicate)
+			fileFilter[i] = fileFilter[fileSource[i]];
+
+		if(exits)
+		{
+			if(log)
+				log->writeLine("\nAppending stoped");
+			safe_delete_array(fileHeads);
+			safe_delete_array(fileSource);
+			safe_delete_array(fileFilter);
+			safe_delete_array(fileKind);
+			safe_delete_array(fileStored);
+			safe_delete_array(fileSegment);
+			safe_delete_array(fileOrder);
+			safe_delete_array(filesRep);
+			return 0;
 		}
-		if(j == 1)
-			appendFileBigraph.close();
-	}
 
-	archiveSize = archive.tellw();
-	if(encodeMethod)
-		arcHead.dataSize += coderStream.dstTotal;
-	else
-		arcHead.dataSize = sourceFileSize;
+		if(log)
+		{
+			uint skip = skipFileLen;
+			if(modeUpdate and filesRep[i])
+				skip = decPathLen;
+			else if(!skip and files[i][1] == ':')
+				skip = files[i].findr(PATH_SEP) + 1;
+			if(pathArchive.length() and !filesRep[i])
+				buffer.format("%ls\\%ls", pathArchive.p(), files[i].p() + skip);
+			else
+				buffer.assign(files[i], skip);
+			log->writeLine(getUnicode(buffer));
+		}
+		curNum++;
+	}
 
-	if(log)
-		logTime(filesCount);
+	// cm decoder need preprocessed size
+	if(encodeBigraph)
+		arcHead.procSize = bigraphStream.dstTotal;
 
-	// props size 32 bit
-	// dict size 5 bit 2 ^ n
-	// word size 4 bit 2 ^ n
-	// encode level 4 bit
-	// encode threads 4 bit
-	// encode minutes match len 4 bit
-	// encode bigraph 1 bit
-	// encode method 4 bit [low bits]
-	// free 6 bit
-
-	// Encoding properties from most significant bits.
-	// Free 6 bits.
-	// Dictonary, word is power of 2
-	// Rolz range [0, 3] -> [16, 64, 128, 256]
-	// --------------------------------------------
-	// | i | description  | bit | shift | methods |
-	// |------------------------------------------|
-	// | 0 | level        |  4  |  28   | all     |
-	// | 1 | dictionary   |  5  |  23   | all     |
-	// | 2 | word         |  4  |  19   | all     |
-	// | 3 | match minutes    |  4  |  15   | lzre    |
-	// | 4 | rolz         |  2  |  13   | lzre    |
-	// | 5 | threads      |  2  |  11   | lzre    |
-	// | 6 | cmix         |  1  |  10   | lzre    |
-	// | 7 | bigraph      |  1  |   4   | all     |
-	// | 8 | method       |  4  |   0   | all     |
-	// --------------------------------------------
+	if(log and chunking and chunker->repeats)
+	{
+		log->setConsoleOutput(1);
+		logWriteLinef("\nRepeated chunks %u, %u Kb", chunker->repeats, (uint) (chunker->repeatsSize / KB));
+		log->setConsoleOutput(0);
+	}
 
-	if(encodeMethod)
+	// streams not started by files, end of streams
+	while(segmentCur <= segments)
 	{
-		uint props = encodeMethod;
+		if(cryptState & 2 and cryptBufferSize)
+			cryptStore(archive, 0, 0, cryptPos, 1);
+		segmentPos[segmentCur] = archive.tellw();
+		if(segmentCur < segments)
+			segmentProps[segmentCur] = beginSegment(encoder, segmentMethod[segmentCur], segmentData[segmentCur], cryptPos);
+		segmentCur++;
+	}
+	forn(segments)
+	segmentSize[i] = segmentPos[i + 1] - segmentPos[i];
 
-		if(encodeMethod < 3)
-		{
-			props |= encodeLevel << 28;
-			props |= bitGreat(dictSize - 1) << 23;
+	if(segments)
+		arcHead.encodeProps = segmentProps[0];
+	else if(encodeMethod)
+		arcHead.encodeProps = encodeProps();
 
-			if(encodeMethod == 1)
-			{
-				props |= bitGreat(matchMax - 1) << 19;
-				props |= matchMin << 15;
-				props |= matchRolz << 13;
-				props |= encodeThreads << 11;
-				props |= encodeCmix << 10;
-			}
-			if(encodeMethod == 2)
-				props |= matchMax << 19;
-			if(encodeBigraph)
-				props |= 1 << 4;
-		}
-		arcHead.encodeProps = props;
-	}
+	// with crypt padding
+	arcHead.dataSize = archive.tellw() - archiveHeadSize;
+
+	// files directory after data
+	totalFileHeadSize = archiveHeadSize + storeDirectory(archive, fileHeads, names.begin(),
+	                                                     fileSource, fileFilter, fileStored, fileSegment, filesCount);
+	archiveSize = archive.tellw();
+	// items of previous table, archive updated
+	fileList.clear_ptr();
+
+	if(log)
+		logTime(filesCount);
 
 	// reset values
 	uint* param = &encodeMethod;
@@ -1169,13 +1899,14 @@ int Archive::impl::append(StringArray& files)
 	archive.seekw(0, 0);
 	archive.storeBuffer(&arcHead, archiveHeadSize);
 
-	// store files headers
-	archive.storeBuffer(fileHeads, filesCount * archiveFileHeadSize);
-
 	safe_delete_array(filesRep);
+	safe_delete_array(fileSource);
+	safe_delete_array(fileFilter);
+	safe_delete_array(fileKind);
+	safe_delete_array(fileStored);
+	safe_delete_array(fileSegment);
+	safe_delete_array(fileOrder);
 	safe_delete_array(fileHeads);
-	if(bigraphFile.length())
-		removeFile(bigraphFile);
 
 	if(mode == 2)
 		removeFileShell(decPath);
@@ -1217,17 +1948,15 @@ int Archive::impl::extract(void* _files)
 			if(files->size())
 			{
 				srch = 1;
-				filesn = new uint[fileList.size()];
-				forn(fileList.size())
+				filesn = new uint[fileTable.count()];
+				PatternSet patterns;
+				patterns.compile(*files);
+				forn(fileTable.count())
 				{
-					form(u, files->size())
+					if(patterns.match(fileTable.name(i)) >= 0)
 					{
-						if(stwpat(fileList[i]->name.p(), (*files)[u].p()))
-						{
-							filesn[filesnn++] = i;
-							cumFileSize += fileList[i]->size;
-							break;
-						}
+						filesn[filesnn++] = i;
+						cumFileSize += fileTable.size[i];
 					}
 				}
 			}
@@ -1238,12 +1967,17 @@ int Archive::impl::extract(void* _files)
 		{
 			srch = 1;
 			filesn = new uint;
-			forn(fileList.size())
+			// same matching as list of patterns
+			StringArray pattern;
+			pattern.push_back((wchar_t*) _files);
+			PatternSet patterns;
+			patterns.compile(pattern);
+			forn(fileTable.count())
 			{
-				if(stwpat(fileList[i]->name.p(), (wchar_t*) _files))
+				if(patterns.match(fileTable.name(i)) >= 0)
 				{
 					filesn[filesnn++] = i;
-					cumFileSize += fileList[i]->size;
+					cumFileSize += fileTable.size[i];
 					break;
 				}
 			}
@@ -1268,11 +2002,11 @@ int Archive::impl::extract(void* _files)
 		log->setConsoleOutput(0);
 	}
 
-	uint filesCount = filesnn ? filesnn : fileList.size();
+	uint filesCount = filesnn ? filesnn : fileTable.count();
 	uint fileIn = 0;
+	String fileEntry; // name in archive
 	String fileName;
 	String filePath;
-	String filePathRd;
 	wint fileSize = 0;
 	wint filePos = 0;
 
@@ -1285,6 +2019,8 @@ int Archive::impl::extract(void* _files)
 	uint curNum = 1;
 	byte crcFail = 0;
 	FileStream extractFile;
+	ExeFilter exeFilter;
+	DeltaFilter deltaFilter;
 
 	FileStream decodedFile;
 	uint memEncSize = BLOCK_SIZE; // uncompressed block size
@@ -1292,37 +2028,44 @@ int Archive::impl::extract(void* _files)
 	CoderStream coderStream;
 
 	SmartPtr<BigraphCoder> decoderBigraph;
-	FileStream decodedFilePrc;
+	CoderStream bigraphStream;
 
-	if(encodeMethod and !decFile.length())
+	// stream decoded only for compressed files with data
+	byte decodeStream = 0;
+	forn(filesCount)
 	{
-		wint sourceFileSizeDecode = sourceFileSize + 4096;
-		if(sourceFileSizeDecode < dictSize)
-			dictSize = sourceFileSizeDecode;
+		fileIn = filesnn ? filesn[i] : i;
+		if(!fileTable.stored[fileIn] and fileTable.size[fileIn])
+			decodeStream = 1;
+	}
 
+	if(encodeMethod and decodeStream and !decFile.length())
+	{
 		if(!memEnc) memEnc = new byte[memEncSize];
 
 		coderStream.src = mem;
 		coderStream.dst = memEnc;
 		coderStream.srcAvail = memSize;
 		coderStream.dstAvail = memEncSize;
-
-		if(encodeBigraph)
-		{
-			decoderBigraph.set(new BigraphCoder);
-			decoderBigraph->initialise(3);
-		}
-
-		decoder.set(createMethod(1));
 	}
 
 	byte exits = 0;
 	wint eventData[10] = {0};
 	uint timeCur[3] = {0}; // minutes, seconds, mseconds
 	String uncFile("uncompressed file");
-	uint cryptPos = 0;
+	wint cryptPos = 0;
 	if(cryptState & 3)
-		encryption.keyExpansion((byte*)cryptString.p(), cryptLength);
+		cryptInit();
+
+	// encrypted data read by encryption blocks
+	byte* memRead = mem;
+	uint memReadSize = memSize;
+	if(cryptState & 2)
+	{
+		memRead = cryptBuffer;
+		memReadSize = CRYPT_BLOCK;
+		coderStream.src = cryptBuffer;
+	}
 
 	if(encodeMethod and decFile.length())
 	{
@@ -1331,76 +2074,84 @@ int Archive::impl::extract(void* _files)
 	}
 
 	// extract / decompress files to temp
-	if(encodeMethod and !decFile.length())
+	if(encodeMethod and decodeStream and !decFile.length())
 	{
 		byte evtUpd = 1;
-		byte mainLoop = 1;
 		archive.seekw(dataPos, 0);
 
-		if(encodeBigraph)
-			mainLoop = 2;
-
 		filePath.reserve(1024);
 
 		wint sourceSize = sourceFileSize;
-		if(encodeBigraph)
-			sourceSize = bigraphSize;
+		totSize = 0;
 
-		form(j, mainLoop)
+		if(dataEnd - archive.tellw() != arcHead.dataSize)
 		{
-			readSize = memSize;
-			totSize = 0;
-			// decode file data
-			fileSize = arcHead.dataSize;
-			if(j == 1)
-			{
-				sourceSize = sourceFileSize;
-				fileSize = tas::fileSize(filePath);
-				filePathRd = filePath;
-				decodedFilePrc.open(filePath, 1);
-			}
+			errorId = 3;
+			errorStr = "Compressed stream is damaged";
+			return 0;
+		}
+		buffer = "dla.a.";
+		generateFileName(filePath, buffer, 0, 6);
+		filePath.update();
+		decFile = filePath;
+
+		// open temp file for read/write "wb+"
+		if(!decodedFile.open(filePath, 0, "wb+"))
+			return 0;
 
-			if(!j and archiveSize - archive.tellw() != fileSize)
+		// repeated chunks from decoded data
+		chunkRef = 0;
+		chunkLiteral = chunkRefs.size() ? chunkRefs[0] : (wint) -1;
+		chunkPos = 0;
+
+		// streams by own parameters, decoded one after another
+		form(s, segmentProps.size())
+		{
+			decodeProps(segmentProps[s]);
+			wint sourceFileSizeDecode = sourceFileSize + 4096;
+			if(sourceFileSizeDecode < dictSize)
+				dictSize = sourceFileSizeDecode;
+
+			if(encodeBigraph)
 			{
-				errorId = 3;
-				errorStr = "Compressed stream is damaged";
-				return 0;
+				if(!memBigraph) memBigraph = new byte[memEncSize];
+				decoderBigraph.set(new BigraphCoder);
+				decoderBigraph->initialise(2, bigraphFormat);
+				bigraphStream.src = memEnc;
+				bigraphStream.dst = memBigraph;
 			}
-			buffer.format("dla.%c.", 'a' + j);
-			generateFileName(filePath, buffer, 0, 6);
-			filePath.update();
-			if(mainLoop == 1 or j == 1)
-				decFile = filePath;
-
-			// open temp file for read/write "wb+"
-			if(!decodedFile.open(filePath, 0, "wb+"))
-				return 0;
+
+			decoder.set(createMethod(1));
+			cryptPos = 0;
+			readSize = memReadSize;
+			fileSize = segmentSize[s];
 
 			while(fileSize)
 			{
 				if(fileSize < readSize)
 					readSize = fileSize;
 
-				if(cryptState & 2 and !j and
-				        fileSize > memSize and fileSize < memSize + 16)
+				// last block not less 16 bytes
+				if(cryptState & 2 and
+				        fileSize > readSize and fileSize < readSize + 16)
 				{
 					readSize -= 128;
 				}
 
-				if(!j)
-					readBytes = archive.readBuffer(mem, readSize);
-				else
-					readBytes = decodedFilePrc.readBuffer(mem, readSize);
+				wint stage = stageTimer.getMicroseconds();
+				readBytes = archive.readBuffer(memRead, readSize);
+				stageEnd(STAGE_READ, stage, readBytes);
 
 				assert(readBytes);
 				totSize += readBytes;
 				fileSize -= readBytes;
 				coderStream.srcAvail = readBytes;
+				stats.bytes[STAGE_CODE] += readBytes;
 
 				// decrypt stream
-				if(!j and cryptState & 2)
+				if(cryptState & 2)
 				{
-					encryption.decrypt(mem, readBytes, cryptPos);
+					cryptData(memRead, readBytes, cryptPos, 1);
 					cryptPos += readBytes;
 				}
 
@@ -1408,22 +2159,51 @@ int Archive::impl::extract(void* _files)
 				while(ret == IS_STREAM_END)
 				{
 					coderStream.dstAvail = memEncSize;
-					if(!j)
-						ret = decoder->uncompress(&coderStream, fileSize == 0);
-					else
-						ret = decoderBigraph->uncompress(&coderStream, fileSize == 0);
+					stage = stageTimer.getMicroseconds();
+					ret = decoder->uncompress(&coderStream, fileSize == 0);
+					stageEnd(STAGE_CODE, stage, 0);
 					assert(coderStream.dstAvail != 0);
-					decodedFile.storeBuffer(coderStream.dst, coderStream.dstAvail);
+
+					// bigraph from decoded data in memory
+					CoderStream* decoded = &coderStream;
+					if(encodeBigraph)
+					{
+						bigraphStream.srcAvail = coderStream.dstAvail;
+						stats.bytes[STAGE_FILTER] += coderStream.dstAvail;
+						int retb = IS_STREAM_END;
+						while(retb == IS_STREAM_END and bigraphStream.srcAvail)
+						{
+							bigraphStream.dstAvail = memEncSize;
+							stage = stageTimer.getMicroseconds();
+							retb = decoderBigraph->uncompress(&bigraphStream, fileSize == 0 and ret == IS_OK);
+							stageEnd(STAGE_FILTER, stage, 0);
+							stage = stageTimer.getMicroseconds();
+							if(!storeDecoded(decodedFile, bigraphStream.dst, bigraphStream.dstAvail))
+								retb = IS_STREAM_ERROR;
+							stageEnd(STAGE_WRITE, stage, bigraphStream.dstAvail);
+						}
+						if(retb != IS_OK)
+							ret = retb;
+						decoded = &bigraphStream;
+					}
+					else
+					{
+						stage = stageTimer.getMicroseconds();
+						if(!storeDecoded(decodedFile, coderStream.dst, coderStream.dstAvail))
+							ret = IS_STREAM_ERROR;
+						stageEnd(STAGE_WRITE, stage, coderStream.dstAvail);
+					}
+
 					if(log)
 					{
-						progress = coderStream.dstTotal * 100 / sourceSize;
+						progress = decoded->dstTotal * 100 / sourceSize;
 						getTime();
-						if(!j) stdprintf("\rProgress %3u | %02u:%02u:%03u", progress, minutes, seconds, msecondsp);
+						stdprintf("\rProgress %3u | %02u:%02u:%03u", progress, minutes, seconds, msecondsp);
 					}
-					if(!j and event_callback and log)
+					if(event_callback and log)
 					{
-						ratioUn = coderStream.srcTotal * 100 / coderStream.dstTotal;
-						eventData[0] = coderStream.dstTotal;
+						ratioUn = coderStream.srcTotal * 100 / decoded->dstTotal;
+						eventData[0] = decoded->dstTotal;
 						eventData[1] = sourceSize;
 						eventData[2] = ratioUn;
 						eventData[3] = 1;
@@ -1438,14 +2218,14 @@ int Archive::impl::extract(void* _files)
 						timeCur[1] = seconds;
 						timeCur[2] = mseconds;
 						eventData[6] = (wint) timeCur;
-						if(!event_callback(eventData))
+						if(!callEvent(eventData))
 						{
 							exits = 1;
 							break;
 						}
 					}
 					else if(event_callback)
-						event_callback(0);
+						callEvent(0);
 				}
 				if(exits)
 					break;
@@ -1457,21 +2237,14 @@ int Archive::impl::extract(void* _files)
 					break;
 				}
 			}
-			if(mainLoop == 1 or j)
-				decodedFile.seekw(0, 0);
-			else
-				decodedFile.close();
-			if(j)
-			{
-				decodedFilePrc.close();
-				removeFile(filePathRd);
-			}
 			if(exits)
-			{
-				decodedFile.close();
 				break;
-			}
 		}
+		decodeProps(arcHead.encodeProps);
+		if(exits)
+			decodedFile.close();
+		else
+			decodedFile.seekw(0, 0);
 	}
 
 	if(exits)
@@ -1489,14 +2262,16 @@ int Archive::impl::extract(void* _files)
 	forn(filesCount)
 	{
 		fileIn = filesnn ? filesn[i] : i;
-		fileSize = fileList[fileIn]->size;
-		filePos = fileList[fileIn]->pos;
-		readSize = memSize;
+		fileSize = fileTable.size[fileIn];
+		filePos = fileTable.pos[fileIn];
+		byte coded = encodeMethod and !fileTable.stored[fileIn];
+		readSize = coded ? memSize : memReadSize;
 
+		fileEntry.assign(fileTable.name(fileIn), fileTable.nameLength(fileIn));
 		if(savePath)
-			fileName.assign(fileList[fileIn]->name, skipFileLen);
+			fileName.assign(fileEntry, skipFileLen);
 		else
-			fileName = fileList[fileIn]->name.substrx(PATH_SEP, 1, 1);
+			fileName = fileEntry.substrx(PATH_SEP, 1, 1);
 
 		if(decPath.length())
 			filePath.format("%ls%c%ls", decPath.p(), PATH_SEP, fileName.p());
@@ -1507,21 +2282,24 @@ int Archive::impl::extract(void* _files)
 
 		if(!extractFile.open(filePath, 0))
 			return 0;
+		TraceScope traceFile("file", "file", fileIn);
 
 		lastFile = filePath;
 
-		if(encodeMethod)
+		if(coded and fileSize)
 			decodedFile.seekw(filePos, 0);
 		else
 			archive.seekw(filePos, 0);
 
 		crc.reset();
 		byte evtUpd = 1;
+		exeFilter.reset(2);
+		deltaFilter.reset(2, MAX(fileTable.filter[fileIn] >> 8, 1));
 
-		if(!encodeMethod)
+		if(!coded)
 		{
 			cryptPos = 0;
-			if(cryptState & 2 and fileSize < 16)
+			if(cryptState & 2 and fileSize and fileSize < 16)
 				fileSize = 16;
 		}
 		while(fileSize)
@@ -1529,32 +2307,45 @@ int Archive::impl::extract(void* _files)
 			if(fileSize < readSize)
 				readSize = fileSize;
 
-			if(encodeMethod == 0 and cryptState & 2 and
-			        fileSize > memSize and fileSize < memSize + 16)
+			// last block not less 16 bytes
+			if(!coded and cryptState & 2 and
+			        fileSize > readSize and fileSize < readSize + 16)
 			{
 				readSize -= 128;
 			}
 
-			if(encodeMethod)
+			byte* memFile = coded ? mem : memRead;
+			wint stage = stageTimer.getMicroseconds();
+			if(coded)
 				readBytes = decodedFile.readBuffer(mem, readSize);
 			else
-				readBytes = archive.readBuffer(mem, readSize);
+				readBytes = archive.readBuffer(memRead, readSize);
+			stageEnd(STAGE_READ, stage, readBytes);
 
 			assert(readBytes);
 			fileSize -= readBytes;
 			totSize += readBytes;
 
 			// decrypt stream
-			if(encodeMethod == 0 and cryptState & 2)
+			if(!coded and cryptState & 2)
 			{
-				encryption.decrypt(mem, readBytes, cryptPos);
+				cryptData(memRead, readBytes, cryptPos, 1);
 				cryptPos += readBytes;
 			}
 
-			if(!encodeMethod and cryptState & 2 and fileList[fileIn]->size < 16)
-				readBytes = fileList[fileIn]->size;
+			if(!coded and cryptState & 2 and fileTable.size[fileIn] < 16)
+				readBytes = fileTable.size[fileIn];
 
-			crc.calculate(mem, readBytes);
+			stage = stageTimer.getMicroseconds();
+			if(coded and fileTable.filter[fileIn] == FILTER_EXE)
+				exeFilter.process(memFile, readBytes);
+			else if(coded and fileTable.filter[fileIn])
+				deltaFilter.process(memFile, readBytes);
+			stageEnd(STAGE_FILTER, stage, coded and fileTable.filter[fileIn] ? readBytes : 0);
+
+			stage = stageTimer.getMicroseconds();
+			crc.calculate(memFile, readBytes);
+			stageEnd(STAGE_CRC, stage, readBytes);
 
 			if(log)
 			{
@@ -1580,30 +2371,33 @@ int Archive::impl::extract(void* _files)
 				timeCur[1] = seconds;
 				timeCur[2] = mseconds;
 				eventData[6] = (wint) timeCur;
-				if(!event_callback(eventData))
+				if(!callEvent(eventData))
 				{
 					exits = 1;
 					break;
 				}
 			}
 			else if(event_callback)
-				event_callback(0);
-			extractFile.storeBuffer(mem, readBytes);
+				callEvent(0);
+			stage = stageTimer.getMicroseconds();
+			extractFile.storeBuffer(memFile, readBytes);
+			stageEnd(STAGE_WRITE, stage, readBytes);
 		}
 		extractFile.close();
+		traceFile.end();
 
 		if(exits)
 			break;
 
-		if(fileList[fileIn]->crc != crc.get())
+		if(fileTable.crc[fileIn] != crc.get())
 			crcFail = 1;
 
 		if(log)
 		{
-			if(fileList[fileIn]->crc != crc.get())
-				logWriteLinef("%ls damaged", fileList[fileIn]->name.p());
+			if(fileTable.crc[fileIn] != crc.get())
+				logWriteLinef("%ls damaged", fileEntry.p());
 			else
-				log->writeLine(getUnicode(fileList[fileIn]->name));
+				log->writeLine(getUnicode(fileEntry));
 		}
 		curNum++;
 	}
@@ -1713,7 +2507,7 @@ int Archive::impl::update(StringArray& files)
 
 	// update files list, append unique extracted files
 	uint filesn = files.size();
-	forn(fileList.size())
+	forn(fileTable.count())
 	{
 		// exclude equal files
 		// not append in list
@@ -1727,7 +2521,7 @@ int Archive::impl::update(StringArray& files)
 				buffer.format("%ls\\%ls", pathArchive.p(), files[u].p() + skipFileLen);
 			else
 				buffer.assign(files[u], skipFileLen);
-			if(fileList[i]->name == buffer)
+			if(fileTable.name(i) == buffer)
 			{
 				skip = 1;
 				break;
@@ -1735,7 +2529,7 @@ int Archive::impl::update(StringArray& files)
 		}
 		skipFileLen = skipFileCopy;
 		if(skip)	continue;
-		buffer.format("%ls\\%ls", decPath.p(), fileList[i]->name.p());
+		buffer.format("%ls\\%ls", decPath.p(), fileTable.name(i));
 		files.push_back(buffer);
 	}
 
@@ -1774,24 +2568,18 @@ int Archive::impl::remove(StringArray& files)
 
 	StringArray listUnpack;
 	StringArray listAppend;
-	listUnpack.reserve(fileList.size());
+	listUnpack.reserve(fileTable.count());
 
-	forn(fileList.size())
+	PatternSet patterns;
+	patterns.compile(files);
+	forn(fileTable.count())
 	{
-		bool find = 0;
-		form(u, files.size())
-		{
-			if(stwpat(fileList[i]->name.p(), files[u].p()))
-			{
-				find = 1; // deleted file
-				break;
-			}
-		}
-		if(!find)
-			listUnpack.push_back(fileList[i]->name);
+		// not deleted file
+		if(patterns.match(fileTable.name(i)) < 0)
+			listUnpack.push_back(fileTable.name(i));
 	}
 
-	if(listUnpack.size() == fileList.size())
+	if(listUnpack.size() == fileTable.count())
 	{
 		errorId = 3;
 		errorStr = "No deleted files";
@@ -1902,24 +2690,29 @@ int Archive::impl::rename(StringArray& files)
 		}
 	}
 
+	// source names, index of pattern is pair of names
+	StringArray renames;
+	renames.reserve(filesCountDiv);
+	forn(filesCountDiv)
+	{
+		if(renameDirectory)
+			buffer.format("%ls*", files[i * 2].p());
+		else
+			buffer = files[i * 2];
+		renames.push_back(buffer);
+	}
+	PatternSet patterns;
+	patterns.compile(renames);
+
 	// search one item
 	byte found = 0;
-	forn(fileList.size())
+	forn(fileTable.count())
 	{
-		form(u, filesCountDiv)
+		if(patterns.match(fileTable.name(i)) >= 0)
 		{
-			if(renameDirectory)
-				buffer.format("%ls*", files[u * 2].p());
-			else
-				buffer = files[u * 2];
-			if(stwpat(fileList[i]->name.p(), buffer.p()))
-			{
-				found = 1;
-				break;
-			}
-		}
-		if(found)
+			found = 1;
 			break;
+		}
 	}
 
 	if(!found)
@@ -1948,120 +2741,72 @@ int Archive::impl::rename(StringArray& files)
 	if(!archiveDest.state())
 		return 0;
 
-	// archive header from source archive to dest
+	// archive header from source archive to dest, arv3 converted
+	wint dataSize = dataEnd - dataPos;
+	arcHead.signature = ARCHIVE_SIGNATURE;
+	arcHead.dataSize = dataSize;
+	crc.reset();
+	crc.calculate((byte*) &arcHead, archiveHeadSize - 4);
+	arcHead.crcHeader = crc.get();
 	archiveDest.storeBuffer(&arcHead, archiveHeadSize);
 
 	// file list
-	uint filesCount = fileList.size();
+	uint filesCount = fileTable.count();
 
 	ArchiveFileHeader* fileHeads = new ArchiveFileHeader[filesCount];
-
-	// store files headers [empty]
-	archiveDest.storeBuffer(fileHeads, filesCount * archiveFileHeadSize);
+	Array<byte> names;
+	uint namesSize = 0;
 
 	String curFile;
 	UString curFileUni;
-	wint cryptTotal = 0;
-	wint cryptPos = 0;
+	cryptBufferSize = 0;
 	if(cryptState & 3)
-		encryption.keyExpansion((byte*)cryptString.p(), cryptLength);
+		cryptInit();
 
 	forn(filesCount)
 	{
 		found = 0;
-		fileHeads[i].size = fileList[i]->size;
-		fileHeads[i].crc = fileList[i]->crc;
+		wchar_t* name = fileTable.name(i);
+		fileHeads[i].size = fileTable.size[i];
+		fileHeads[i].crc = fileTable.crc[i];
 #if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
-		fileHeads[i].time[0] = fileList[i]->time[0];
-		fileHeads[i].time[1] = fileList[i]->time[1];
+		fileHeads[i].time[0] = fileTable.time[i * 2];
+		fileHeads[i].time[1] = fileTable.time[i * 2 + 1];
 #endif
-		form(u, filesCountDiv)
+		int u = patterns.match(name);
+		if(u >= 0)
 		{
 			if(renameDirectory)
-				buffer.format("%ls*", files[u * 2].p());
+				curFile.format("%ls%ls", files[u * 2 + 1].p(), name + files[u * 2].length() - 1);
 			else
-				buffer = files[u * 2];
-			if(stwpat(fileList[i]->name.p(), buffer.p()))
-			{
-				if(renameDirectory)
-					curFile.format("%ls%ls", files[u * 2 + 1].p(), fileList[i]->name.p() + files[u * 2].length() - 1);
-				else
-					curFile = files[u * 2 + 1];
-				if(log)
-					logWriteLinef("%ls [rename]", curFile.p());
-				curFileUni.assign(curFile.p(), curFile.length());
-				fileHeads[i].nameLen = curFileUni.length();
-				found = 1;
-				break;
-			}
+				curFile = files[u * 2 + 1];
+			if(log)
+				logWriteLinef("%ls [rename]", curFile.p());
+			curFileUni.assign(curFile.p(), curFile.length());
+			fileHeads[i].nameLen = curFileUni.length();
+			found = 1;
 		}
 		if(!found)
 		{
-			curFileUni.assign(fileList[i]->name.p(), fileList[i]->name.length());
+			curFileUni.assign(name, fileTable.nameLength(i));
 			fileHeads[i].nameLen = curFileUni.length();
 			if(log)
 				log->writeLine(curFileUni.p());
 		}
 
-		// crypt
-		if(cryptState & 1)
-		{
-			form(u, fileHeads[i].nameLen)
-			{
-				cryptBuffer[cryptBufferSize++] = curFileUni[u];
-				cryptTotal++;
-				if(cryptBufferSize == 512 or (u == fileHeads[i].nameLen-1 and i == filesCount-1))
-				{
-					if(cryptBufferSize < 16)
-					{
-						if(cryptTotal < 16)
-						{
-							// padding with zeros
-							form(q, 16 - cryptBufferSize)
-							cryptBuffer[q + cryptBufferSize] = 0;
-							cryptBufferSize = 16;
-						}
-						else
-						{
-							// stealing from penultimate block to first block
-							// copy penultimate block size to next block
-							form(q, 16 - cryptBufferSize)
-							cryptBuffer[q + cryptBufferSize] = cryptBuffer[q + cryptBufferSize + 496];
-							form(q, cryptBufferSize)
-							cryptBuffer[q + 16] = cryptBuffer[q + 496];
-							archiveDest.seekw(-16, 1);
-							encryption.encrypt(cryptBuffer, 16, cryptPos);
-							archiveDest.storeBuffer(cryptBuffer, cryptBufferSize + 16);
-							cryptBufferSize = 0;
-						}
-					}
-					// crypt, save
-					if(cryptBufferSize)
-					{
-						encryption.encrypt(cryptBuffer, cryptBufferSize, cryptPos);
-						archiveDest.storeBuffer(cryptBuffer, cryptBufferSize);
-					}
-					cryptPos += cryptBufferSize;
-					cryptBufferSize = 0;
-				}
-			}
-		}
-		else
-			// store file name
-			archiveDest.storeBuffer(curFileUni.p(), fileHeads[i].nameLen);
+		if(names.capacity() < namesSize + fileHeads[i].nameLen)
+			names.reserve((namesSize + fileHeads[i].nameLen) * 2);
+		names.resize(namesSize + fileHeads[i].nameLen);
+		mencpy(names.begin() + namesSize, curFileUni.p(), fileHeads[i].nameLen);
+		namesSize += fileHeads[i].nameLen;
 	}
 
-	// store files headers
-	archiveDest.seekw(archiveHeadSize, 0);
-	archiveDest.storeBuffer(fileHeads, filesCount * archiveFileHeadSize);
-	archiveDest.seekw(0, 2);
-
 	// store files datas
 	archive.seekw(dataPos, 0);
 
 	uint memSize = BLOCK_SIZE;
 	if(!mem) mem = new byte[memSize];
-	wint curSize = arcHead.dataSize;
+	wint curSize = dataSize;
 	wint sourceSize = curSize;
 	wint totSize = 0;
 	uint progress = 0;
@@ -2070,7 +2815,8 @@ int Archive::impl::rename(StringArray& files)
 
 	while(curSize)
 	{
-		readBytes = archive.readBuffer(mem, memSize);
+		// directory follows data
+		readBytes = archive.readBuffer(mem, (uint) MIN(curSize, (wint) memSize));
 		assert(readBytes);
 		curSize -= readBytes;
 		totSize += readBytes;
@@ -2083,12 +2829,19 @@ int Archive::impl::rename(StringArray& files)
 		}
 	}
 
+	// files directory after data
+	totalFileHeadSize = archiveHeadSize + storeDirectory(archiveDest, fileHeads, names.begin(), fileTable.source.begin(),
+	                                                     fileTable.filter.begin(), fileTable.stored.begin(),
+	                                                     fileTable.segment.begin(), filesCount);
+	archiveSize = archiveDest.tellw();
+
 	if(log)
 		logTime(filesCount);
 
 	// close archives
 	archive.close();
 	archiveDest.close();
+	fileTable.clear();
 	fileList.clear_ptr();
 	// before rename remove source archive
 	removeFile(archiveName);
@@ -2111,8 +2864,12 @@ int Archive::impl::rename(StringArray& files)
 
 int Archive::fileExist(const String& file)
 {
-	forn(_m->fileList.size())
-	if(stwpat(_m->fileList[i]->name.p(), file.p()))
+	StringArray pattern;
+	pattern.push_back(file);
+	PatternSet patterns;
+	patterns.compile(pattern);
+	forn(_m->fileTable.count())
+	if(patterns.match(_m->fileTable.name(i)) >= 0)
 		return 1;
 	return 0;
 }
@@ -2162,34 +2919,45 @@ int Archive::impl::list()
 	log->writeLinef("%16s  %s", "Files", "list");
 
 	SPLIT_LINE;
-	forn(fileList.size())
+	forn(fileTable.count())
 	{
-		convertDecimalSpace(&buffer, fileList[i]->size);
-		logWriteLinef("%16ls  %ls", buffer.p(), fileList[i]->name.p());
+		convertDecimalSpace(&buffer, fileTable.size[i]);
+		logWriteLinef("%16ls  %ls", buffer.p(), fileTable.name(i));
 	}
 
 	SPLIT_LINE;
 	convertDecimalSpace(&buffer, sourceFileSize);
 	log->writeLinef("%16ls  %s", buffer.p(), "Total size");
-	log->writeLinef("%16u  %s", fileList.size(), "Total count");
+	log->writeLinef("%16u  %s", fileTable.count(), "Total count");
 
 	if(encodeMethod)
 	{
-		if(encodeMethod == 1)
-			bufferu = "LZRE";
-		else if(encodeMethod == 2)
-			bufferu = "CM";
-		log->writeLinef("\n%16s  %s", bufferu.p(), "Compression");
-
-		SPLIT_LINE;
-		if(encodeMethod == 1)
+		// parameters of each stream
+		form(s, segmentProps.size())
 		{
-			log->writeLinef("%16u  %s", encodeLevel, "Level");
-			convertDecimalSpace(&buffer, dictSize);
-			log->writeLinef("%16ls  %s", buffer.p(), "Dictionary");
-			bufferu.format("[%u, %u]", matchMin, matchMax);
-			log->writeLinef("%16s  %s", bufferu.p(), "Match");
-			log->writeLinef("%16u  %s", encodeThreads, "Threads");
+			decodeProps(segmentProps[s]);
+			if(encodeMethod == 1)
+				bufferu = "LZRE";
+			else if(encodeMethod == 2)
+				bufferu = "CM";
+			else
+				bufferu = "Stored";
+			log->writeLinef("\n%16s  %s", bufferu.p(), "Compression");
+
+			SPLIT_LINE;
+			if(encodeMethod == 1)
+			{
+				log->writeLinef("%16u  %s", encodeLevel, "Level");
+				convertDecimalSpace(&buffer, dictSize);
+				log->writeLinef("%16ls  %s", buffer.p(), "Dictionary");
+				if(longWindow)
+				{
+					convertDecimalSpace(&buffer, longWindow);
+					log->writeLinef("%16ls  %s", buffer.p(), "Window");
+				}
+				bufferu.format("[%u, %u]", matchMin, matchMax);
+				log->writeLinef("%16s  %s", bufferu.p(), "Match");
+				log->writeLinef("%16u  %s", encodeThreads, "Threads");
 		}
 		else if(encodeMethod == 2)
 		{
@@ -2199,6 +2967,9 @@ int Archive::impl::list()
 			log->writeLinef("%16u  %s", matchMax, "Context");
 		}
 
+		}
+		decodeProps(arcHead.encodeProps);
+
 		float ratio = (float) archiveSize / sourceFileSize;
 		log->writeLinef("%16.2f  %s", ratio, "Ratio");
 	}
@@ -2260,6 +3031,12 @@ void Archive::setValue(uint_t value, byte type)
 		_m->matchRolz = clamp(value, 3, 0);
 	if(type == 21)
 		_m->encodeCmix = value;
+	if(type == 22)
+		_m->memoryLimit = value;
+	if(type == 23)
+		_m->encodeWindow = value;
+	if(type == 24)
+		_m->sortSimilar = value;
 	if(type == 15)
 		_m->encodeSuffix = value;
 	if(type == 6)
@@ -2305,6 +3082,7 @@ uint_t Archive::getValue(byte type)
 	switch(type)
 	{
 	case 0:
+		_m->buildFileList();
 		return (uint_t) &_m->fileList;
 	case 1:
 		return (uint_t) &_m->archive.getName();
@@ -2338,6 +3116,15 @@ uint_t Archive::getValue(byte type)
 		return (uint_t) _m->encodeThreads;
 	case 16:
 		return (uint_t) _m->encodeCmix;
+	case 17:
+		return (uint_t) _m->memoryUsage;
+	case 18:
+		return (uint_t) _m->longWindow;
+	case 19:
+		return (uint_t) &_m->stats;
+	case 20:
+		_m->stats.json(_m->statsText);
+		return (uint_t) _m->statsText;
 	}
 	return 0;
 }
@@ -2357,115 +3144,1189 @@ String Archive::getName()
 	return _m->archive.getName();
 }
 
-int Archive::impl::sortFileExt(StringArray& filesIn, StringArray& filesOut)
+int Archive::impl::sortFiles(StringArray& filesIn, StringArray& filesOut)
 {
-	byte haveExt = 0;
-	uint ext[2] = {0}; // offset [.]ext
-	byte* proc = new byte[filesIn.size()];
-	forn(filesIn.size())
-	proc[i] = 0;
-	String files[2];
-
-	forn(filesIn.size())
+	uint filesCount = filesIn.size();
+	Array<ArchiveFileOrder> order;
+	order.resize(filesCount);
+	forn(filesCount)
 	{
-		if(proc[i]) continue;
-		proc[i] = 1;
-
-		filesOut.push_back(filesIn[i]);
-
-		haveExt = 1;
-		ext[0] = filesIn[i].findr(0x2E);
-		if(ext[0] == MAX_UINT32)
-			haveExt = 0;
-		ext[0]++;
-		if(haveExt)
+		// extension after last dot of name
+		wchar_t* path = filesIn[i].p();
+		uint length = filesIn[i].length();
+		uint name = 0;
+		uint dot = MAX_UINT32;
+		form(u, length)
 		{
-			files[0] = filesIn[i].substr(ext[0]);
-			files[0].tolower();
+			if(path[u] == PATH_SEP or path[u] == PATH_SEP_REV)
+			{
+				name = u + 1;
+				dot = MAX_UINT32;
+			}
+			else if(path[u] == '.')
+				dot = u;
 		}
-
-		for(uint u = i + 1; u < filesIn.size(); u++)
+		wint ext = 0;
+		if(dot != MAX_UINT32)
 		{
-			if(proc[u]) continue;
-			ext[1] = filesIn[u].findr(0x2E);
-			if(!haveExt and ext[1] == MAX_UINT32)
+			for(uint u = dot + 1; u < length; u++)
 			{
-				filesOut.push_back(filesIn[u]);
-				proc[u] = 1;
+				wchar_t c = path[u];
+				if(c >= 'A' and c <= 'Z')
+					c += 'a' - 'A';
+				ext = HashMurmur64A((byte*) &c, sizeof(c), ext);
 			}
-			else if(haveExt and ext[1] != MAX_UINT32)
+			ext |= 1;
+		}
+		order[i].ext = ext;
+		order[i].size = fileSize(filesIn[i]);
+		order[i].name = name;
+		order[i].index = i;
+		order[i].group = 0;
+	}
+
+	ArchiveFileCompare compare;
+	compare.files = &filesIn;
+	compare.similar = 0;
+	order.qsort(compare);
+
+	if(sortSimilar and filesCount > 1)
+	{
+		// files with same band of sketch in one group,
+		// group by least position in order
+		uint sketchSize = SKETCH_BANDS * SKETCH_ROWS;
+		Array<wint> sketch;
+		sketch.resize(sketchSize);
+		Array<uint> parent;
+		parent.resize(filesCount);
+		forn(filesCount)
+		parent[i] = i;
+
+		uint slots = 16;
+		while(slots < filesCount * SKETCH_BANDS * 2)
+			slots <<= 1;
+		uint mask = slots - 1;
+		Array<wint> slotKey;
+		Array<uint> slotFile;
+		slotKey.resize(slots);
+		slotFile.resize(slots);
+		forn(slots)
+		slotFile[i] = MAX_UINT32;
+
+		forn(filesCount)
+		{
+			if(!order[i].size or !sketchFile(filesIn[order[i].index], sketch.begin()))
+				continue;
+			form(band, SKETCH_BANDS)
 			{
-				ext[1]++;
-				files[1] = filesIn[u].substr(ext[1]);
-				files[1].tolower();
-				// if(stdcmp(filesIn[i].p() + ext[0], filesIn[u].p() + ext[1]))
-				if(files[0] == files[1])
+				// same extension, band index in key
+				wint key = HashMurmur64A((byte*) (sketch.begin() + band * SKETCH_ROWS),
+				                         SKETCH_ROWS * sizeof(wint), order[i].ext + band);
+				uint h = (uint) key & mask;
+				while(slotFile[h] != MAX_UINT32 and slotKey[h] != key)
+					h = h + 1 & mask;
+				if(slotFile[h] == MAX_UINT32)
 				{
-					filesOut.push_back(filesIn[u]);
-					proc[u] = 1;
+					slotKey[h] = key;
+					slotFile[h] = i;
+					continue;
 				}
+
+				// roots of both files, least position is root
+				uint a = slotFile[h];
+				uint b = i;
+				while(parent[a] != a)
+					a = parent[a] = parent[parent[a]];
+				while(parent[b] != b)
+					b = parent[b] = parent[parent[b]];
+				if(a < b)
+					parent[b] = a;
+				else
+					parent[a] = b;
 			}
 		}
+
+		uint groups = 0;
+		forn(filesCount)
+		{
+			uint root = i;
+			while(parent[root] != root)
+				root = parent[root];
+			order[i].group = (wint) root << 32 | i;
+			groups += root != i;
+		}
+		compare.similar = 1;
+		if(groups)
+			order.qsort(compare);
+
+		if(log and groups)
+		{
+			uint consoleOut = log->getConsoleOutput();
+			log->setConsoleOutput(1);
+			logWriteLinef("Similar %u files\n", groups);
+			log->setConsoleOutput(consoleOut);
+		}
 	}
-	safe_delete_array(proc);
+
+	forn(filesCount)
+	filesOut.push_back(filesIn[order[i].index]);
 	return 1;
 }
 
-ICoder* Archive::impl::createMethod(byte modew)
+byte Archive::impl::sketchFile(const String& name, wint* sketch)
 {
-#ifdef TAA_ARCHIVARIUS_COMPRESS
-	byte encm = !modew ? 1 : 2;
+	FileStream file;
+	if(!file.open(name, 1))
+		return 0;
+	if(!mem) mem = new byte[BLOCK_SIZE];
+	uint size = file.readBuffer(mem, BLOCK_SIZE);
+	if(size < 8)
+		return 0;
 
-	if(encodeMethod == 1)
+	// hash of shingle by own seed for each row
+	uint sketchSize = SKETCH_BANDS * SKETCH_ROWS;
+	forn(sketchSize)
+	sketch[i] = (wint) -1;
+	wint shingle = 0;
+	forn(size)
 	{
-		LzreCoder* lzre = new LzreCoder;
+		shingle = shingle << 8 | mem[i];
+		if(i < 7)
+			continue;
+		wint h = shingle * 0x9E3779B97F4A7C15ULL;
+		form(r, sketchSize)
+		{
+			wint x = (h ^ (r + 1) * 0xD6E8FEB86659FD93ULL) * 0xC2B2AE3D27D4EB4FULL;
+			x ^= x >> 32;
+			if(x < sketch[r])
+				sketch[r] = x;
+		}
+	}
+	return 1;
+}
 
-		LzreParameters params;
-		params.mode = encm;
-		params.dictionary = dictSize;
-		params.minMatch = matchMin;
-		params.maxMatch = matchMax;
-		params.level = encodeLevel;
-		params.cycles = matchCycles;
-		params.suffix = encodeSuffix;
-		params.threads = encodeThreads;
-		params.cmix = encodeCmix;
+// props size 32 bit
+// dict size 5 bit 2 ^ n
+// word size 4 bit 2 ^ n
+// encode level 4 bit
+// encode threads 4 bit
+// encode minutes match len 4 bit
+// encode bigraph 1 bit
+// encode method 4 bit [low bits]
+// free 6 bit
+
+// Encoding properties from most significant bits.
+// Long window is dictionary by 4^n, 0 disable.
+// Dictonary, word is power of 2
+// Rolz range [0, 3] -> [16, 64, 128, 256]
+// --------------------------------------------
+// | i | description  | bit | shift | methods |
+// |------------------------------------------|
+// | 0 | level        |  4  |  28   | all     |
+// | 1 | dictionary   |  5  |  23   | all     |
+// | 2 | word         |  4  |  19   | all     |
+// | 3 | match minutes    |  4  |  15   | lzre    |
+// | 4 | rolz         |  2  |  13   | lzre    |
+// | 5 | threads      |  2  |  11   | lzre    |
+// | 6 | cmix         |  1  |  10   | lzre    |
+// | 7 | history      |  1  |   9   | all     |
+// | 8 | long window  |  2  |   7   | lzre    |
+// | 9 | bigraph fmt  |  2  |   5   | all     |
+// | A | bigraph      |  1  |   4   | all     |
+// | B | method       |  4  |   0   | all     |
+// --------------------------------------------
+
+uint Archive::impl::encodeProps()
+{
+	uint props = encodeMethod;
 
-		if(matchRolz)
-			params.rolz = 64 << matchRolz - 1;
+	if(encodeMethod < 3)
+	{
+		props |= encodeLevel << 28;
+		props |= bitGreat(dictSize - 1) << 23;
 
-		lzre->initialise(&params);
+		if(encodeMethod == 1)
+		{
+			props |= bitGreat(matchMax - 1) << 19;
+			props |= matchMin << 15;
+			props |= matchRolz << 13;
+			props |= encodeThreads << 11;
+			props |= encodeCmix << 10;
+			if(longWindow)
+				props |= (bitGreat(longWindow - 1) - bitGreat(dictSize - 1)) / 2 << 7;
+		}
+		if(encodeMethod == 2)
+			props |= matchMax << 19;
+		if(encodeHistory)
+			props |= 1 << 9;
+		if(encodeBigraph)
+		{
+			props |= 1 << 4;
+			props |= bigraphFormat << 5;
+		}
+	}
+	return props;
+}
 
-		dictSize = params.dictionary;
+void Archive::impl::decodeProps(uint props)
+{
+	encodeMethod = props & 0x0F;
+	if(encodeMethod and encodeMethod < 3)
+	{
+		encodeLevel = (props >> 28) & 0x0F;
+		dictSize = 1 << ((props >> 23) & 0x1F);
+		if(encodeMethod == 1)
+		{
+			matchMax = 1 << ((props >> 19) & 0x0F);
+			matchMin = (props >> 15) & 0x0F;
+			matchRolz = (props >> 13) & 0x03;
+			encodeThreads = (props >> 11) & 0x03;
+			encodeCmix = (props >> 10) & 0x01;
+		}
+		if(encodeMethod == 2)
+			matchMax = (props >> 19) & 0x0F;
+		encodeHistory = (props >> 9) & 0x01;
+		encodeBigraph = (props >> 4) & 0x01;
+		bigraphFormat = (props >> 5) & 0x03;
+		longWindow = 0;
+		if(encodeMethod == 1 and (props >> 7) & 0x03)
+			longWindow = dictSize << ((props >> 7) & 0x03) * 2;
+	}
+}
+
+uint Archive::impl::beginSegment(SmartPtr<ICoder>& encoder, byte method, wint size, wint& cryptPos)
+{
+	uint* param = &encodeMethod;
+	forn(11) param[i] = paramsCur[i];
+	encodeMethod = method;
+	fitMemory();
+
+	// long window is dictionary by 4^n, not above data
+	longWindow = 0;
+	if(encodeMethod == 1 and encodeWindow)
+	{
+		uint dictBit = bitGreat(dictSize - 1);
+		uint windowBit = bitGreat(MIN((wint) encodeWindow, sourceFileSize + 4096) - 1);
+		uint shift = windowBit > dictBit ? MIN((windowBit - dictBit + 1) / 2, 3) : 0;
+		while(shift and dictBit + shift * 2 > 30)
+			shift--;
+		if(shift)
+			longWindow = 1 << dictBit + shift * 2;
+	}
+	encoder.set(createMethod(0));
+	encoder->setStats(&stats);
+
+	// cm decoder need source file size,
+	// after bigraph size saved in archive header
+	cryptPos = 0;
+	if(encodeMethod == 2 and encodeBigraph == 0)
+	{
+		if(cryptState & 2)
+			cryptStore(archive, (byte*) &size, 8, cryptPos, 0);
+		else
+			archive.storeWint(size);
+	}
+	return encodeProps();
+}
+
+ICoder* Archive::impl::createMethod(byte modew)
+{
+	CoderParameters params;
+	params.method = encodeMethod;
+	params.mode = !modew ? 1 : 2;
+	params.dictionary = dictSize;
+	params.minMatch = matchMin;
+	params.maxMatch = matchMax;
+	params.level = encodeLevel;
+	params.cycles = matchCycles;
+	params.suffix = encodeSuffix;
+	params.threads = encodeThreads;
+	params.cmix = encodeCmix;
+	params.history = encodeHistory;
+	params.window = longWindow;
+
+	if(encodeMethod == 1 and matchRolz)
+		params.rolz = 64 << matchRolz - 1;
+
+	// bigraph blocks, size of cm stream in archive header
+	if(encodeMethod == 2 and modew and encodeBigraph and bigraphFormat)
+		params.size = bigraphSize;
+
+	ICoder* coder = createCoder(&params);
+	if(!coder)
+		return 0;
+
+	dictSize = params.dictionary;
+	matchMax = params.maxMatch;
+	if(encodeMethod == 1)
+	{
 		matchMin = params.minMatch;
-		matchMax = params.maxMatch;
 		matchCycles = params.cycles;
 		encodeSuffix = params.suffix;
 		encodeThreads = params.threads;
 		matchRolzOut = params.rolz;
+		longWindow = params.window;
+	}
+	return coder;
+}
+
+wint Archive::impl::encodeMemory()
+{
+	wint size = BLOCK_SIZE * 2; // mem, memEnc
+	if(encodeBigraph)
+		size += BLOCK_SIZE + BigraphCoder::memory(1);
+	if(cryptState & 2)
+		size += CRYPT_BLOCK + 16;
+	if(encodeMethod == 1)
+		size += CHUNK_MAX; // chunk, index grows with data
+
+	CoderParameters params;
+	params.method = encodeMethod;
+	params.mode = 1;
+	params.dictionary = dictSize;
+	params.minMatch = matchMin;
+	params.maxMatch = matchMax;
+	params.level = encodeLevel;
+	params.cycles = matchCycles;
+	params.threads = encodeThreads;
+	params.cmix = encodeCmix;
+	params.history = encodeHistory;
+	params.window = encodeWindow;
+	size += coderMemory(&params);
+	return size;
+}
+
+void Archive::impl::fitMemory()
+{
+	memoryUsage = encodeMemory();
+	if(!memoryLimit or memoryUsage <= memoryLimit)
+		return;
 
-		return lzre;
+	// lzre match hash by min match, prefix 4 to 2
+	uint prefix = matchMin ? clamp(matchMin, 4, 2) : 4;
+	while(memoryUsage > memoryLimit)
+	{
+		// long window first, power of 2 below, window of decoder is 2^n
+		if(encodeMethod == 1 and encodeWindow > dictSize)
+			encodeWindow >>= 1;
+		else if(dictSize > 1 << 16)
+			dictSize = MAX(1 << bitGreat(dictSize - 1) >> 1, 1 << 16);
+		else if(encodeMethod == 1 and prefix > 2)
+			matchMin = --prefix;
+		else
+			break;
+		memoryUsage = encodeMemory();
 	}
-#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
-	else if(encodeMethod == 2)
+
+	if(log)
 	{
-		CmCoder* cmix = new CmCoder;
+		uint consoleOut = log->getConsoleOutput();
+		log->setConsoleOutput(1);
+		logWriteLinef("Memory limit %u Kb, dictionary %u Kb, usage %u Kb%s\n",
+			(uint) (memoryLimit / KB), (uint) (dictSize / KB), (uint) (memoryUsage / KB),
+			memoryUsage > memoryLimit ? ", over limit" : "");
+		log->setConsoleOutput(consoleOut);
+	}
+}
 
-		CmParameters params;
-		params.dictionary = dictSize;
-		params.context = matchMax;
-		params.level = encodeLevel;
+wint Archive::impl::dedupFiles(StringArray& files, ArchiveFileHeader* fileHeads, uint* source, uint filesCount)
+{
+	// open addressing, slots not less twice of files
+	uint slots = 16;
+	while(slots < filesCount * 2)
+		slots <<= 1;
+	uint mask = slots - 1;
+	Array<uint> slotSize; // first file of size
+	Array<uint> slotData; // first file of size and hash
+	slotSize.resize(slots);
+	slotData.resize(slots);
+	forn(slots)
+	{
+		slotSize[i] = MAX_UINT32;
+		slotData[i] = MAX_UINT32;
+	}
+	Array<wint> hash;
+	hash.resize(filesCount);
+	byte* same = new byte[filesCount]; // other file with same size
 
-		cmix->initialise(&params);
+	// hash only files with same size
+	forn(filesCount)
+	{
+		source[i] = i;
+		same[i] = 0;
+		wint size = fileHeads[i].size;
+		if(!size)
+			continue;
+		uint h = (uint) HashMurmur64A((byte*) &size, 8, 0) & mask;
+		while(slotSize[h] != MAX_UINT32 and fileHeads[slotSize[h]].size != size)
+			h = h + 1 & mask;
+		if(slotSize[h] == MAX_UINT32)
+			slotSize[h] = i;
+		else
+		{
+			same[slotSize[h]] = 1;
+			same[i] = 1;
+		}
+	}
 
-		dictSize = params.dictionary;
-		matchMax = params.context;
+	wint dataSize = 0;
+	uint duplicates = 0;
+	wint duplicatesSize = 0;
+	forn(filesCount)
+	{
+		wint size = fileHeads[i].size;
+		if(same[i])
+		{
+			hash[i] = hashFile(files[i]);
+			uint h = (uint) HashMurmur64A((byte*) &size, 8, hash[i]) & mask;
+			while(slotData[h] != MAX_UINT32)
+			{
+				uint first = slotData[h];
+				if(fileHeads[first].size == size and hash[first] == hash[i])
+					break;
+				h = h + 1 & mask;
+			}
+			// data of same hash compared, else own data
+			if(slotData[h] == MAX_UINT32)
+				slotData[h] = i;
+			else if(compareFiles(files[slotData[h]], files[i]))
+			{
+				source[i] = slotData[h];
+				duplicates++;
+				duplicatesSize += size;
+				continue;
+			}
+		}
+		dataSize += size;
+	}
+	safe_delete_array(same);
+
+	if(log and duplicates)
+	{
+		uint consoleOut = log->getConsoleOutput();
+		log->setConsoleOutput(1);
+		logWriteLinef("Duplicates %u files, %u Kb\n", duplicates, (uint) (duplicatesSize / KB));
+		log->setConsoleOutput(consoleOut);
+	}
+	return dataSize;
+}
+
+wint Archive::impl::hashFile(const String& name)
+{
+	FileStream file;
+	if(!file.open(name, 1))
+		return 0;
+	if(!mem) mem = new byte[BLOCK_SIZE];
+	wint hash = 0;
+	uint readBytes = 0;
+	while((readBytes = file.readBuffer(mem, BLOCK_SIZE)) != 0)
+		hash = HashMurmur64A(mem, readBytes, hash);
+	return hash;
+}
 
-		return cmix;
+wint Archive::impl::sniffFiles(StringArray& files, ArchiveFileHeader* fileHeads, uint* source,
+                               byte* kind, byte text, uint filesCount)
+{
+	if(!mem) mem = new byte[BLOCK_SIZE];
+	wint storedTotal = 0;
+	uint storedCount = 0;
+	forn(filesCount)
+	{
+		kind[i] = DATA_BINARY;
+		if(source[i] != i or fileHeads[i].size < (text ? 1 : STORE_SIZE_MIN))
+			continue;
+		FileStream file;
+		if(!file.open(files[i], 1))
+			continue;
+		uint readBytes = file.readBuffer(mem, BLOCK_SIZE);
+		if(incompressible(mem, readBytes))
+		{
+			kind[i] = DATA_STORE;
+			storedCount++;
+			storedTotal += fileHeads[i].size;
+		}
+		else if(text and textData(mem, readBytes))
+			kind[i] = DATA_TEXT;
 	}
+
+	if(log and storedCount)
+	{
+		uint consoleOut = log->getConsoleOutput();
+		log->setConsoleOutput(1);
+		logWriteLinef("Stored %u files, %u Kb\n", storedCount, (uint) (storedTotal / KB));
+		log->setConsoleOutput(consoleOut);
+	}
+	return storedTotal;
+}
+
+byte Archive::impl::incompressible(byte* data, uint size)
+{
+	if(size < STORE_SIZE_MIN)
+		return 0;
+
+	// entropy of bytes near random data, random sample is less
+	// 8 bits per byte by 255 / (2 ln 2) = 184 bits in total
+	uint freq[256];
+	menset(freq, 0, sizeof(freq));
+	forn(size)
+	freq[data[i]]++;
+	float bits = size * log2((float) size);
+	forn(256)
+	{
+		if(freq[i])
+			bits -= freq[i] * log2((float) freq[i]);
+	}
+	if(bits < size * 8.0f - 184 * 3)
+		return 0;
+
+	// repeats of 6 bytes and more not above 1/64 of data
+	half table[4096];
+	menset(table, 0, sizeof(table));
+	uint repeats = 0;
+	uint i = 1;
+	while(i + 8 <= size)
+	{
+		uint v = data[i] | data[i + 1] << 8 | data[i + 2] << 16 | (uint) data[i + 3] << 24;
+		uint h = v * 0x9E3779B1 >> 20;
+		uint match = table[h];
+		table[h] = (half) i;
+		uint len = 0;
+		if(match)
+		{
+			uint lenMax = MIN(size - i, 64u);
+			while(len < lenMax and data[match + len] == data[i + len])
+				len++;
+		}
+		if(len >= 6)
+		{
+			repeats += len;
+			i += len;
+		}
+		else
+			i++;
+	}
+	return repeats < size / 64;
+}
+
+byte Archive::impl::textData(byte* data, uint size)
+{
+	uint control = 0;
+	forn(size)
+	{
+		byte c = data[i];
+		if(!c)
+			return 0;
+		if(c < 32 and c != '\t' and c != '\n' and c != '\r')
+			control++;
+	}
+	return control <= size / 128;
+}
+
+int Archive::impl::compareFiles(const String& name0, const String& name1)
+{
+	FileStream file0;
+	FileStream file1;
+	if(!file0.open(name0, 1) or !file1.open(name1, 1))
+		return 0;
+	if(!mem) mem = new byte[BLOCK_SIZE];
+	if(!memEnc) memEnc = new byte[BLOCK_SIZE];
+	while(1)
+	{
+		uint readBytes = file0.readBuffer(mem, BLOCK_SIZE);
+		if(file1.readBuffer(memEnc, BLOCK_SIZE) != readBytes)
+			return 0;
+		if(!readBytes)
+			return 1;
+		forn(readBytes)
+		{
+			if(mem[i] != memEnc[i])
+				return 0;
+		}
+	}
+}
+
+uint Archive::impl::storeDirectory(FileStream& file, ArchiveFileHeader* fileHeads, byte* names,
+                                   uint* source, uint* filter, byte* stored, byte* segment, uint filesCount)
+{
+	// record not more varints 4 * 10 bytes, name, crc, time,
+	// filter 2 varints, stored 1 varint, segment 1 varint
+	uint namesSize = 0;
+	uint filtered = 0;
+	uint storedCount = 0;
+	forn(filesCount)
+	{
+		namesSize += fileHeads[i].nameLen;
+		if(filter[i] and source[i] == i)
+			filtered++;
+		if(stored[i] and source[i] == i)
+			storedCount++;
+	}
+	Array<byte> raw;
+	raw.resize(namesSize + filesCount * 92 + chunkRefs.size() * 10 + segmentProps.size() * 30 + 32);
+
+	byte* p = raw.begin();
+	byte* name = names;
+	byte* prev = names;
+	uint prevLen = 0;
+	forn(filesCount)
+	{
+		uint nameLen = fileHeads[i].nameLen;
+		uint prefix = 0;
+		uint prefixMax = MIN(nameLen, prevLen);
+		while(prefix < prefixMax and name[prefix] == prev[prefix])
+			prefix++;
+		p = storeVarint(p, prefix);
+		p = storeVarint(p, nameLen - prefix);
+		mencpy(p, name + prefix, nameLen - prefix);
+		p += nameLen - prefix;
+		p = storeVarint(p, fileHeads[i].size << 1 | (source[i] != i));
+		if(source[i] != i)
+			p = storeVarint(p, i - source[i]);
+		mencpy(p, &fileHeads[i].crc, 4);
+		p += 4;
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+		mencpy(p, fileHeads[i].time, 8);
+		p += 8;
 #endif
+		prev = name;
+		prevLen = nameLen;
+		name += nameLen;
+	}
+
+	// references of repeated chunks
+	p = storeVarint(p, chunkRefs.size() / 3);
+	forn(chunkRefs.size())
+	p = storeVarint(p, chunkRefs[i]);
+
+	// filters of files with own data, distance from previous filtered file
+	uint segments = segmentProps.size();
+	if(filtered or storedCount or segments > 1)
+	{
+		p = storeVarint(p, filtered);
+		uint prevFile = 0;
+		forn(filesCount)
+		{
+			if(!filter[i] or source[i] != i)
+				continue;
+			p = storeVarint(p, i - prevFile);
+			p = storeVarint(p, filter[i]);
+			prevFile = i;
+		}
+	}
+
+	// stored files with own data, distance from previous stored file
+	if(storedCount or segments > 1)
+	{
+		p = storeVarint(p, storedCount);
+		uint prevFile = 0;
+		forn(filesCount)
+		{
+			if(!stored[i] or source[i] != i)
+				continue;
+			p = storeVarint(p, i - prevFile);
+			prevFile = i;
+		}
+	}
+
+	// streams after first, files with own data of stream
+	if(segments > 1)
+	{
+		p = storeVarint(p, segments - 1);
+		for(uint s = 1; s < segments; s++)
+		{
+			uint count = 0;
+			forn(filesCount)
+			{
+				if(segment[i] == s and source[i] == i and !stored[i])
+					count++;
+			}
+			p = storeVarint(p, segmentProps[s]);
+			p = storeVarint(p, segmentSize[s]);
+			p = storeVarint(p, count);
+			uint prevFile = 0;
+			forn(filesCount)
+			{
+				if(segment[i] != s or source[i] != i or stored[i])
+					continue;
+				p = storeVarint(p, i - prevFile);
+				prevFile = i;
+			}
+		}
+	}
+
+	ArchiveDirectory dir;
+	menset(&dir, 0, sizeof(dir));
+	dir.sizeRaw = p - raw.begin();
+	crc.reset();
+	crc.calculate(raw.begin(), dir.sizeRaw);
+	dir.crc = crc.get();
+
+	// packed stream if less
+	byte* data = raw.begin();
+	dir.size = dir.sizeRaw;
+	Array<byte> packed;
+	if(codeDirectory(raw.begin(), dir.sizeRaw, packed, dir, 1) and packed.size() < dir.sizeRaw)
+	{
+		data = packed.begin();
+		dir.size = packed.size();
+		dir.method = 1;
+	}
+	else
+		dir.method = 0;
+
+	// crypt stream less 16 bytes padded
+	uint size = dir.size;
+	byte pad[16];
+	if(cryptState & 1)
+	{
+		if(size < 16)
+		{
+			menset(pad, 0, 16);
+			mencpy(pad, data, size);
+			data = pad;
+			size = 16;
+		}
+		cryptData(data, size, 0, 0);
+	}
+
+	file.storeBuffer(&dir, sizeof(dir));
+	file.storeBuffer(data, size);
+	return sizeof(dir) + size;
+}
+
+uint Archive::impl::readDirectory(ArchiveFileHeader* fileHeads, Array<byte>& names,
+                                  uint* source, uint* filter, byte* stored, byte* segment, uint filesCount)
+{
+	ArchiveDirectory dir;
+	wint dirPos = archiveHeadSize + arcHead.dataSize;
+	if(dirPos + sizeof(dir) > archiveSize)
+		return 0;
+	archive.seekw(dirPos, 0);
+	archive.readBuffer(&dir, sizeof(dir));
+
+	uint size = dir.size;
+	if(cryptState & 1 and size < 16)
+		size = 16;
+	if(dirPos + sizeof(dir) + size != archiveSize)
+		return 0;
+
+	// zeros after stream, varints of damaged records end in it
+	Array<byte> data;
+	data.resize(size + 32);
+	archive.readBuffer(data.begin(), size);
+	if(cryptState & 1)
+		cryptData(data.begin(), size, 0, 1);
+
+	Array<byte> unpacked;
+	Array<byte>* raw = &data;
+	if(dir.method == 1)
+	{
+		if(!codeDirectory(data.begin(), dir.size, unpacked, dir, 2))
+			return 0;
+		raw = &unpacked;
+	}
+	else if(dir.size != dir.sizeRaw)
+		return 0;
+	menset(raw->begin() + dir.sizeRaw, 0, raw->size() - dir.sizeRaw);
+
+	crc.reset();
+	crc.calculate(raw->begin(), dir.sizeRaw);
+	if(crc.get() != dir.crc)
+		return 0;
+
+	// names by shared prefixes
+	byte* p = raw->begin();
+	byte* end = p + dir.sizeRaw;
+	uint namesSize = 0;
+	uint prevLen = 0;
+	forn(filesCount)
+	{
+		if(p >= end)
+			return 0;
+		uint prefix = loadVarint(p);
+		wint suffix = loadVarint(p);
+		if(p > end or prefix > prevLen or suffix > (wint) (end - p) or prefix + suffix > 0xFFFF)
+			return 0;
+		uint nameLen = prefix + suffix;
+		if(names.capacity() < namesSize + nameLen)
+			names.reserve((namesSize + nameLen) * 2);
+		names.resize(namesSize + nameLen);
+		byte* name = names.begin() + namesSize;
+		mencpy(name, name - prevLen, prefix);
+		mencpy(name + prefix, p, suffix);
+		p += suffix;
+		namesSize += nameLen;
+		prevLen = nameLen;
+
+		fileHeads[i].nameLen = nameLen;
+		wint size = loadVarint(p);
+		fileHeads[i].size = size >> 1;
+		source[i] = i;
+		filter[i] = 0;
+		stored[i] = 0;
+		segment[i] = 0;
+		if(size & 1)
+		{
+			// previous file with same data
+			wint distance = loadVarint(p);
+			if(!distance or distance > i or fileHeads[i - distance].size != fileHeads[i].size)
+				return 0;
+			source[i] = source[i - distance];
+		}
+		mencpy(&fileHeads[i].crc, p, 4);
+		p += 4;
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+		mencpy(fileHeads[i].time, p, 8);
+		p += 8;
 #endif
+	}
+
+	// references of repeated chunks, absent before chunking
+	chunkRefs.clear();
+	if(p < end)
+	{
+		// triples of varints, at least byte each
+		wint refs = loadVarint(p);
+		if(p > end or refs > (wint) (end - p) / 3)
+			return 0;
+		chunkRefs.resize((uint) refs * 3);
+		forn(chunkRefs.size())
+		{
+			if(p >= end)
+				return 0;
+			chunkRefs[i] = loadVarint(p);
+		}
+	}
+
+	// filters, absent without filtered files
+	if(p < end)
+	{
+		wint filtered = loadVarint(p);
+		if(filtered > filesCount)
+			return 0;
+		wint file = 0;
+		forn(filtered)
+		{
+			if(p >= end)
+				return 0;
+			file += loadVarint(p);
+			if(file >= filesCount or source[file] != file)
+				return 0;
+			filter[file] = loadVarint(p);
+			uint stride = filter[file] >> 8;
+			if(filter[file] != FILTER_EXE and (filter[file] & 0xFF) != FILTER_DELTA)
+				return 0;
+			if((filter[file] & 0xFF) == FILTER_DELTA and (stride < 1 or stride > DELTA_STRIDE_MAX))
+				return 0;
+		}
+		forn(filesCount)
+		filter[i] = filter[source[i]];
+	}
+
+	// stored files, absent without stored files
+	if(p < end)
+	{
+		wint storedCount = loadVarint(p);
+		if(storedCount > filesCount)
+			return 0;
+		wint file = 0;
+		forn(storedCount)
+		{
+			if(p >= end)
+				return 0;
+			file += loadVarint(p);
+			if(file >= filesCount or source[file] != file)
+				return 0;
+			stored[file] = 1;
+		}
+		forn(filesCount)
+		stored[i] = stored[source[i]];
+	}
+
+	// streams after first, absent with one stream
+	if(p < end)
+	{
+		wint segments = loadVarint(p);
+		if(segments > 255 or segments > (wint) (end - p))
+			return 0;
+		for(uint s = 1; s <= segments; s++)
+		{
+			if(p >= end)
+				return 0;
+			uint props = (uint) loadVarint(p);
+			if(!(props & 0x0F) or (props & 0x0F) > 2)
+				return 0;
+			segmentProps.push_back(props);
+			segmentSize.push_back(loadVarint(p));
+			wint count = loadVarint(p);
+			if(count > filesCount)
+				return 0;
+			wint file = 0;
+			forn(count)
+			{
+				if(p >= end)
+					return 0;
+				file += loadVarint(p);
+				if(file >= filesCount or source[file] != file or stored[file])
+					return 0;
+				segment[file] = s;
+			}
+		}
+		forn(filesCount)
+		segment[i] = segment[source[i]];
+	}
+	if(p != end)
+		return 0;
+	return sizeof(dir) + size;
+}
+
+int Archive::impl::codeDirectory(byte* src, uint size, Array<byte>& dst, ArchiveDirectory& dir, byte modew)
+{
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+	LzreCoder lzre;
+	LzreParameters params;
+	params.mode = modew;
+	params.level = DIRECTORY_LEVEL;
+	params.threads = 1;
+	params.history = 1;
+	if(modew == 1)
+		params.dictionary = 1 << bitGreat(MAX(size, 2) - 1);
+	else
+	{
+		params.dictionary = 1 << dir.dictionary;
+		params.minMatch = dir.minMatch;
+		params.maxMatch = dir.maxMatch;
+	}
+	lzre.initialise(&params);
+	if(modew == 1)
+	{
+		dir.dictionary = bitGreat(params.dictionary - 1);
+		dir.minMatch = params.minMatch;
+		dir.maxMatch = params.maxMatch;
+	}
+
+	// destination by blocks, decoded size known
+	uint dstSize = 0;
+	uint dstMax = modew == 1 ? size + BLOCK_SIZE : dir.sizeRaw;
+	dst.resize(dstMax + 32);
+	byte block[BLOCK_SIZE];
+	CoderStream sm;
+	sm.dst = block;
+	uint pos = 0;
+	while(pos < size)
+	{
+		sm.src = src + pos;
+		sm.srcAvail = MIN(size - pos, BLOCK_SIZE);
+		pos += sm.srcAvail;
+		int ret = IS_STREAM_END;
+		while(ret == IS_STREAM_END)
+		{
+			sm.dstAvail = BLOCK_SIZE;
+			if(modew == 1)
+				ret = lzre.compress(&sm, pos == size);
+			else
+				ret = lzre.uncompress(&sm, pos == size);
+			if(dstSize + sm.dstAvail > dstMax)
+				return 0;
+			mencpy(dst.begin() + dstSize, block, sm.dstAvail);
+			dstSize += sm.dstAvail;
+		}
+		if(ret != IS_OK)
+			return 0;
+	}
+	if(modew == 1)
+		dst.resize(dstSize);
+	return modew == 1 or dstSize == dir.sizeRaw;
+#else
 	return 0;
+#endif
+}
+
+int Archive::impl::encodeData(SmartPtr<ICoder>& encoder, SmartPtr<BigraphCoder>& encoderBigraph,
+                              CoderStream* coderStream, CoderStream* bigraphStream,
+                              byte* data, uint size, byte flush, wint& cryptPos)
+{
+	int ret = IS_OK;
+	do
+	{
+		uint n = MIN(size, BLOCK_SIZE);
+		byte end = flush and n == size;
+		if(encodeBigraph)
+		{
+			// bigraph output to compression
+			bigraphStream->src = data;
+			bigraphStream->srcAvail = n;
+			int retb = IS_STREAM_END;
+			stats.bytes[STAGE_FILTER] += n;
+			while(retb == IS_STREAM_END and ret == IS_OK)
+			{
+				bigraphStream->dstAvail = BLOCK_SIZE;
+				wint stage = stageTimer.getMicroseconds();
+				retb = encoderBigraph->compress(bigraphStream, end);
+				stageEnd(STAGE_FILTER, stage, 0);
+				coderStream->srcAvail = bigraphStream->dstAvail;
+				if(coderStream->srcAvail)
+					ret = compressBlock(encoder, coderStream, end and retb == IS_OK, cryptPos);
+			}
+			if(retb != IS_OK)
+				ret = retb;
+		}
+		else
+		{
+			coderStream->src = data;
+			coderStream->srcAvail = n;
+			ret = compressBlock(encoder, coderStream, end, cryptPos);
+		}
+		data += n;
+		size -= n;
+	}
+	while(size and ret == IS_OK);
+	return ret;
+}
+
+int Archive::impl::storeDecoded(FileStream& file, byte* data, uint size)
+{
+	byte block[BLOCK_SIZE];
+	while(1)
+	{
+		// references after literal bytes
+		while(!chunkLiteral and chunkRef < chunkRefs.size())
+		{
+			wint length = chunkRefs[chunkRef + 1];
+			wint distance = chunkRefs[chunkRef + 2];
+			if(distance < length or distance > chunkPos)
+				return 0;
+			wint pos = chunkPos - distance;
+			while(length)
+			{
+				uint n = (uint) MIN(length, (wint) BLOCK_SIZE);
+				file.seekw(pos, 0);
+				file.readBuffer(block, n);
+				file.seekw(chunkPos, 0);
+				file.storeBuffer(block, n);
+				pos += n;
+				chunkPos += n;
+				length -= n;
+			}
+			chunkRef += 3;
+			// after last reference rest of data is literal
+			chunkLiteral = chunkRef < chunkRefs.size() ? chunkRefs[chunkRef] : (wint) -1;
+		}
+		if(!size)
+			return 1;
+		uint n = (uint) MIN((wint) size, chunkLiteral);
+		file.storeBuffer(data, n);
+		chunkPos += n;
+		chunkLiteral -= n;
+		data += n;
+		size -= n;
+	}
+}
+
+int Archive::impl::compressBlock(SmartPtr<ICoder>& encoder, CoderStream* sm, byte flush, wint& cryptPos)
+{
+	int ret = IS_STREAM_END;
+	stats.bytes[STAGE_CODE] += sm->srcAvail;
+	while(ret == IS_STREAM_END)
+	{
+		sm->dstAvail = BLOCK_SIZE;
+		wint stage = stageTimer.getMicroseconds();
+		ret = encoder->compress(sm, flush);
+		stageEnd(STAGE_CODE, stage, 0);
+		assert(sm->dstAvail != 0);
+
+		// crypt stream
+		if(cryptState & 2)
+			arcHead.dataSize += cryptStore(archive, sm->dst, sm->dstAvail, cryptPos, flush and ret == IS_OK);
+		else
+		{
+			stage = stageTimer.getMicroseconds();
+			archive.storeBuffer(sm->dst, sm->dstAvail);
+			stageEnd(STAGE_WRITE, stage, sm->dstAvail);
+		}
+	}
+	return ret;
+}
+
+void Archive::impl::cryptInit()
+{
+	encryption.keyExpansion((byte*)cryptString.p(), cryptLength);
+	if(!cryptBuffer) cryptBuffer = new byte[CRYPT_BLOCK + 16];
+}
+
+uint Archive::impl::cryptStore(FileStream& file, byte* data, uint size, wint& cryptPos, byte flush)
+{
+	while(size)
+	{
+		uint n = MIN(size, CRYPT_BLOCK + 16 - cryptBufferSize);
+		mencpy(cryptBuffer + cryptBufferSize, data, n);
+		cryptBufferSize += n;
+		data += n;
+		size -= n;
+
+		// full block, last 16 bytes to next block
+		if(cryptBufferSize == CRYPT_BLOCK + 16)
+		{
+			cryptData(cryptBuffer, CRYPT_BLOCK, cryptPos, 0);
+			wint stage = stageTimer.getMicroseconds();
+			file.storeBuffer(cryptBuffer, CRYPT_BLOCK);
+			stageEnd(STAGE_WRITE, stage, CRYPT_BLOCK);
+			cryptPos += CRYPT_BLOCK;
+			mencpy(cryptBuffer, cryptBuffer + CRYPT_BLOCK, 16);
+			cryptBufferSize = 16;
+		}
+	}
+
+	uint pad = 0;
+	if(flush)
+	{
+		// padding with zeros
+		if(cryptBufferSize < 16)
+		{
+			pad = 16 - cryptBufferSize;
+			menset(cryptBuffer + cryptBufferSize, 0, pad);
+			cryptBufferSize = 16;
+		}
+		cryptData(cryptBuffer, cryptBufferSize, cryptPos, 0);
+		wint stage = stageTimer.getMicroseconds();
+		file.storeBuffer(cryptBuffer, cryptBufferSize);
+		stageEnd(STAGE_WRITE, stage, cryptBufferSize);
+		cryptPos += cryptBufferSize;
+		cryptBufferSize = 0;
+	}
+	return pad;
+}
+
+void Archive::impl::cryptData(byte* data, uint size, wint pos, byte dec)
+{
+	// parts multiple of 16, last part with stealing in this thread
+	wint stage = stageTimer.getMicroseconds();
+	CryptPart part[CRYPT_THREADS];
+	uint n = MAX(MIN(size / CRYPT_PART, CRYPT_THREADS), 1);
+	uint partSize = size / n & ~15;
+	forn(n)
+	{
+		part[i].aes = &encryption;
+		part[i].data = data + i * partSize;
+		part[i].size = i == n - 1 ? size - i * partSize : partSize;
+		part[i].pos = pos + i * partSize;
+		part[i].dec = dec;
+	}
+
+#ifdef CRYPT_WORKERS
+	if(n > 1)
+	{
+		if(!cryptWorkers)
+			cryptWorkers = new CryptWorkers;
+		cryptWorkers->run(part, n);
+	}
+	else
+		cryptPart(&part[0]);
+#else
+	forn(n)
+	cryptPart(&part[i]);
+#endif
+	stageEnd(STAGE_CRYPT, stage, size);
 }
 
 int Archive::impl::getTime()
@@ -2509,6 +4370,29 @@ char* Archive::impl::getUnicode(const String& wides)
 	return bufferu.p();
 }
 
+void Archive::impl::buildFileList()
+{
+	// list cleared where table changes: open, close, append, remove, rename
+	uint filesCount = fileTable.count();
+	if(fileList.size() == filesCount)
+		return;
+	fileList.clear_ptr();
+	fileList.reserve(filesCount);
+	forn(filesCount)
+	{
+		ArchiveFileList* list = new ArchiveFileList;
+		list->name.assign(fileTable.name(i), fileTable.nameLength(i));
+		list->size = fileTable.size[i];
+		list->pos = fileTable.pos[i];
+		list->crc = fileTable.crc[i];
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+		list->time[0] = fileTable.time[i * 2];
+		list->time[1] = fileTable.time[i * 2 + 1];
+#endif
+		fileList.push_back(list);
+	}
+}
+
 void Archive::impl::logTime(uint filesCount)
 {
 	uint divn = 0;
@@ -2544,6 +4428,12 @@ void Archive::impl::logTime(uint filesCount)
 		wint dictsz = 1 << bitGreat(dictSize - 1);
 		divn = convertBytesToDecimal(dictsz, remainder);
 		log->writeLinef("%-12s  %u %s", "Dictionary", static_cast<uint>(dictsz), spc + divn * 3);
+		if(memoryUsage)
+		{
+			wint memsz = memoryUsage;
+			divn = convertBytesToDecimal(memsz, remainder);
+			log->writeLinef("%-12s  %u %s", "Footprint", static_cast<uint>(memsz), spc + divn * 3);
+		}
 
 		if(encodeMethod == 1)
 		{
@@ -2552,6 +4442,12 @@ void Archive::impl::logTime(uint filesCount)
 				log->writeLinef("%-12s  %u", "Cycles", matchCycles);
 			if(matchRolzOut)
 				log->writeLinef("%-12s  %u", "Rolz", matchRolzOut);
+			if(longWindow)
+			{
+				wint windowsz = longWindow;
+				divn = convertBytesToDecimal(windowsz, remainder);
+				log->writeLinef("%-12s  %u %s", "Window", static_cast<uint>(windowsz), spc + divn * 3);
+			}
 			if(encodeSuffix)
 				log->writeLinef("%-12s  %u", "Suffix", encodeSuffix);
 			log->writeLinef("%-12s  %u", "Threads", encodeThreads);
@@ -0,0 +1,451 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/ArchiveStream.h>
+#include <Compress/ICoder.h>
+#include <Compress/CoderFactory.h>
+#include <Common/FileStream.h>
+#include <Common/Crc32.h>
+#include <Common/Bitwise.h>
+#include <Common/Math.h>
+#include <Common/StringLib.h>
+#include <Common/container/Array.h>
+#include <Common/container/SmartPtr.h>
+
+#define STREAM_SIGNATURE 0x31737261 // "ars1"
+#define STREAM_BLOCK (1 << 16)
+#define STREAM_FRAME_MIN 16
+#define STREAM_FRAME_MAX 28
+
+namespace tas
+{
+
+#pragma pack(push, 1)
+/// stream header, parameters of coder after initialisation
+struct ArchiveStreamHeader
+{
+	uint signature;
+	byte method;     // 0 store, 1 lzre, 2 cm
+	byte level;
+	byte frame;      // frame size 2^n
+	byte dictionary; // 2^n
+	byte minMatch;
+	half maxMatch;   // lzre maximum match, cm context
+	half rolz;
+	byte threads;
+	byte options;    // bit 0 cmix, bit 1 history
+	byte reserved;
+};
+#pragma pack(pop)
+
+struct ArchiveStream::impl
+{
+	byte errorId;
+	String errorStr;
+
+	uint encodeMethod;
+	uint encodeLevel;
+	uint encodeThreads;
+	uint dictSize;
+	uint matchMax;
+	uint matchCycles;
+	uint matchMin;
+	uint encodeSuffix;
+	uint matchRolz;
+	uint encodeCmix;
+
+	Crc32 crc;
+	Array<byte> frame;   // data of frame
+	Array<byte> packed;  // compressed frame
+	Array<byte> blockIn;
+	Array<byte> blockOut;
+
+	impl()
+	{
+		errorId = 0;
+		encodeMethod = 0;
+		encodeLevel = 0;
+		encodeThreads = 0;
+		dictSize = 0;
+		matchMax = 0;
+		matchCycles = 0;
+		matchMin = 0;
+		encodeSuffix = 0;
+		matchRolz = 0;
+		encodeCmix = 0;
+		crc.tableInit();
+	}
+
+	void error(byte id, const char* str)
+	{
+		errorId = id;
+		errorStr = str;
+	}
+
+	/** Coder of one frame, parameters of header updated by coder.
+	  * @param mode 1 compress, 2 uncompress.
+	  * @param size Data of frame, cm decoder needs it.
+	  */
+	ICoder* createCoder(byte mode, ArchiveStreamHeader& head, uint size);
+
+	/** Compress frame to packed.
+	  * @return Compressed size, 0 if not less data or coder fail.
+	  */
+	uint encodeFrame(ArchiveStreamHeader& head, uint size);
+
+	/** Uncompress frame from source to destination by blocks.
+	  * @return 0 if frame damaged.
+	  */
+	int decodeFrame(FileStream& src, FileStream& dst, ArchiveStreamHeader& head,
+	                uint size, uint packedSize);
+};
+
+ICoder* ArchiveStream::impl::createCoder(byte mode, ArchiveStreamHeader& head, uint size)
+{
+	CoderParameters params;
+	params.method = head.method;
+	params.mode = mode;
+	params.dictionary = 1 << head.dictionary;
+	params.minMatch = head.minMatch;
+	params.maxMatch = head.maxMatch;
+	params.level = head.level;
+	params.cycles = matchCycles;
+	params.rolz = head.rolz;
+	params.suffix = encodeSuffix;
+	params.threads = head.threads;
+	params.cmix = head.options & 1;
+	params.history = head.options >> 1 & 1;
+
+	// frame size in stream, not in cm data
+	if(mode == 2 and head.method == 2)
+		params.size = size;
+
+	ICoder* coder = tas::createCoder(&params);
+	if(!coder)
+		return 0;
+
+	head.dictionary = bitGreat(params.dictionary - 1);
+	head.minMatch = params.minMatch;
+	head.maxMatch = params.maxMatch;
+	head.threads = params.threads;
+	head.rolz = params.rolz;
+	return coder;
+}
+
+uint ArchiveStream::impl::encodeFrame(ArchiveStreamHeader& head, uint size)
+{
+	SmartPtr<ICoder> encoder;
+	encoder.set(createCoder(1, head, size));
+	if(!encoder.ptr())
+		return 0;
+
+	CoderStream sm;
+	sm.dst = blockOut.begin();
+	uint packedSize = 0;
+	uint pos = 0;
+	int ret = IS_OK;
+
+	while(pos < size and ret == IS_OK)
+	{
+		uint readSize = MIN(size - pos, STREAM_BLOCK);
+		sm.src = frame.begin() + pos;
+		sm.srcAvail = readSize;
+		pos += readSize;
+
+		ret = IS_STREAM_END;
+		while(ret == IS_STREAM_END)
+		{
+			sm.dstAvail = STREAM_BLOCK;
+			ret = encoder->compress(&sm, pos == size);
+
+			// stored frame is less
+			if(packedSize + sm.dstAvail >= size)
+				return 0;
+			mencpy(packed.begin() + packedSize, sm.dst, sm.dstAvail);
+			packedSize += sm.dstAvail;
+		}
+	}
+	return ret == IS_OK ? packedSize : 0;
+}
+
+int ArchiveStream::impl::decodeFrame(FileStream& src, FileStream& dst, ArchiveStreamHeader& head,
+                                     uint size, uint packedSize)
+{
+	SmartPtr<ICoder> decoder;
+	decoder.set(createCoder(2, head, size));
+	if(!decoder.ptr())
+		return 0;
+
+	CoderStream sm;
+	sm.src = blockIn.begin();
+	sm.dst = blockOut.begin();
+	uint decoded = 0;
+
+	while(packedSize)
+	{
+		uint readSize = MIN(packedSize, STREAM_BLOCK);
+		if(src.readBuffer(blockIn.begin(), readSize) != readSize)
+			return 0;
+		packedSize -= readSize;
+		sm.srcAvail = readSize;
+
+		int ret = IS_STREAM_END;
+		while(ret == IS_STREAM_END)
+		{
+			sm.dstAvail = STREAM_BLOCK;
+			ret = decoder->uncompress(&sm, packedSize == 0);
+			if(decoded + sm.dstAvail > size)
+				return 0;
+			crc.calculate(sm.dst, sm.dstAvail);
+			if(dst.storeBuffer(sm.dst, sm.dstAvail) != sm.dstAvail)
+				return 0;
+			decoded += sm.dstAvail;
+		}
+		if(ret != IS_OK)
+			return 0;
+	}
+	return decoded == size;
+}
+
+ArchiveStream::ArchiveStream()
+{
+	_m = new impl;
+}
+
+ArchiveStream::~ArchiveStream()
+{
+	safe_delete(_m);
+}
+
+int ArchiveStream::compress(FileStream& src, FileStream& dst)
+{
+	_m->errorId = 0;
+	if(_m->encodeMethod > 2)
+	{
+		_m->error(1, "Stream method not in range [0, 2]");
+		return 0;
+	}
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+#if TAA_PLATFORM_TYPE != TAA_PLATFORM_DESKTOP
+	if(_m->encodeMethod == 2)
+	{
+		_m->error(1, "Stream method not supported");
+		return 0;
+	}
+#endif
+#else
+	if(_m->encodeMethod)
+	{
+		_m->error(1, "Stream method not supported");
+		return 0;
+	}
+#endif
+
+	// frame of dictionary size
+	uint frameSize = _m->dictSize ? _m->dictSize : 1 << 24;
+	frameSize = clamp(frameSize, 1 << STREAM_FRAME_MAX, 1 << STREAM_FRAME_MIN);
+	frameSize = 1 << bitGreat(frameSize - 1);
+
+	_m->frame.resize(frameSize);
+	_m->blockIn.resize(STREAM_BLOCK);
+	_m->blockOut.resize(STREAM_BLOCK);
+
+	// short data in one frame, dictionary not above data
+	uint size = src.readBuffer(_m->frame.begin(), frameSize);
+	if(size < frameSize)
+	{
+		frameSize = clamp(1 << bitGreat(size + 4096 - 1), (int) frameSize, 1 << STREAM_FRAME_MIN);
+	}
+	_m->packed.resize(frameSize);
+
+	ArchiveStreamHeader head;
+	menset(&head, 0, sizeof(head));
+	head.signature = STREAM_SIGNATURE;
+	head.method = _m->encodeMethod;
+	head.level = clamp(_m->encodeLevel ? _m->encodeLevel : 5, 9, 1);
+	head.frame = bitGreat(frameSize - 1);
+	head.dictionary = head.frame;
+	head.minMatch = _m->matchMin;
+	head.maxMatch = _m->matchMax;
+	head.rolz = _m->matchRolz ? 64 << _m->matchRolz - 1 : 0;
+	head.threads = _m->encodeThreads;
+	head.options = _m->encodeCmix ? 1 : 0;
+	head.options |= CODER_HISTORY << 1;
+
+	_m->crc.reset();
+	wint total = 0;
+	byte headStored = 0;
+
+	while(size)
+	{
+		_m->crc.calculate(_m->frame.begin(), size);
+		total += size;
+
+		// coder sets parameters of header by first frame
+		uint packedSize = head.method ? _m->encodeFrame(head, size) : 0;
+		if(!headStored)
+		{
+			dst.storeBuffer(&head, sizeof(head));
+			headStored = 1;
+		}
+
+		dst.storeUint(size);
+		if(packedSize)
+		{
+			dst.storeUint(packedSize);
+			dst.storeBuffer(_m->packed.begin(), packedSize);
+		}
+		else
+		{
+			dst.storeUint(size);
+			dst.storeBuffer(_m->frame.begin(), size);
+		}
+
+		if(size < frameSize)
+			break;
+		size = src.readBuffer(_m->frame.begin(), frameSize);
+	}
+
+	if(!headStored)
+		dst.storeBuffer(&head, sizeof(head));
+
+	// end frame, trailer
+	dst.storeUint(0);
+	dst.storeWint(total);
+	uint crc = _m->crc.get();
+	if(dst.storeBuffer(&crc, 4) != 4)
+	{
+		_m->error(2, "Can't write stream");
+		return 0;
+	}
+	return 1;
+}
+
+int ArchiveStream::uncompress(FileStream& src, FileStream& dst)
+{
+	_m->errorId = 0;
+
+	ArchiveStreamHeader head;
+	if(src.readBuffer(&head, sizeof(head)) != sizeof(head) or
+	        head.signature != STREAM_SIGNATURE)
+	{
+		_m->error(1, "Stream not recognized");
+		return 0;
+	}
+	if(head.method > 2 or head.frame < STREAM_FRAME_MIN or head.frame > STREAM_FRAME_MAX or
+	        head.dictionary > STREAM_FRAME_MAX)
+	{
+		_m->error(3, "Stream damaged");
+		return 0;
+	}
+
+	uint frameSize = 1 << head.frame;
+	_m->blockIn.resize(STREAM_BLOCK);
+	_m->blockOut.resize(STREAM_BLOCK);
+	_m->crc.reset();
+	wint total = 0;
+
+	while(1)
+	{
+		uint size = 0;
+		uint packedSize = 0;
+		if(src.readBuffer(&size, 4) != 4)
+		{
+			_m->error(3, "Stream damaged");
+			return 0;
+		}
+		if(!size)
+			break;
+		if(src.readBuffer(&packedSize, 4) != 4 or
+		        size > frameSize or !packedSize or packedSize > size)
+		{
+			_m->error(3, "Stream damaged");
+			return 0;
+		}
+
+		// stored frame copied by blocks
+		if(packedSize == size)
+		{
+			while(packedSize)
+			{
+				uint readSize = MIN(packedSize, STREAM_BLOCK);
+				if(src.readBuffer(_m->blockIn.begin(), readSize) != readSize)
+				{
+					_m->error(3, "Stream damaged");
+					return 0;
+				}
+				_m->crc.calculate(_m->blockIn.begin(), readSize);
+				if(dst.storeBuffer(_m->blockIn.begin(), readSize) != readSize)
+				{
+					_m->error(2, "Can't write stream");
+					return 0;
+				}
+				packedSize -= readSize;
+			}
+		}
+		else if(!_m->decodeFrame(src, dst, head, size, packedSize))
+		{
+			_m->error(3, "Stream damaged");
+			return 0;
+		}
+		total += size;
+	}
+
+	wint totalStored = 0;
+	uint crcStored = 0;
+	if(src.readBuffer(&totalStored, 8) != 8 or src.readBuffer(&crcStored, 4) != 4 or
+	        totalStored != total or crcStored != _m->crc.get())
+	{
+		_m->error(4, "Stream crc error");
+		return 0;
+	}
+	return 1;
+}
+
+void ArchiveStream::setValue(uint_t value, byte type)
+{
+	if(type == 0)
+		_m->encodeMethod = value;
+	if(type == 1)
+		_m->encodeLevel = value;
+	if(type == 2)
+		_m->encodeThreads = value;
+	if(type == 3)
+		_m->dictSize = value;
+	if(type == 4)
+		_m->matchMax = value;
+	if(type == 5)
+		_m->matchCycles = value;
+	if(type == 9)
+		_m->matchMin = value;
+	if(type == 15)
+		_m->encodeSuffix = value;
+	if(type == 20)
+		_m->matchRolz = clamp(value, 3, 0);
+	if(type == 21)
+		_m->encodeCmix = value;
+}
+
+byte ArchiveStream::getError()
+{
+	return _m->errorId;
+}
+
+String ArchiveStream::getErrorStr()
+{
+	return _m->errorStr;
+}
+
+}
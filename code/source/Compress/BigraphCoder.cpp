@@ -14,64 +14,57 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <Compress/BigraphCoder.h>
-#include <Common/Hash.h>
-#include <Common/Math.h>
-#include <Common/container/HashTable.h>
+#include <Common/StringLib.h>
 #include <Common/container/Array.h>
 
-#define HASH(s) (*(word*)s)
+// block size for own rules table
+#define BIGRAPH_BLOCK (1 << 20)
+// maximum rules in block
+#define BIGRAPH_RULES 1024
+// maximum block head: length 4, count 2, rules by 3 bytes
+#define BIGRAPH_HEAD (6 + BIGRAPH_RULES * 3)
+// maximum n-gram length, not great decoder dest reserve
+#define BIGRAPH_NGRAM 32
+// end of list
+#define BIGRAPH_NIL MAX_UINT32
 
 namespace tas
 {
 
-struct BigraphValue
-{
-	uint chsum; // checksum
-	uint count; // n-graph
-	half rep; // replace byte
-
-	BigraphValue()
-	{
-		chsum = 0;
-		count = 0;
-		rep = -1;
-	}
-
-	~BigraphValue()
-	{
-	}
-
-	void reset(uint checksum)
-	{
-		chsum = checksum;
-		count = 0;
-		rep = -1;
-	}
-
-	uint priority()
-	{
-		return count;
-	}
-
-	uint checksum()
-	{
-		return chsum;
-	}
-};
-
 struct BigraphCoder::impl
 {
-	Array<BigraphValue> ngraphTable;
-	HashTable<BigraphValue> hashTable;
-	BigraphValue* ngraphTableUn; // decode
-	BigraphValue* node;
-	byte ngraph; // count [2, 4]
-	byte* ngb; // n-graph block
-	byte ngbsz; // size
-	uint* frq; // frequency input symbols
-	byte nil;
+	// encode, symbols sequence linked over removed positions
+	uint* next;
+	uint* prev;
+	byte* state; // position 0 free, 1 in occurrence list, 2 removed
+	uint* occNext; // occurrence list of same pairs
+	uint* occPrev;
+	uint* pairHead; // pair -> first occurrence
+	uint* pairCount; // pair -> occurrences count
+	uint* heap; // max heap of pairs by count
+	uint* heapPos; // pair -> heap index + 1, 0 not in heap
+	uint heapSize;
+	uint symCount[256]; // symbol occurrences in sequence
+	byte symLen[256]; // symbol n-gram length
+	Array<uint> occ; // occurrences of replaced pair
+
+	// decode, symbol -> n-gram
+	byte ngramUn[256][BIGRAPH_NGRAM];
+	byte ngramLen[256];
+
+	byte ngraph; // maximum n-gram length
 	byte mode;  // process mode
-	uint tableSize;
+	byte format; // 0 single table, 1 blocks of pairs, 2 blocks of rules
+
+	byte* block; // head and block data
+	uint blockSize;
+	byte* emit; // encoded block output
+	uint emitSize;
+
+	byte* head; // block head, decode
+	uint headSize;
+	uint headNeed;
+	uint blockRemain;
 
 	byte* src;
 	byte* dst;
@@ -83,9 +76,20 @@ struct BigraphCoder::impl
 	wint dstTotal;
 	byte eof;
 
-	int initialise(byte mode);
+	int initialise(byte mode, byte format);
+	void encodeBlock();
+	/// rules of block head, 0 if damaged
+	byte decodeHead();
+
+	// priority queue
+	void heapUp(uint i);
+	void heapDown(uint i);
+	void heapUpdate(uint pair);
+
+	// occurrence lists
+	void link(uint i);
+	void unlink(uint i);
 
-	int parsing     (CoderStream* sm, byte flush);
 	int compress    (CoderStream* sm, byte flush);
 	int uncompress  (CoderStream* sm, byte flush);
 };
@@ -94,9 +98,8 @@ BigraphCoder::BigraphCoder()
 {
 	_m = new impl;
 	_m->mode = 0;
-	_m->nil = 0;
-	_m->node = 0;
 	_m->ngraph = 0;
+	_m->format = 0;
 	_m->srcTotal = 0;
 	_m->dstTotal = 0;
 	_m->dst = 0;
@@ -106,134 +109,303 @@ BigraphCoder::BigraphCoder()
 	_m->dstAvail = 0;
 	_m->src = 0;
 	_m->eof = 0;
-	_m->ngbsz = 0;
-	_m->tableSize = 0;
-	_m->ngraphTableUn = 0;
-	_m->frq = 0;
-	_m->ngb = new byte[4];
-	forn(4) _m->ngb[i] = 0;
+	_m->next = 0;
+	_m->prev = 0;
+	_m->state = 0;
+	_m->occNext = 0;
+	_m->occPrev = 0;
+	_m->pairHead = 0;
+	_m->pairCount = 0;
+	_m->heap = 0;
+	_m->heapPos = 0;
+	_m->heapSize = 0;
+	_m->block = 0;
+	_m->blockSize = 0;
+	_m->emit = 0;
+	_m->emitSize = 0;
+	_m->head = 0;
+	_m->headSize = 0;
+	_m->headNeed = 0;
+	_m->blockRemain = 0;
 }
 
 BigraphCoder::~BigraphCoder()
 {
-	safe_delete_array(_m->ngraphTableUn);
-	safe_delete_array(_m->ngb);
-	safe_delete_array(_m->frq);
+	safe_delete_array(_m->next);
+	safe_delete_array(_m->prev);
+	safe_delete_array(_m->state);
+	safe_delete_array(_m->occNext);
+	safe_delete_array(_m->occPrev);
+	safe_delete_array(_m->pairHead);
+	safe_delete_array(_m->pairCount);
+	safe_delete_array(_m->heap);
+	safe_delete_array(_m->heapPos);
+	safe_delete_array(_m->block);
+	safe_delete_array(_m->head);
 	safe_delete(_m);
 }
 
-int BigraphCoder::impl::initialise(byte _mode)
+wint BigraphCoder::memory(byte mode)
+{
+	if(mode == 1) // block links, pairs tables, block
+		return (wint) BIGRAPH_BLOCK * (sizeof(uint) * 4 + 2) + (1 << 16) * sizeof(uint) * 4 + BIGRAPH_HEAD;
+	return BIGRAPH_HEAD + sizeof(impl);
+}
+
+int BigraphCoder::impl::initialise(byte _mode, byte _format)
 {
 	mode = _mode;
-	ngraph = 2;
-	if(mode == 1) // parsing
+	format = _format;
+	ngraph = BIGRAPH_NGRAM;
+	if(mode == 1) // compress
+	{
+		if(format != 2)
+			return 0;
+		next = new uint[BIGRAPH_BLOCK];
+		prev = new uint[BIGRAPH_BLOCK];
+		state = new byte[BIGRAPH_BLOCK];
+		occNext = new uint[BIGRAPH_BLOCK];
+		occPrev = new uint[BIGRAPH_BLOCK];
+		pairHead = new uint[1 << 16];
+		pairCount = new uint[1 << 16];
+		heap = new uint[1 << 16];
+		heapPos = new uint[1 << 16];
+		block = new byte[BIGRAPH_HEAD + BIGRAPH_BLOCK];
+		occ.reserve(1024);
+	}
+	if(mode == 2) // uncompress
 	{
-		tableSize = 64 * KB;
-		hashTable.initialise(tableSize);
-		frq = new uint[256];
-		forn(256)
-		frq[i] = 0;
+		head = new byte[BIGRAPH_HEAD];
+		headNeed = format == 2 ? 6 : format == 1 ? 5 : 1;
 	}
 	eof = 0;
 	srcTotal = 0;
 	srcRead = 0;
 	dstWrite = 0;
 	dstTotal = 0;
-	ngbsz = 0;
-	if(mode == 3)
-		ngraphTableUn = new BigraphValue[256];
+	blockSize = 0;
+	emitSize = 0;
+	headSize = 0;
+	blockRemain = 0;
 	return 1;
 }
 
-bool compare_decrease(BigraphValue o1, BigraphValue o2)
+void BigraphCoder::impl::heapUp(uint i)
 {
-	return (o1.count < o2.count);
+	uint p = heap[i];
+	while(i > 0)
+	{
+		uint u = (i - 1) >> 1;
+		if(pairCount[heap[u]] >= pairCount[p])
+			break;
+		heap[i] = heap[u];
+		heapPos[heap[i]] = i + 1;
+		i = u;
+	}
+	heap[i] = p;
+	heapPos[p] = i + 1;
 }
 
-int BigraphCoder::impl::parsing(CoderStream* sm, byte flush)
+void BigraphCoder::impl::heapDown(uint i)
 {
-	if(eof)
-		return IS_EOF_ERROR;
-
-	if(sm->src == 0 or sm->srcAvail == 0)
-		return IS_STREAM_ERROR;
-
-	src = sm->src;
-	srcAvail = sm->srcAvail;
-
-	int ret = IS_OK;
-	byte run = 1;
-	uint hash = 0;
-
-	if(ngbsz == 0)
+	uint p = heap[i];
+	while(1)
 	{
-		frq[src[srcRead]]++;
-		ngb[ngbsz++] = ngb[srcRead++];
+		uint c = i * 2 + 1;
+		if(c >= heapSize)
+			break;
+		if(c + 1 < heapSize and pairCount[heap[c+1]] > pairCount[heap[c]])
+			c++;
+		if(pairCount[heap[c]] <= pairCount[p])
+			break;
+		heap[i] = heap[c];
+		heapPos[heap[i]] = i + 1;
+		i = c;
 	}
+	heap[i] = p;
+	heapPos[p] = i + 1;
+}
 
-	while(srcRead < srcAvail)
+void BigraphCoder::impl::heapUpdate(uint pair)
+{
+	uint i = heapPos[pair];
+	// pair is useful, n-gram not long
+	byte use = pairCount[pair] > 1 and symLen[pair >> 8] + symLen[pair & 0xFF] <= ngraph;
+	if(i == 0)
 	{
-		// accumulate single byte
-		frq[src[srcRead]]++;
-		ngb[ngbsz++] = src[srcRead++];
-
-		// end of file
-		if(flush and srcRead == srcAvail)
+		if(use)
 		{
-			eof = 1;
-			break;
+			heap[heapSize] = pair;
+			heapUp(heapSize++);
 		}
+		return;
+	}
+	i--;
+	if(use)
+	{
+		heapUp(i);
+		heapDown(heapPos[pair] - 1);
+		return;
+	}
+	// remove, last to free place
+	heapPos[pair] = 0;
+	uint last = heap[--heapSize];
+	if(i == heapSize)
+		return;
+	heap[i] = last;
+	heapPos[last] = i + 1;
+	heapUp(i);
+	heapDown(heapPos[last] - 1);
+}
 
-		// encoding
-		hash = HASH(ngb);
-		hashTable.get(hash, hash).count++;
+void BigraphCoder::impl::link(uint i)
+{
+	byte* b = block + BIGRAPH_HEAD;
+	uint j = next[i];
+	if(j == BIGRAPH_NIL)
+		return;
+	uint pair = b[i] << 8 | b[j];
+
+	// count not overlapped runs "aaa" once
+	uint h = prev[i];
+	if(b[i] == b[j] and h != BIGRAPH_NIL and state[h] == 1 and b[h] == b[i])
+		return;
+
+	occPrev[i] = BIGRAPH_NIL;
+	occNext[i] = pairHead[pair];
+	if(pairHead[pair] != BIGRAPH_NIL)
+		occPrev[pairHead[pair]] = i;
+	pairHead[pair] = i;
+	state[i] = 1;
+	pairCount[pair]++;
+	heapUpdate(pair);
+}
 
-		// shift low single byte
-		ngb[0] = ngb[1];
-		ngbsz--;
-	}
+void BigraphCoder::impl::unlink(uint i)
+{
+	if(state[i] != 1)
+		return;
+	byte* b = block + BIGRAPH_HEAD;
+	uint pair = b[i] << 8 | b[next[i]];
+	if(occPrev[i] != BIGRAPH_NIL)
+		occNext[occPrev[i]] = occNext[i];
+	else
+		pairHead[pair] = occNext[i];
+	if(occNext[i] != BIGRAPH_NIL)
+		occPrev[occNext[i]] = occPrev[i];
+	state[i] = 0;
+	pairCount[pair]--;
+	heapUpdate(pair);
+}
 
-	if(eof)
+void BigraphCoder::impl::encodeBlock()
+{
+	byte* b = block + BIGRAPH_HEAD;
+	uint n = blockSize;
+
+	// sequence of bytes, one symbol per byte
+	menset(pairHead, 0xFF, (1 << 16) * 4);
+	menset(pairCount, 0, (1 << 16) * 4);
+	menset(heapPos, 0, (1 << 16) * 4);
+	menset(state, 0, n);
+	menset(symCount, 0, 256 * 4);
+	heapSize = 0;
+	forn(256)
+	symLen[i] = 1;
+	forn(n)
 	{
-		nil = 0;
-		forn(256)
-		{
-			if(frq[i] == 0)
-				nil++;
-		}
-		if(nil < 3)
-		{
-			// _printf("not having nil bytes\n");
-			return IS_STREAM_ERROR;
-		}
+		next[i] = i + 1 < n ? i + 1 : BIGRAPH_NIL;
+		prev[i] = i > 0 ? i - 1 : BIGRAPH_NIL;
+		symCount[b[i]]++;
+	}
+	forn(n)
+	link(i);
+
+	/*
+		Re-Pair, replace most frequent pair of symbols by new symbol
+		while not used symbols exist, symbol may be reused when it
+		left sequence. Each replace saves one byte, rule costs 3 bytes.
+	*/
+	byte rules[BIGRAPH_RULES * 3];
+	uint nr = 0;
+	while(nr < BIGRAPH_RULES and heapSize and pairCount[heap[0]] > 3)
+	{
+		uint z = 0;
+		while(z < 256 and symCount[z])
+			z++;
+		if(z == 256)
+			break;
 
-		ngraphTable.reserve(128);
-		forn(tableSize)
+		uint pair = heap[0];
+		byte l = pair >> 8;
+		byte r = pair & 0xFF;
+
+		// detach occurrences
+		occ.clear();
+		for(uint i = pairHead[pair]; i != BIGRAPH_NIL; i = occNext[i])
 		{
-			if(hashTable[i].count > 1)
-				ngraphTable.push_back(hashTable[i]);
+			occ.push_back(i);
+			state[i] = 0;
 		}
-		// _printf("\n\nnil %u table %u\n\n", nil, ngraphTable.size());
-		ngraphTable.sort(compare_decrease);
+		pairHead[pair] = BIGRAPH_NIL;
+		pairCount[pair] = 0;
+		heapUpdate(pair);
+
+		symLen[z] = symLen[l] + symLen[r];
+		rules[nr*3+0] = l;
+		rules[nr*3+1] = r;
+		rules[nr*3+2] = z;
+		nr++;
 
-		// assign nil byte to ngraph
-		nil = 0;
-		forn(256)
+		forn(occ.size())
 		{
-			if(frq[i] == 0)
-			{
-				hash = ngraphTable[nil++].chsum;
-				hashTable.find(hash, hash).rep = i;
-				if(nil == ngraphTable.size()) break;
-			}
+			uint p = occ[i];
+			uint j = next[p];
+			if(state[p] == 2 or b[p] != l or j == BIGRAPH_NIL or b[j] != r)
+				continue;
+
+			// neighbour pairs change
+			uint h = prev[p];
+			uint k = next[j];
+			if(h != BIGRAPH_NIL)
+				unlink(h);
+			unlink(j);
+
+			b[p] = z;
+			state[j] = 2;
+			next[p] = k;
+			if(k != BIGRAPH_NIL)
+				prev[k] = p;
+			symCount[l]--;
+			symCount[r]--;
+			symCount[z]++;
+
+			if(h != BIGRAPH_NIL)
+				link(h);
+			link(p);
 		}
 	}
 
-	srcTotal += srcRead;
-	sm->srcTotal = srcTotal; // total size
-	srcRead = 0;
-
-	return ret;
+	// collect sequence in place
+	uint w = 0;
+	for(uint i = 0; i != BIGRAPH_NIL and n; i = next[i])
+		b[w++] = b[i];
+
+	/*
+		block head before data
+		1. source block length, 4 bytes
+		2. rules count, 2 bytes
+		3. rules <left, right, symbol>
+	*/
+	byte* hp = b - 6 - nr * 3;
+	emit = hp;
+	forn(4)
+	*hp++ = n >> 8 * i;
+	*hp++ = nr;
+	*hp++ = nr >> 8;
+	mencpy(hp, rules, nr * 3);
+	emitSize = b + w - emit;
+	blockSize = 0;
 }
 
 int BigraphCoder::impl::compress(CoderStream* sm, byte flush)
@@ -251,86 +423,50 @@ int BigraphCoder::impl::compress(CoderStream* sm, byte flush)
 	dstWrite = 0;
 
 	int ret = IS_OK;
-	uint hash = 0;
-
-	if(dstTotal == 0)
-	{
-		/*
-			table to destination
-			1. count, 1 byte
-			2. pairs <ngraph, rep>
-		*/
-		dst[dstWrite++] = nil;
-		forn(nil)
-		{
-			hash = ngraphTable[i].chsum;
-			half rep = hashTable.find(hash, hash).rep;
-			assert(rep != MAX_UINT16);
-			byte* hp = (byte*)&hash;
-			form(u, ngraph)
-			dst[dstWrite++] = hp[u];
-			dst[dstWrite++] = rep;
-		}
-	}
 
-	while(srcRead < srcAvail)
+	while(1)
 	{
-		// accumulate n bytes
-		half ln = ngraph - ngbsz;
-		form(u, ln)
+		// out encoded block
+		if(emitSize)
 		{
-			if(srcRead == srcAvail)
+			uint n = MIN(emitSize, dstAvail - dstWrite);
+			mencpy(dst + dstWrite, emit, n);
+			dstWrite += n;
+			emit += n;
+			emitSize -= n;
+
+			// dest size small
+			if(emitSize)
+			{
+				ret = IS_STREAM_END;
 				break;
-			ngb[ngbsz++] = src[srcRead++];
-		}
-
-		// not get full bytes
-		if(ngbsz != ngraph and !flush)
-			break;
-
-		// end of file
-		if(flush and srcRead == srcAvail)
-		{
-			eof = 1;
-			forn(ngbsz)
-			dst[dstWrite++] = ngb[i];
-			break;
+			}
 		}
 
-		// encoding
-		hash = HASH(ngb);
-		node = &hashTable.find(hash, hash);
-
-		bool found = 1;
-		if(hashTable.index == MAX_UINT32 or node->rep == MAX_UINT16)
-			found = 0;
-
-		// not found
-		if(!found)
-		{
-			// out byte
-			assert(dstWrite < dstAvail);
-			dst[dstWrite++] = ngb[0];
-			forn(ngraph-1)
-			ngb[i] = ngb[i+1];
-			ngbsz--;
-		}
-		else
+		// accumulate block
+		if(srcRead < srcAvail)
 		{
-			// out single byte associated with n-graph
-			assert(dstWrite < dstAvail);
-			dst[dstWrite++] = node->rep;
-			ngbsz = 0;
+			uint n = MIN(srcAvail - srcRead, BIGRAPH_BLOCK - blockSize);
+			mencpy(block + BIGRAPH_HEAD + blockSize, src + srcRead, n);
+			srcRead += n;
+			blockSize += n;
+			if(blockSize == BIGRAPH_BLOCK)
+				encodeBlock();
+			continue;
 		}
 
-		// dest size small
-		if(dstAvail - dstWrite < 40)
+		// end of file
+		if(flush and blockSize)
 		{
-			ret = IS_STREAM_END;
-			break;
+			encodeBlock();
+			continue;
 		}
+		break;
 	}
 
+	if(flush and ret != IS_STREAM_END)
+		eof = 1;
+
 	dstTotal += dstWrite;
 	if(ret != IS_STREAM_END)
 	{
@@ -345,6 +481,47 @@ int BigraphCoder::impl::compress(CoderStream* sm, byte flush)
 	return ret;
 }
 
+byte BigraphCoder::impl::decodeHead()
+{
+	byte* hp = head;
+	uint nr = 0;
+	blockRemain = -1;
+	if(format)
+	{
+		blockRemain = 0;
+		forn(4)
+		blockRemain |= (uint)*hp++ << 8 * i;
+	}
+	nr = *hp++;
+	if(format == 2)
+		nr |= *hp++ << 8;
+	forn(256)
+	{
+		ngramUn[i][0] = i;
+		ngramLen[i] = 1;
+	}
+
+	// rules in order, symbol expands to n-grams of previous rules
+	byte ngram[BIGRAPH_NGRAM * 2];
+	forn(nr)
+	{
+		byte l = hp[0];
+		byte r = hp[1];
+		byte z = hp[2];
+		hp += 3;
+		// encoder rules not above n-gram length
+		if(ngramLen[l] + ngramLen[r] > BIGRAPH_NGRAM)
+			return 0;
+		mencpy(ngram, ngramUn[l], ngramLen[l]);
+		mencpy(ngram + ngramLen[l], ngramUn[r], ngramLen[r]);
+		ngramLen[z] = ngramLen[l] + ngramLen[r];
+		mencpy(ngramUn[z], ngram, ngramLen[z]);
+	}
+	headNeed = 0;
+	headSize = 0;
+	return 1;
+}
+
 int BigraphCoder::impl::uncompress(CoderStream* sm, byte flush)
 {
 	if(eof)
@@ -360,67 +537,51 @@ int BigraphCoder::impl::uncompress(CoderStream* sm, byte flush)
 	dstWrite = 0;
 
 	int ret = IS_OK;
-	uint hash = 0;
 	byte c = 0;
 
-	if(dstTotal == 0)
+	while(srcRead < srcAvail)
 	{
-		/*
-			read table
-			1. count, 1 byte
-			2. pairs <graph, rep>
-		*/
-		nil = src[srcRead++];
-		forn(nil)
+		// read block head, may be split between source blocks
+		if(headNeed)
 		{
-			form(u, ngraph)
-			ngb[u] = src[srcRead++];
-			byte rep = src[srcRead++];
-			hash = HASH(ngb);
-			node = &ngraphTableUn[rep];
-			node->rep = rep;
-			node->chsum = hash;
+			c = src[srcRead++];
+			head[headSize++] = c;
+			if(headSize == 1 and format == 0)
+				headNeed += c * 3;
+			if(headSize == 5 and format == 1)
+				headNeed += c * 3;
+			if(headSize == 6 and format == 2)
+				headNeed += (head[4] | c << 8) * 3;
+			if(headSize == headNeed and !decodeHead())
+				return IS_STREAM_ERROR;
+			continue;
 		}
-	}
 
-	while(srcRead < srcAvail)
-	{
 		c = src[srcRead++];
 
-		// c -> ngraph
-		node = &ngraphTableUn[c];
+		// c -> n-gram
+		byte len = ngramLen[c];
+		assert(dstWrite + len <= dstAvail);
+		mencpy(dst + dstWrite, ngramUn[c], len);
+		dstWrite += len;
+		blockRemain -= len;
 
-		// output found ngraph
-		if(node->rep == c)
-		{
-			byte* hp = (byte*)&node->chsum;
-			forn(ngraph)
-			{
-				assert(dstWrite < dstAvail);
-				dst[dstWrite++] = hp[i];
-			}
-		}
-		else
-		{
-			assert(dstWrite < dstAvail);
-			dst[dstWrite++] = c;
-		}
-
-		// end of file
-		if(flush and srcRead == srcAvail)
-		{
-			eof = 1;
-			break;
-		}
+		// next block head
+		if(format and blockRemain == 0)
+			headNeed = format == 2 ? 6 : 5;
 
 		// dest size small
-		if(dstAvail - dstWrite < 40)
+		if(dstAvail - dstWrite < 40 and srcRead < srcAvail)
 		{
 			ret = IS_STREAM_END;
 			break;
 		}
 	}
 
+	// end of file
+	if(flush and ret != IS_STREAM_END)
+		eof = 1;
+
 	dstTotal += dstWrite;
 	if(ret != IS_STREAM_END)
 	{
@@ -435,14 +596,9 @@ int BigraphCoder::impl::uncompress(CoderStream* sm, byte flush)
 	return ret;
 }
 
-int BigraphCoder::initialise(byte mode)
-{
-	return _m->initialise(mode);
-}
-
-int BigraphCoder::parsing(CoderStream* sm, byte flush)
+int BigraphCoder::initialise(byte mode, byte format)
 {
-	return _m->parsing(sm, flush);
+	return _m->initialise(mode, format);
 }
 
 int BigraphCoder::compress(CoderStream* sm, byte flush)
@@ -37,6 +37,13 @@ void BinaryCoder::initialise(byte inRange)
 	range = inRange;
 }
 
+void BinaryCoder::reset()
+{
+	high = 0xFFFFFFFF;
+	low = 0;
+	mid = 0;
+}
+
 void BinaryCoder::encodeBit(uint freq0, byte bit)
 {
 	assert(high > low);
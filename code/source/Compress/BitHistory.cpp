@@ -0,0 +1,147 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/BitHistory.h>
+
+#if TAA_COMPILER == TAA_COMPILER_MSVC
+#include <Common/platform/swindows.h>
+#define state_cas(o, c, n) InterlockedCompareExchange((volatile long*)&(o), n, c)
+#else
+#define state_cas(o, c, n) __sync_val_compare_and_swap(&(o), c, n)
+#endif
+
+// maximum count in state
+#define STATE_COUNT_MAX 30
+
+namespace tas
+{
+
+byte StateTable::table[256][4];
+byte StateTable::states = 0;
+short StateTable::stretchTable[4096];
+
+// tables build: 0 not started, 1 building, 2 ready
+static int tableState = 0;
+
+// interpolation points of 4096 / (1 + exp(-d / 256)), integer only,
+// results are same on all platforms
+const short StateTable::squashTable[33] =
+{
+	1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101,
+	1546, 2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022,
+	4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094
+};
+
+static byte stateFind(byte n0, byte n1)
+{
+	byte (*t)[4] = StateTable::table;
+	forn(StateTable::states)
+	{
+		if(t[i][2] == n0 and t[i][3] == n1)
+			return i;
+	}
+	byte s = StateTable::states++;
+	t[s][0] = 0;
+	t[s][1] = 0;
+	t[s][2] = n0;
+	t[s][3] = n1;
+	return s;
+}
+
+void StateTable::initialise()
+{
+	// first caller builds tables, other threads wait for end
+	int ts = state_cas(tableState, 0, 1);
+	if(ts == 2)
+		return;
+	if(ts == 1)
+	{
+		while(state_cas(tableState, 2, 2) != 2);
+		return;
+	}
+
+	// state 0 is empty history
+	stateFind(0, 0);
+
+	// breadth first walk over reachable pairs,
+	// order of states is same for encoder and decoder
+	for(uint s = 0; s < states; s++)
+	{
+		form(y, 2)
+		{
+			byte n[2] = {table[s][2], table[s][3]};
+			if(n[y] < STATE_COUNT_MAX)
+				n[y]++;
+			byte r = 1 - y;
+			if(n[r] > 2)
+				n[r] = n[r] / 2 + 1;
+			table[s][y] = stateFind(n[0], n[1]);
+		}
+	}
+	assert(states <= 255);
+
+	// stretch is inverse of squash
+	int pi = 0;
+	for(int x = -2047; x <= 2047; x++)
+	{
+		int v = squash(x) >> 4;
+		for(int j = pi; j <= v; j++)
+			stretchTable[j] = x;
+		pi = v + 1;
+	}
+	for(int j = pi; j < 4096; j++)
+		stretchTable[j] = 2047;
+
+	state_cas(tableState, 1, 2);
+}
+
+StateMap::StateMap()
+{
+	table = 0;
+	maps = 0;
+	forn(256)
+	reciprocal[i] = 131072 / (i * 2 + 3);
+}
+
+StateMap::~StateMap()
+{
+	safe_delete_array(table);
+}
+
+void StateMap::initialise(uint n)
+{
+	StateTable::initialise();
+	safe_delete_array(table);
+	table = new uint[n << 8];
+	maps = n;
+	reset();
+}
+
+void StateMap::reset()
+{
+	form(m, maps)
+	{
+		forn(256)
+		{
+			// initial probability from counts (n1 + 0.5) / (n + 1)
+			uint n0 = StateTable::count(i, 0);
+			uint n1 = StateTable::count(i, 1);
+			uint p = ((n1 * 2 + 1) << 22) / (n0 * 2 + n1 * 2 + 2);
+			table[m << 8 | i] = p << 10;
+		}
+	}
+}
+
+}
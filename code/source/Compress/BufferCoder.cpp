@@ -0,0 +1,331 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/BufferCoder.h>
+#include <Compress/ICoder.h>
+#include <Compress/CoderFactory.h>
+#include <Common/Bitwise.h>
+#include <Common/Math.h>
+#include <Common/StringLib.h>
+#include <Common/container/Array.h>
+#include <Common/container/SmartPtr.h>
+
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+#include <Compress/LzreCoder.h>
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+#include <Compress/CmCoder.h>
+#endif
+#endif
+
+#define BUFFER_HEAD 16
+#define BUFFER_BLOCK (1 << 16)
+
+namespace tas
+{
+
+#pragma pack(push, 1)
+/// compressed buffer header, parameters of coder after initialisation
+struct BufferHeader
+{
+	byte method;     // 0 copy, 1 lzre, 2 cm
+	byte options;    // bit 0 cmix, bit 1 history
+	byte level;
+	byte dictionary; // 2^n
+	byte minMatch;
+	byte reserved0;
+	half maxMatch;   // lzre maximum match, cm context
+	half rolz;
+	half reserved1;
+	uint size;       // data size
+};
+#pragma pack(pop)
+
+struct BufferCoder::impl
+{
+	BufferHeader encodeHead;
+	BufferHeader decodeHead;
+	SmartPtr<ICoder> encoder;
+	SmartPtr<ICoder> decoder;
+	byte encoderUsed; // reset before next buffer
+	Array<byte> block;
+
+	impl()
+	{
+		menset(&encodeHead, 0, sizeof(encodeHead));
+		menset(&decodeHead, 0, sizeof(decodeHead));
+		encoderUsed = 0;
+	}
+
+	/** Coder of buffers, parameters of header updated by coder.
+	  * @param mode 1 compress, 2 uncompress.
+	  */
+	ICoder* createCoder(byte mode, BufferHeader& head);
+
+	/// coder state of new buffer
+	void resetCoder(ICoder* coder, byte method, uint size);
+
+	/// same parameters of headers, without data size
+	static byte sameParameters(BufferHeader& a, BufferHeader& b);
+
+	/// header of compressed buffer, 0 if not recognized
+	static byte readHeader(byte* src, uint size, BufferHeader& head);
+};
+
+ICoder* BufferCoder::impl::createCoder(byte mode, BufferHeader& head)
+{
+	CoderParameters params;
+	params.method = head.method;
+	params.mode = mode;
+	params.dictionary = head.dictionary ? 1 << head.dictionary : 0;
+	params.minMatch = head.minMatch;
+	params.maxMatch = head.maxMatch;
+	params.level = head.level;
+	params.rolz = head.rolz;
+	params.threads = 1;
+	params.cmix = head.options & 1;
+	params.history = head.options >> 1 & 1;
+
+	// data size in header, not in cm data
+	if(mode == 2 and head.method == 2)
+		params.size = head.size;
+
+	ICoder* coder = tas::createCoder(&params);
+	if(!coder)
+		return 0;
+
+	head.dictionary = bitGreat(params.dictionary - 1);
+	head.minMatch = params.minMatch;
+	head.maxMatch = params.maxMatch;
+	head.rolz = params.rolz;
+	return coder;
+}
+
+void BufferCoder::impl::resetCoder(ICoder* coder, byte method, uint size)
+{
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+	if(method == 1)
+		static_cast<LzreCoder*>(coder)->reset();
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+	else if(method == 2)
+		static_cast<CmCoder*>(coder)->reset(size);
+#endif
+#endif
+}
+
+byte BufferCoder::impl::sameParameters(BufferHeader& a, BufferHeader& b)
+{
+	byte* pa = (byte*) &a;
+	byte* pb = (byte*) &b;
+	forn(BUFFER_HEAD - 4)
+	{
+		if(pa[i] != pb[i])
+			return 0;
+	}
+	return 1;
+}
+
+byte BufferCoder::impl::readHeader(byte* src, uint size, BufferHeader& head)
+{
+	if(size < BUFFER_HEAD)
+		return 0;
+	mencpy(&head, src, BUFFER_HEAD);
+	if(head.method > 2 or head.dictionary > 28 or head.level > 9)
+		return 0;
+	if(!head.method and size - BUFFER_HEAD != head.size)
+		return 0;
+	return 1;
+}
+
+BufferCoder::BufferCoder()
+{
+	_m = new impl;
+}
+
+BufferCoder::~BufferCoder()
+{
+	safe_delete(_m);
+}
+
+uint BufferCoder::compressBound(uint size)
+{
+	return size + BUFFER_HEAD;
+}
+
+uint BufferCoder::compress(byte* src, uint size, byte* dst, uint dstSize, BufferParameters* params)
+{
+	BufferCoder coder;
+	coder.initialise(params);
+	return coder.compressBuffer(src, size, dst, dstSize);
+}
+
+uint BufferCoder::uncompress(byte* src, uint size, byte* dst, uint dstSize)
+{
+	BufferCoder coder;
+	return coder.uncompressBuffer(src, size, dst, dstSize);
+}
+
+uint BufferCoder::dataSize(byte* src, uint size)
+{
+	BufferHeader head;
+	if(!impl::readHeader(src, size, head))
+		return MAX_UINT32;
+	return head.size;
+}
+
+void BufferCoder::initialise(BufferParameters* params)
+{
+	BufferHeader& head = _m->encodeHead;
+	menset(&head, 0, sizeof(head));
+	head.method = params->method;
+	head.level = clamp(params->level ? params->level : 5, 9, 1);
+	head.dictionary = params->dictionary ? bitGreat(params->dictionary - 1) : 0;
+	head.minMatch = params->minMatch;
+	head.maxMatch = params->maxMatch;
+	head.rolz = params->rolz;
+	head.options = params->cmix ? 1 : 0;
+	head.options |= CODER_HISTORY << 1;
+
+	_m->encoder.reset();
+	_m->encoderUsed = 0;
+	if(head.method)
+	{
+		ICoder* encoder = _m->createCoder(1, head);
+		// method not supported, data copied
+		if(encoder)
+			_m->encoder.set(encoder);
+		else
+			head.method = 0;
+	}
+
+	params->method = head.method;
+	params->level = head.level;
+	params->dictionary = head.method ? 1 << head.dictionary : 0;
+	params->minMatch = head.minMatch;
+	params->maxMatch = head.maxMatch;
+	params->rolz = head.rolz;
+}
+
+uint BufferCoder::compressBuffer(byte* src, uint size, byte* dst, uint dstSize)
+{
+	if(dstSize < BUFFER_HEAD)
+		return 0;
+
+	BufferHeader head = _m->encodeHead;
+	head.size = size;
+	byte* packed = dst + BUFFER_HEAD;
+	uint packedSize = 0;
+	uint packedMax = MIN(dstSize - BUFFER_HEAD, size);
+
+	if(head.method and size)
+	{
+		ICoder* encoder = _m->encoder.ptr();
+		if(_m->encoderUsed)
+			_m->resetCoder(encoder, head.method, 0);
+		_m->encoderUsed = 1;
+		_m->block.resize(BUFFER_BLOCK);
+
+		CoderStream sm;
+		sm.src = src;
+		sm.srcAvail = size;
+		sm.dst = _m->block.begin();
+
+		int ret = IS_STREAM_END;
+		while(ret == IS_STREAM_END)
+		{
+			sm.dstAvail = BUFFER_BLOCK;
+			ret = encoder->compress(&sm, 1);
+
+			// stored data is less
+			if(ret < 0 or packedSize + sm.dstAvail >= packedMax)
+			{
+				packedSize = 0;
+				break;
+			}
+			mencpy(packed + packedSize, sm.dst, sm.dstAvail);
+			packedSize += sm.dstAvail;
+		}
+	}
+
+	if(!packedSize)
+	{
+		if(size > dstSize - BUFFER_HEAD)
+			return 0;
+		head.method = 0;
+		mencpy(packed, src, size);
+		packedSize = size;
+	}
+
+	mencpy(dst, &head, BUFFER_HEAD);
+	return BUFFER_HEAD + packedSize;
+}
+
+uint BufferCoder::uncompressBuffer(byte* src, uint size, byte* dst, uint dstSize)
+{
+	BufferHeader head;
+	if(!impl::readHeader(src, size, head) or head.size > dstSize)
+		return MAX_UINT32;
+
+	if(!head.method)
+	{
+		mencpy(dst, src + BUFFER_HEAD, head.size);
+		return head.size;
+	}
+
+	// coder of previous buffer with same parameters
+	if(_m->decoder.ptr() and impl::sameParameters(head, _m->decodeHead))
+		_m->resetCoder(_m->decoder.ptr(), head.method, head.size);
+	else
+	{
+		BufferHeader params = head;
+		ICoder* coder = _m->createCoder(2, params);
+		if(!coder)
+			return MAX_UINT32;
+		_m->decoder.set(coder);
+		_m->decodeHead = head;
+	}
+	ICoder* decoder = _m->decoder.ptr();
+	_m->block.resize(BUFFER_BLOCK);
+
+	CoderStream sm;
+	sm.src = src + BUFFER_HEAD;
+	sm.srcAvail = size - BUFFER_HEAD;
+	sm.dst = _m->block.begin();
+	uint decoded = 0;
+
+	int ret = IS_STREAM_END;
+	while(ret == IS_STREAM_END)
+	{
+		sm.dstAvail = BUFFER_BLOCK;
+		ret = decoder->uncompress(&sm, 1);
+		if(ret < 0 or decoded + sm.dstAvail > head.size)
+			return MAX_UINT32;
+		mencpy(dst + decoded, sm.dst, sm.dstAvail);
+		decoded += sm.dstAvail;
+	}
+	return decoded == head.size ? decoded : MAX_UINT32;
+}
+
+BufferParameters::BufferParameters()
+{
+	method = 0;
+	level = 0;
+	dictionary = 0;
+	minMatch = 0;
+	maxMatch = 0;
+	rolz = 0;
+	cmix = 0;
+}
+
+}
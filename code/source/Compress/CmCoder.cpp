@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include <Compress/CmCoder.h>
 #include <Compress/BinaryCoder.h>
+#include <Compress/BitHistory.h>
 #include <Common/Math.h>
 #include <Common/container/HashTable.h>
 #include <Common/container/RingBuffer.h>
@@ -36,10 +37,6 @@ struct CmCounter
 		n[1] = 0;
 	}
 
-	~CmCounter()
-	{
-	}
-
 	void reset(byte _ch = 0)
 	{
 		ch = _ch;
@@ -71,6 +68,9 @@ struct CmCounter
 struct CmCoder::impl: public IStream
 {
 	HashTable<CmCounter> hashTable;
+	HashTable<StateCounter> stateTable;
+	StateMap stateMap;
+	byte history; // bit history states
 
 	BinaryCoder rangeCoder;
 	uint range;
@@ -79,6 +79,7 @@ struct CmCoder::impl: public IStream
 	uint* hash; // context [0, 7]
 
 	CmCounter* counter;
+	StateCounter** states;
 	uint* hashes;
 	uint* weight;
 	byte contextLen;
@@ -93,10 +94,12 @@ struct CmCoder::impl: public IStream
 	wint dstTotal;
 	wint encsz;
 	byte* rest;
+	byte decoderInit;
 
 	int initialise(CmParameters* params);
+	void reset(wint size);
 
-	void predict(uint& n0, uint& n1, byte c0);
+	uint predict(byte c0);
 	void update(byte y);
 
 	int compress(CoderStream* sm, byte flush);
@@ -110,6 +113,8 @@ CmCoder::CmCoder()
 {
 	_m = new impl;
 	_m->counter = 0;
+	_m->states = 0;
+	_m->history = 0;
 	_m->srcTotal = 0;
 	_m->dstTotal = 0;
 	_m->dst = 0;
@@ -120,6 +125,7 @@ CmCoder::CmCoder()
 	_m->rest = 0;
 	_m->range = 0;
 	_m->encsz = 0;
+	_m->decoderInit = 0;
 	_m->hash = 0;
 	_m->hashes = 0;
 	_m->weight = 0;
@@ -130,6 +136,7 @@ CmCoder::~CmCoder()
 	safe_delete_array(_m->hash);
 	safe_delete_array(_m->hashes);
 	safe_delete_array(_m->weight);
+	safe_delete_array(_m->states);
 	safe_delete_array(_m->rest);
 	safe_delete(_m);
 }
@@ -139,6 +146,25 @@ int CmCoder::initialise(CmParameters* params)
 	return _m->initialise(params);
 }
 
+void CmCoder::reset(wint size)
+{
+	_m->reset(size);
+}
+
+wint CmCoder::memory(CmParameters* params)
+{
+	byte level = clamp(params->level, 9, 1);
+	wint dictSize = params->dictionary;
+	byte contextLen = params->context ? clamp(params->context, 8, 4) : clamp(level + 3, 8, 4);
+	if(!dictSize)
+		dictSize = 1 << 16 << level - 1;
+	else
+		dictSize = clamp(dictSize, 1 << 24, 1 << 16);
+	if(params->history) // states table, states maps
+		return dictSize * sizeof(StateCounter) + contextLen * 256 * sizeof(uint);
+	return dictSize * sizeof(CmCounter);
+}
+
 int CmCoder::compress(CoderStream* sm, byte flush)
 {
 	return _m->compress(sm, flush);
@@ -168,7 +194,15 @@ int CmCoder::impl::initialise(CmParameters* params)
 	range = 1 << rangeBit;
 	rangeCoder.initialise(rangeBit);
 	rangeCoder.stream = this;
-	hashTable.initialise(dictSize);
+	history = params->history;
+	if(history)
+	{
+		stateTable.initialise(dictSize);
+		stateMap.initialise(contextLen);
+		states = new StateCounter*[contextLen];
+	}
+	else
+		hashTable.initialise(dictSize);
 	hash = new uint[contextLen];
 	hashes = new uint[contextLen];
 	weight = new uint[contextLen];
@@ -178,11 +212,44 @@ int CmCoder::impl::initialise(CmParameters* params)
 		hashes[i] = 0;
 		weight[i] = (i+1)*(i+1);
 	}
+	encsz = params->size;
 	params->dictionary = dictSize;
 	params->context = contextLen;
 	return 1;
 }
 
+void CmCoder::impl::reset(wint size)
+{
+	if(history)
+	{
+		stateTable.clear();
+		stateMap.reset();
+	}
+	else
+		hashTable.clear();
+	context.reset();
+	menset(context.buf, 0, context.bsz);
+	context.cnt = contextLen - 1;
+	forn(contextLen)
+	{
+		hash[i] = 0;
+		hashes[i] = 0;
+	}
+	rangeCoder.reset();
+	srcRead = 0;
+	srcAvail = 0;
+	dstWrite = 0;
+	srcTotal = 0;
+	dstTotal = 0;
+	encsz = size;
+	decoderInit = 0;
+	if(rest)
+	{
+		rest[0] = 0;
+		rest[1] = 0;
+	}
+}
+
 byte CmCoder::impl::inputByte()
 {
 	byte c = 0;
@@ -199,8 +266,33 @@ void CmCoder::impl::outputByte(byte b)
 	dst[dstWrite++] = b;
 }
 
-void CmCoder::impl::predict(uint& n0, uint& n1, byte c0)
+uint CmCoder::impl::predict(byte c0)
 {
+	uint f0 = 0;
+	if(history)
+	{
+		// mix states in logistic domain,
+		// weight by order and history length
+		int sw = 0;
+		int sp = 0;
+		forn(contextLen)
+		{
+			uint hashKey = HASH(hash[i], c0);
+			StateCounter* sc = &stateTable.get(hashKey, hashKey >> 24);
+			int w = weight[i] * sc->priority();
+			sw += w;
+			sp += w * StateTable::stretch(stateMap.p(i, sc->state));
+			states[i] = sc;
+		}
+		if(sw)
+			sp /= sw;
+		// squash result in [16, 65504], never reach range bounds
+		f0 = range - StateTable::squash(sp);
+		return f0;
+	}
+
+	uint n0 = 1;
+	uint n1 = 1;
 	uint h0 = 0;
 	uint h1 = 0;
 	uint w = 0;
@@ -228,10 +320,23 @@ void CmCoder::impl::predict(uint& n0, uint& n1, byte c0)
 		// update hash
 		hashes[i] = hashKey;
 	}
+	f0 = range * n0 / (n0+n1);
+	return f0;
 }
 
 void CmCoder::impl::update(byte y)
 {
+	if(history)
+	{
+		// update maps before states
+		forn(contextLen)
+		{
+			stateMap.update(i, states[i]->state, y);
+			states[i]->update(y);
+		}
+		return;
+	}
+
 	// update contexts counters in hash table
 	forn(contextLen)
 	hashTable.get(hashes[i], hashes[i] >> 24).update(y);
@@ -254,8 +359,6 @@ int CmCoder::impl::compress(CoderStream* sm, byte flush)
 	byte y = 0;    // bit
 	byte c0 = 1;   // context
 	byte c1 = 128; // mask
-	uint n0 = 1;   // count 0
-	uint n1 = 1;   // count 1
 	uint f0 = 0;
 
 	while(srcRead < srcAvail)
@@ -270,14 +373,10 @@ int CmCoder::impl::compress(CoderStream* sm, byte flush)
 		{
 			y = (c & c1) != 0;
 
-			n0 = 1;
-			n1 = 1;
-
 			// prediction bits probability
-			predict(n0, n1, c0);
+			f0 = predict(c0);
 
 			// encode bit in range coder
-			f0 = range * n0 / (n0+n1);
 			rangeCoder.encodeBit(f0, y);
 
 			// update context, shift mask to low
@@ -337,16 +436,16 @@ int CmCoder::impl::uncompress(CoderStream* sm, byte flush)
 	byte y = 0;    // bit
 	byte c0 = 1;   // context
 	byte c1 = 128; // mask
-	uint n0 = 1;   // count 0
-	uint n1 = 1;   // count 1
 	uint f0 = 0;
 
 	/* cm decoder need source file size */
-	if(encsz == 0)
+	if(!decoderInit)
 	{
 		/* little endian */
-		forn(8) encsz |= (wint)inputByte() << 8 * i;
+		if(encsz == 0)
+			forn(8) encsz |= (wint)inputByte() << 8 * i;
 		rangeCoder.initialiseDecoder();
+		decoderInit = 1;
 	}
 
 	while(1)
@@ -357,14 +456,10 @@ int CmCoder::impl::uncompress(CoderStream* sm, byte flush)
 		// each bit from MSB
 		forn(8)
 		{
-			n0 = 1;
-			n1 = 1;
-
 			// prediction bits probability
-			predict(n0, n1, c0);
+			f0 = predict(c0);
 
 			// decode bit from range coder
-			f0 = range * n0 / (n0+n1);
 			y = rangeCoder.decodeBit(f0);
 
 			// update context, shift mask to low
@@ -390,7 +485,7 @@ int CmCoder::impl::uncompress(CoderStream* sm, byte flush)
 		if(srcAvail - srcRead < 40 && !flush)
 		{
 			if(rest == 0)
-				rest = new byte[40];
+				rest = new byte[42];
 			rest[0] = 0;
 			rest[1] = srcAvail - srcRead;
 			forn(rest[1])
@@ -426,6 +521,8 @@ CmParameters::CmParameters()
 	dictionary = 0;
 	context = 0;
 	level = 0;
+	history = 0;
+	size = 0;
 }
 
 }
\ No newline at end of file
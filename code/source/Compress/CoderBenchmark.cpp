@@ -0,0 +1,377 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/CoderBenchmark.h>
+#include <Compress/ICoder.h>
+#include <Compress/BigraphCoder.h>
+#include <Compress/CoderFactory.h>
+#include <Common/FileStream.h>
+#include <Common/Timer.h>
+#include <Common/Math.h>
+#include <Common/StringLib.h>
+#include <Common/container/Array.h>
+#include <Common/container/SmartPtr.h>
+
+#define BENCH_BLOCK (1 << 16)
+#define BENCH_DATA_MAX (1 << 28)
+
+namespace tas
+{
+
+struct CoderBenchmark::impl
+{
+	byte errorId;
+	String errorStr;
+
+	uint encodeMethod;
+	uint encodeLevel;
+	uint encodeThreads;
+	uint dictSize;
+	uint encodeCmix;
+	uint encodeBigraph;
+
+	Array<byte> data;
+	Array<byte> packed;
+	Array<byte> unpacked;
+	Array<byte> block;
+	Array<uint> runs; // method << 16 | level << 8 | threads
+	CoderParameters coderParams; // of encoder after initialisation
+
+	impl()
+	{
+		errorId = 0;
+		encodeMethod = 0;
+		encodeLevel = 0;
+		encodeThreads = 0;
+		dictSize = 0;
+		encodeCmix = 0;
+		encodeBigraph = 0;
+	}
+
+	void error(byte id, const char* str)
+	{
+		errorId = id;
+		errorStr = str;
+	}
+
+	/** Coder of run, parameters of result updated by coder.
+	  * @param mode 1 compress, 2 uncompress.
+	  */
+	ICoder* createCoder(byte mode, BenchmarkResult& result);
+
+	/** Code source to destination array by blocks.
+	  * @return Destination size, MAX_UINT32 if coder fail or destination small.
+	  */
+	uint code(ICoder* coder, byte mode, byte* src, uint size, Array<byte>& dst);
+};
+
+ICoder* CoderBenchmark::impl::createCoder(byte mode, BenchmarkResult& result)
+{
+	if(result.method == 3)
+	{
+		BigraphCoder* bigraph = new BigraphCoder;
+		bigraph->initialise(mode);
+		if(mode == 1)
+			result.memory = BigraphCoder::memory(1);
+		return bigraph;
+	}
+
+	// decoder by parameters of encoder
+	CoderParameters params;
+	if(mode == 2)
+	{
+		params = coderParams;
+		params.mode = mode;
+		// cm data size not in stream
+		if(result.method == 2)
+			params.size = result.size;
+		return tas::createCoder(&params);
+	}
+
+	params.method = result.method;
+	params.mode = mode;
+	params.dictionary = dictSize;
+	params.level = result.level;
+	params.threads = result.threads;
+	params.cmix = encodeCmix;
+	result.memory = coderMemory(&params);
+
+	ICoder* coder = tas::createCoder(&params);
+	coderParams = params;
+	if(result.method == 1)
+		result.threads = params.threads;
+	return coder;
+}
+
+uint CoderBenchmark::impl::code(ICoder* coder, byte mode, byte* src, uint size, Array<byte>& dst)
+{
+	CoderStream sm;
+	sm.dst = block.begin();
+	uint dstSize = 0;
+	uint pos = 0;
+	int ret = IS_OK;
+
+	while(pos < size and ret == IS_OK)
+	{
+		uint readSize = MIN(size - pos, BENCH_BLOCK);
+		sm.src = src + pos;
+		sm.srcAvail = readSize;
+		pos += readSize;
+
+		ret = IS_STREAM_END;
+		while(ret == IS_STREAM_END)
+		{
+			sm.dstAvail = BENCH_BLOCK;
+			if(mode == 1)
+				ret = coder->compress(&sm, pos == size);
+			else
+				ret = coder->uncompress(&sm, pos == size);
+
+			if(ret < 0 or dstSize + sm.dstAvail > dst.size())
+				return MAX_UINT32;
+			mencpy(dst.begin() + dstSize, sm.dst, sm.dstAvail);
+			dstSize += sm.dstAvail;
+		}
+	}
+	return ret == IS_OK ? dstSize : MAX_UINT32;
+}
+
+CoderBenchmark::CoderBenchmark()
+{
+	_m = new impl;
+}
+
+CoderBenchmark::~CoderBenchmark()
+{
+	safe_delete(_m);
+}
+
+int CoderBenchmark::load(const String& name)
+{
+	FileStream file;
+	if(!file.open(name, 1))
+	{
+		_m->error(1, "Can not open data file");
+		return 0;
+	}
+	uint size = (uint) MIN(file.size(), (wint) BENCH_DATA_MAX);
+	_m->data.resize(size);
+	if(file.readBuffer(_m->data.begin(), size) != size)
+	{
+		_m->error(2, "Can not read data file");
+		return 0;
+	}
+	return 1;
+}
+
+void CoderBenchmark::generate(uint size)
+{
+	// words of syllables by skewed random, then records of counters
+	static const char* syllables[16] =
+	{
+		"ar", "chi", "va", "ri", "us", "com", "pre", "ss",
+		"da", "ta", "lo", "ng", "ma", "tch", "en", "de"
+	};
+	_m->data.resize(size);
+	byte* p = _m->data.begin();
+	uint seed = 0x2545F491;
+	uint pos = 0;
+	uint record = 0;
+
+	while(pos < size)
+	{
+		uint part = MIN(size - pos, (uint) BENCH_BLOCK);
+		byte* end = p + pos + part;
+		byte* q = p + pos;
+		if((pos / BENCH_BLOCK & 3) != 3)
+		{
+			while(q < end)
+			{
+				seed = seed * 1664525 + 1013904223;
+				uint r = seed >> 16;
+				// low syllables more often
+				uint n = 1 + (r & 3);
+				forn(n)
+				{
+					uint k = ((r >> (2 + i * 2)) & 15) * ((r >> 12) & 15) >> 4;
+					const char* s = syllables[k];
+					while(*s and q < end)
+						*q++ = *s++;
+				}
+				if(q < end)
+					*q++ = (r & 0x1F) ? ' ' : '\n';
+			}
+		}
+		else
+		{
+			while(q < end)
+			{
+				seed = seed * 1664525 + 1013904223;
+				uint value[4] = { record++, seed >> 24, 1000 + (seed >> 20 & 0xFF), 0 };
+				byte* v = (byte*) value;
+				forn(16)
+				{
+					if(q < end)
+						*q++ = v[i];
+				}
+			}
+		}
+		pos += part;
+	}
+}
+
+void CoderBenchmark::setValue(uint_t value, byte type)
+{
+	if(type == 0)
+		_m->encodeMethod = value;
+	else if(type == 1)
+		_m->encodeLevel = value;
+	else if(type == 2)
+		_m->encodeThreads = value;
+	else if(type == 3)
+		_m->dictSize = value;
+	else if(type == 16)
+		_m->encodeBigraph = value;
+	else if(type == 21)
+		_m->encodeCmix = value;
+}
+
+uint CoderBenchmark::count()
+{
+	Array<uint>& runs = _m->runs;
+	runs.resize(0);
+
+	for(uint method = 1; method < 4; method++)
+	{
+		// bigraph by own key, coders by method, all without keys
+		if(method == 3 and _m->encodeMethod and !_m->encodeBigraph)
+			continue;
+		if(method < 3 and (_m->encodeMethod ? method != _m->encodeMethod : _m->encodeBigraph))
+			continue;
+#ifndef TAA_ARCHIVARIUS_COMPRESS
+		if(method < 3)
+			continue;
+#elif TAA_PLATFORM_TYPE != TAA_PLATFORM_DESKTOP
+		if(method == 2)
+			continue;
+#endif
+		// preprocessor without levels
+		if(method == 3)
+		{
+			runs.push_back(method << 16 | 1);
+			continue;
+		}
+		for(uint level = 1; level < 10; level++)
+		{
+			if(_m->encodeLevel and level != _m->encodeLevel)
+				continue;
+			// threads of lzre match finder, from level 8 of optimal parsing
+			if(method != 1)
+				runs.push_back(method << 16 | level << 8 | 1);
+			else if(_m->encodeThreads)
+				runs.push_back(method << 16 | level << 8 | MIN(_m->encodeThreads, 0xFF));
+			else
+			{
+				runs.push_back(method << 16 | level << 8 | 1);
+#ifdef TAA_ARCHIVARIUS_THREAD
+				if(level >= 8)
+					runs.push_back(method << 16 | level << 8 | 2);
+#endif
+			}
+		}
+	}
+	return runs.size();
+}
+
+int CoderBenchmark::run(uint index, BenchmarkResult& result)
+{
+	if(index >= _m->runs.size())
+	{
+		_m->error(3, "Wrong run");
+		return 0;
+	}
+
+	uint code = _m->runs[index];
+	uint size = _m->data.size();
+	result = BenchmarkResult();
+	result.method = code >> 16;
+	result.level = code >> 8 & 0xFF;
+	result.threads = code & 0xFF;
+	result.size = size;
+
+	_m->block.resize(BENCH_BLOCK);
+	_m->packed.resize(size + size / 2 + BENCH_BLOCK * 4);
+	_m->unpacked.resize(size);
+
+	Timer timer;
+	SmartPtr<ICoder> coder;
+
+	// initialisation of tables in time, same as for archive
+	timer.reset();
+	coder.set(_m->createCoder(1, result));
+	if(!coder.ptr())
+	{
+		_m->error(4, "Method not supported");
+		return 0;
+	}
+	uint packedSize = _m->code(coder.ptr(), 1, _m->data.begin(), size, _m->packed);
+	result.compressTime = timer.getMicroseconds();
+	coder.reset();
+
+	if(packedSize == MAX_UINT32)
+	{
+		_m->error(5, "Compression error");
+		return 0;
+	}
+	result.packedSize = packedSize;
+
+	timer.reset();
+	coder.set(_m->createCoder(2, result));
+	uint unpackedSize = _m->code(coder.ptr(), 2, _m->packed.begin(), packedSize, _m->unpacked);
+	result.uncompressTime = timer.getMicroseconds();
+	coder.reset();
+
+	result.valid = unpackedSize == size;
+	byte* a = _m->data.begin();
+	byte* b = _m->unpacked.begin();
+	for(uint i = 0; i < size and result.valid; i++)
+		result.valid = a[i] == b[i];
+	return 1;
+}
+
+byte CoderBenchmark::getError()
+{
+	return _m->errorId;
+}
+
+String CoderBenchmark::getErrorStr()
+{
+	return _m->errorStr;
+}
+
+BenchmarkResult::BenchmarkResult()
+{
+	method = 0;
+	level = 0;
+	threads = 0;
+	size = 0;
+	packedSize = 0;
+	compressTime = 0;
+	uncompressTime = 0;
+	memory = 0;
+	valid = 0;
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/CoderFactory.h>
+
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+#include <Compress/LzreCoder.h>
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+#include <Compress/CmCoder.h>
+#endif
+#endif
+
+namespace tas
+{
+
+CoderParameters::CoderParameters()
+{
+	method = 0;
+	mode = 0;
+	dictionary = 0;
+	minMatch = 0;
+	maxMatch = 0;
+	level = 0;
+	cycles = 0;
+	rolz = 0;
+	suffix = 0;
+	threads = 0;
+	cmix = 0;
+	history = CODER_HISTORY;
+	window = 0;
+	size = 0;
+}
+
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+static void lzreParameters(CoderParameters* src, LzreParameters& dst)
+{
+	dst.mode = src->mode;
+	dst.dictionary = src->dictionary;
+	dst.minMatch = src->minMatch;
+	dst.maxMatch = src->maxMatch;
+	dst.level = src->level;
+	dst.cycles = src->cycles;
+	dst.rolz = src->rolz;
+	dst.suffix = src->suffix;
+	dst.threads = src->threads;
+	dst.cmix = src->cmix;
+	dst.history = src->history;
+	dst.window = src->window;
+}
+
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+static void cmParameters(CoderParameters* src, CmParameters& dst)
+{
+	dst.mode = src->mode;
+	dst.dictionary = src->dictionary;
+	dst.context = src->maxMatch;
+	dst.level = src->level;
+	dst.history = src->history;
+	dst.size = src->size;
+}
+#endif
+#endif
+
+ICoder* createCoder(CoderParameters* params)
+{
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+	if(params->method == 1)
+	{
+		LzreCoder* lzre = new LzreCoder;
+
+		LzreParameters lp;
+		lzreParameters(params, lp);
+		lzre->initialise(&lp);
+
+		params->dictionary = lp.dictionary;
+		params->minMatch = lp.minMatch;
+		params->maxMatch = lp.maxMatch;
+		params->cycles = lp.cycles;
+		params->rolz = lp.rolz;
+		params->suffix = lp.suffix;
+		params->threads = lp.threads;
+		params->window = lp.window;
+
+		return lzre;
+	}
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+	else if(params->method == 2)
+	{
+		CmCoder* cmix = new CmCoder;
+
+		CmParameters cp;
+		cmParameters(params, cp);
+		cmix->initialise(&cp);
+
+		params->dictionary = cp.dictionary;
+		params->maxMatch = cp.context;
+
+		return cmix;
+	}
+#endif
+#endif
+	return 0;
+}
+
+wint coderMemory(CoderParameters* params)
+{
+#ifdef TAA_ARCHIVARIUS_COMPRESS
+	if(params->method == 1)
+	{
+		LzreParameters lp;
+		lzreParameters(params, lp);
+		return LzreCoder::memory(&lp);
+	}
+#if TAA_PLATFORM_TYPE == TAA_PLATFORM_DESKTOP
+	else if(params->method == 2)
+	{
+		CmParameters cp;
+		cmParameters(params, cp);
+		return CmCoder::memory(&cp);
+	}
+#endif
+#endif
+	return 0;
+}
+
+}
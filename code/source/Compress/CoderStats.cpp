@@ -0,0 +1,87 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/CoderStats.h>
+#include <stdio.h>
+
+namespace tas
+{
+
+CoderStats::CoderStats()
+{
+	reset();
+}
+
+void CoderStats::reset()
+{
+	forn(STAGE_COUNT)
+	{
+		time[i] = 0;
+		bytes[i] = 0;
+	}
+	forn(5) codes[i] = 0;
+	lookups = 0;
+	hits = 0;
+	cycles[0] = 0;
+	cycles[1] = 0;
+}
+
+void CoderStats::splitCoderTime()
+{
+	wint total = cycles[0] + cycles[1];
+	if(!total)
+		return;
+	wint match = (wint) ((double) time[STAGE_CODE] * cycles[0] / total);
+	time[STAGE_MATCH] += match;
+	time[STAGE_CODE] -= match;
+	bytes[STAGE_MATCH] = bytes[STAGE_CODE];
+	cycles[0] = 0;
+	cycles[1] = 0;
+}
+
+const char* CoderStats::stageName(uint stage)
+{
+	static const char* stages[STAGE_COUNT] =
+	{
+		"read", "crc", "filter", "match", "code", "crypt", "write"
+	};
+	return stage < STAGE_COUNT ? stages[stage] : "";
+}
+
+uint CoderStats::json(char* dst)
+{
+	static const char* types[5] =
+	{
+		"literal", "match", "repeat", "rolz", "long"
+	};
+
+	typedef unsigned long long ull;
+	int n = sprintf(dst, "{\"stages\":{");
+	forn(STAGE_COUNT)
+	{
+		n += sprintf(dst + n, "%s\"%s\":{\"time_us\":%llu,\"bytes\":%llu}",
+		             i ? "," : "", stageName(i), (ull) time[i], (ull) bytes[i]);
+	}
+	n += sprintf(dst + n, "},\"codes\":{");
+	forn(5)
+	{
+		n += sprintf(dst + n, "%s\"%s\":%llu", i ? "," : "", types[i], (ull) codes[i]);
+	}
+	n += sprintf(dst + n, "},\"dictionary\":{\"lookups\":%llu,\"hits\":%llu,\"hit_rate\":%.4f}}",
+	             (ull) lookups, (ull) hits, lookups ? (double) hits / lookups : 0.0);
+	return n;
+}
+
+}
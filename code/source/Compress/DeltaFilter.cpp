@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/DeltaFilter.h>
+#include <Common/Math.h>
+#include <Common/StringLib.h>
+
+// sample of file for detection
+#define DELTA_SAMPLE (1 << 15)
+#define DELTA_SAMPLE_MIN (1 << 10)
+
+namespace tas
+{
+
+/// bits of bytes by order 0 entropy
+static float entropyCost(uint* freq, uint total)
+{
+	float bits = total * log2((float) total);
+	forn(256)
+	{
+		if(freq[i])
+			bits -= freq[i] * log2((float) freq[i]);
+	}
+	return bits;
+}
+
+DeltaFilter::DeltaFilter()
+{
+	reset(1, 1);
+}
+
+DeltaFilter::~DeltaFilter()
+{
+}
+
+byte DeltaFilter::detect(byte* data, uint size)
+{
+	if(size < DELTA_SAMPLE_MIN)
+		return 0;
+	size = MIN(size, DELTA_SAMPLE);
+
+	uint freq[256];
+	menset(freq, 0, sizeof(freq));
+	forn(size)
+	freq[data[i]]++;
+	float bestCost = entropyCost(freq, size);
+	byte best = 0;
+
+	// smaller stride wins without clear gain, multiples of stride are alike
+	for(uint s = 1; s <= DELTA_STRIDE_MAX; s++)
+	{
+		menset(freq, 0, sizeof(freq));
+		for(uint i = s; i < size; i++)
+			freq[(byte) (data[i] - data[i - s])]++;
+		float cost = entropyCost(freq, size - s);
+		if(cost < bestCost * (best ? 0.97f : 0.85f))
+		{
+			bestCost = cost;
+			best = s;
+		}
+	}
+	return best;
+}
+
+void DeltaFilter::reset(byte _mode, byte _stride)
+{
+	menset(history, 0, sizeof(history));
+	index = 0;
+	stride = _stride;
+	mode = _mode;
+}
+
+void DeltaFilter::process(byte* data, uint size)
+{
+	byte k = index;
+	if(mode == 1)
+	{
+		forn(size)
+		{
+			byte v = data[i];
+			data[i] = v - history[k];
+			history[k] = v;
+			if(++k == stride)
+				k = 0;
+		}
+	}
+	else
+	{
+		forn(size)
+		{
+			byte v = data[i] + history[k];
+			data[i] = v;
+			history[k] = v;
+			if(++k == stride)
+				k = 0;
+		}
+	}
+	index = k;
+}
+
+}
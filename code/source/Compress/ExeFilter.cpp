@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2018-2020 Theodorus Software
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <Compress/ExeFilter.h>
+#include <Common/platform/assert.h>
+
+// instructions not over segment end
+#define EXE_SEGMENT (1 << 16)
+// little endian 2, 4 bytes
+#define LE16(p) ((p)[0] | (p)[1] << 8)
+#define LE32(p) ((p)[0] | (p)[1] << 8 | (p)[2] << 16 | (uint)(p)[3] << 24)
+
+namespace tas
+{
+
+ExeFilter::ExeFilter()
+{
+	pos = 0;
+	mode = 1;
+}
+
+ExeFilter::~ExeFilter()
+{
+}
+
+byte ExeFilter::detect(byte* data, uint size)
+{
+	if(size < 64)
+		return 0;
+
+	// ELF, machine i386 or x86-64
+	if(LE32(data) == 0x464C457F)
+	{
+		uint machine = LE16(data + 18);
+		return machine == 3 or machine == 62;
+	}
+
+	// PE, header offset at 0x3C
+	if(LE16(data) == 0x5A4D)
+	{
+		uint offset = LE32(data + 0x3C);
+		if(offset > size - 6 or LE32(data + offset) != 0x4550)
+			return 0;
+		uint machine = LE16(data + offset + 4);
+		return machine == 0x14C or machine == 0x8664;
+	}
+
+	// Mach-O 32, 64 bit, cpu x86 with 64 bit flag
+	uint magic = LE32(data);
+	if(magic == 0xFEEDFACE or magic == 0xFEEDFACF)
+		return (LE32(data + 4) & 0xFFFFFF) == 7;
+
+	return 0;
+}
+
+void ExeFilter::reset(byte _mode)
+{
+	pos = 0;
+	mode = _mode;
+}
+
+void ExeFilter::process(byte* data, uint size)
+{
+	// scan not carried over calls, previous data ends at segment
+	// or it was last data of file
+	assert(!(pos & EXE_SEGMENT - 1));
+	while(size)
+	{
+		uint n = MIN(size, EXE_SEGMENT - (uint) (pos & EXE_SEGMENT - 1));
+		uint base = (uint) pos;
+		uint i = 0;
+		while(i + 5 <= n)
+		{
+			byte* p = data + i;
+			if((p[0] & 0xFE) != 0xE8)
+			{
+				i++;
+				continue;
+			}
+
+			// operand of call, jump always skipped, so positions
+			// of opcodes are same in encoder and decoder
+			if(p[4] == 0 or p[4] == 0xFF)
+			{
+				// target by next instruction, sign of 25 bits
+				uint next = base + i + 5;
+				uint a = LE32(p + 1);
+				a = mode == 1 ? a + next : a - next;
+				a = (uint) ((int) (a << 7) >> 7);
+				p[1] = a;
+				p[2] = a >> 8;
+				p[3] = a >> 16;
+				p[4] = a >> 24;
+			}
+			i += 5;
+		}
+		data += n;
+		size -= n;
+		pos += n;
+	}
+}
+
+}
@@ -25,15 +25,21 @@ limitations under the License.
  | - Repeat distances     level 6                                   |
  | - Reduce distances     level 7                                   |
  | - Non greedy parsing   level 8                                   |
+ | - Long matches beyond dictionary, sparse positions               |
  | - Context mixing                                                 |
  --------------------------------------------------------------------
 */
 
 #include <Compress/LzreCoder.h>
 #include <Compress/BinaryCoder.h>
+#include <Compress/BitHistory.h>
+#include <Compress/CoderStats.h>
 #include <Common/Bitwise.h>
+#include <Common/Cpu.h>
+#include <Common/Trace.h>
 #include <Common/Hash.h>
 #include <Common/Math.h>
+#include <Common/Allocator.h>
 #include <Common/container/Array.h>
 #include <Common/container/HashTable.h>
 #include <Common/container/RingBuffer.h>
@@ -64,12 +70,23 @@ namespace tas
 #define REDLS 0x10000
 #define REDLM 0xFFFF
 
+// LONGN long match minimum length, rolling hash bytes
+// LONGS sampled position by high bits of rolling hash, 1 of 64
+// LONGW maximum long window
+#define LONGN 64
+#define LONGS 58
+#define LONGW (1 << 30)
+
+// 1 of 64 codes timed for stats
+#define STATS_SAMPLE 63
+
 enum MatchType
 {
 	MT_LITERA = 0,
 	MT_MATCH  = 1,
 	MT_REPEAT = 2,
 	MT_ROLZ   = 3,
+	MT_LONG   = 4,
 };
 
 enum ContextType
@@ -83,6 +100,7 @@ enum ContextType
 	CT_LENGTH_TYPE  = 6,
 	CT_LENGTH       = 7,
 	CT_LENGTH_SHORT = 8,
+	CT_LONG         = 9,
 };
 
 enum NonGreedy
@@ -142,9 +160,6 @@ struct LzreDictValue
 		chsum = 0;
 		count = 0;
 	}
-	~LzreDictValue()
-	{
-	}
 	void reset(uint checksum)
 	{
 		distance = 0;
@@ -161,6 +176,13 @@ struct LzreDictValue
 	}
 };
 
+// Long match position
+struct LzreLongValue
+{
+	uint position; // low bits of stream position
+	uint chsum;    // low bits of rolling hash
+};
+
 struct Counter
 {
 	byte n[2];
@@ -171,9 +193,6 @@ struct Counter
 		n[0] = 0;
 		n[1] = 0;
 	}
-	~Counter()
-	{
-	}
 	void reset(byte _ch = 0)
 	{
 		ch = _ch;
@@ -211,6 +230,7 @@ struct LzreCoder::impl: public IStream
 
 	BinaryCoder rangeCoder;
 	half* context;      // contexts bit coding
+	uint  contextSize;  // contexts count
 	byte* contextBit;   // contexts bits
 	uint* contextShift; // contexts distances
 	uint  contextState; // contexts state
@@ -278,10 +298,29 @@ struct LzreCoder::impl: public IStream
 	half* pricem;
 	uint* stats;
 	uint* statsd;
+	CoderStats* codeStats; // counters of job
+	uint statsTick;        // codes to sampled code
 	uint* red;
 
+	/* long matches */
+	RingBuffer<byte> longBuffer; // stream window beyond search buffer
+	LzreLongValue* longTable; // sampled positions of window
+	uint  longMask;
+	wint* longGear;    // rolling hash values of bytes
+	wint* longHash;    // rolling hash by lab positions
+	uint  longHashMask;
+	wint  longRoll;    // rolling hash of last input bytes
+	wint  longInput;   // stream position of lab end
+	wint  longPos;     // stream position of lab begin
+	uint  longDistance; // last long distance
+	byte  longs;       // long matches state
+
 	/* context mixing */
 	HashTable<Counter> contextTable;
+	HashTable<StateCounter> stateTable;
+	StateMap stateMap;
+	StateCounter** states;
+	byte history; // bit history states
 	byte contextLen;
 	uint* hashy; // context [0, 3]
 	uint* hashes;
@@ -300,9 +339,11 @@ struct LzreCoder::impl: public IStream
 	int initialiseContext();
 	int initialiseContextMix();
 	int initialisePrefix();
+	void reset();
 
 	int updateLab();
 	int findMatch();
+	int findMatchLong();
 	int findMatchThread(byte threadn);
 	int findMatchOptimal();
 	int findMatchOptimalPrice(byte state);
@@ -327,7 +368,8 @@ struct LzreCoder::impl: public IStream
 	uint readCodeBit(half* probs, uint model);
 	uint readCodeDistance();
 
-	void predict(uint& n0, uint& n1, byte c0);
+	uint predict(byte c0);
+	void update(byte y);
 	int writeCodeLit();
 	byte readCodeLit();
 };
@@ -369,6 +411,7 @@ LzreCoder::LzreCoder()
 	_m->threadMax = 0;
 	_m->restDec = 0;
 	_m->context = 0;
+	_m->contextSize = 0;
 	_m->contextBit = 0;
 	_m->contextShift = 0;
 	_m->contextState = 0;
@@ -390,14 +433,18 @@ LzreCoder::LzreCoder()
 	_m->weight = 0;
 	_m->contextLen = 0;
 	_m->cmix = 0;
+	_m->history = 0;
+	_m->states = 0;
 	_m->dn = new LzreDictValue*[2];
+	_m->codeStats = 0;
+	_m->statsTick = 0;
 	_m->stats = new uint[10];
 	_m->statsd = new uint[30];
 	_m->mask = new uint[33];
 	_m->maskf = new uint[33];
 	_m->prefixLab = new byte[20];
-	_m->prefixCode = new byte[4];
-	_m->prefixBit = new byte[4];
+	_m->prefixCode = new byte[5];
+	_m->prefixBit = new byte[5];
 	_m->pmLen = 1;
 	_m->prefixBitMax = 0;
 	_m->prefixCount = 0;
@@ -409,6 +456,16 @@ LzreCoder::LzreCoder()
 	_m->pricem = 0;
 	_m->distanceOpts = 0;
 	_m->lengthOpts = 0;
+	_m->longTable = 0;
+	_m->longMask = 0;
+	_m->longGear = 0;
+	_m->longHash = 0;
+	_m->longHashMask = 0;
+	_m->longRoll = 0;
+	_m->longInput = 0;
+	_m->longPos = 0;
+	_m->longDistance = 0;
+	_m->longs = 0;
 
 	forn(33)
 	{
@@ -449,6 +506,7 @@ LzreCoder::~LzreCoder()
 	fprintf(_m->log, "match   %u\n", _m->stats[1]);
 	fprintf(_m->log, "repeat  %u\n", _m->stats[2]);
 	fprintf(_m->log, "rolz    %u\n", _m->stats[3]);
+	fprintf(_m->log, "long    %u\n", _m->stats[9]);
 
 	fprintf(_m->log, "\n-- matches --\n\n");
 
@@ -467,7 +525,7 @@ LzreCoder::~LzreCoder()
 	forn(30) fprintf(_m->log, "[%02u] %u\n", i, _m->statsd[i]);
 #endif
 
-	safe_delete_array(_m->searchLink);
+	safe_delete_large(_m->searchLink);
 	safe_delete_array(_m->streamDec);
 	safe_delete_array(_m->context);
 	safe_delete_array(_m->contextBit);
@@ -487,11 +545,15 @@ LzreCoder::~LzreCoder()
 	safe_delete_array(_m->hashy);
 	safe_delete_array(_m->hashes);
 	safe_delete_array(_m->weight);
+	safe_delete_array(_m->states);
 	safe_delete_array(_m->pricem);
 	safe_delete_array(_m->distanceOpts);
 	safe_delete_array(_m->lengthOpts);
 	safe_delete_array(_m->reduceTable);
 	safe_delete_array(_m->reduceLink);
+	safe_delete_large(_m->longTable);
+	safe_delete_array(_m->longGear);
+	safe_delete_array(_m->longHash);
 
 	_m->lzreThread.uninitialise();
 
@@ -517,6 +579,7 @@ int LzreCoder::impl::initialise(LzreParameters* params)
 	rolzCount = params->rolz;
 	threadMax = params->threads;
 	cmix = params->cmix;
+	history = params->history;
 	level = clamp(level, 9, 1);
 
 	if(!dictSize)
@@ -602,6 +665,16 @@ int LzreCoder::impl::initialise(LzreParameters* params)
 	searchBoundUp = searchBuffer.cnt + 1;
 	searchSize = dictSize + 1;
 
+	// long matches window beyond search buffer
+	uint window = params->window;
+	if(window > dictSize and maxMatchLen >= LONGN)
+	{
+		window = MIN(window, LONGW);
+		longBuffer.initialise(window);
+		longs = 1;
+	}
+	params->window = longs ? window : 0;
+
 	if(mode == 1)
 	{
 #if LZRE_LOG
@@ -616,7 +689,7 @@ int LzreCoder::impl::initialise(LzreParameters* params)
 			searchDict.initialise(1 << 16);
 		else
 			searchDict.initialise(1 << prefixMain + 15);
-		searchLink = new uint[dictSize];
+		searchLink = (uint*) allocatorLarge((uint_t) dictSize * sizeof(uint));
 		forn(dictSize)
 		searchLink[i] = 0;
 #if defined(TAA_ARCHIVARIUS_THREAD) and TAA_PLATFORM != TAA_PLATFORM_UNKNOWN
@@ -635,6 +708,21 @@ int LzreCoder::impl::initialise(LzreParameters* params)
 		forn(2) distances[i].reserve(matchCycles * 2);
 		if(threadMax > 1)
 			lzreThread.initialise(threadMax - 1);
+		if(longs)
+		{
+			// sampled positions, table for 1 of 64 in window
+			uint longSize = 1 << bitGreat((window >> 6) - 1);
+			longTable = (LzreLongValue*) allocatorLarge((uint_t) longSize * sizeof(LzreLongValue));
+			menset(longTable, 0, longSize * sizeof(LzreLongValue));
+			longMask = longSize - 1;
+			uint hashSize = 1 << bitGreat(labSize * 2 - 1);
+			longHash = new wint[hashSize];
+			menset(longHash, 0, hashSize * sizeof(wint));
+			longHashMask = hashSize - 1;
+			longGear = new wint[256];
+			forn(256)
+			longGear[i] = HashMurmur64A((byte*) &i, sizeof(i), 0x9E3779B97F4A7C15ULL);
+		}
 		params->dictionary = dictSize;
 		params->minMatch = minMatchLen;
 		params->suffix = 1;
@@ -659,6 +747,113 @@ int LzreCoder::impl::initialise(LzreParameters* params)
 	return 1;
 }
 
+void LzreCoder::impl::reset()
+{
+	// search buffer not wrapped, positions written from 0
+	byte whole = searchBuffer.cnt == searchBuffer.bsz;
+	uint used = whole ? searchBuffer.bsz : searchBuffer.end;
+
+	if(!mode)
+	{
+		// dictionary nodes of written prefixes, else all nodes
+		if(!whole and used * 3 < searchDict.size())
+		{
+			uint prefixes = used >= prefixMain ? used - prefixMain + 1 : 0;
+			form(u, prefixes)
+			searchDict.clear(HASHP(searchBuffer.buf + u));
+		}
+		else
+			searchDict.clear();
+		menset(searchLink, 0, used * sizeof(uint));
+		lookBuffer.reset();
+		menset(lookBuffer.buf, 0, lookBuffer.bsz);
+		ngreedy = ngreedy ? NG_ENABLE : 0;
+	}
+	else
+		streamDec[0] = 0;
+
+	if(rolz)
+	{
+		menset(reduceTable, 0, REDTS * sizeof(uint));
+		menset(reduceLink, 0, MIN(searchBoundUp + 1, REDLS) * sizeof(uint));
+	}
+
+	if(longs)
+	{
+		menset(longBuffer.buf, 0, longBuffer.cnt == longBuffer.bsz ? longBuffer.bsz : longBuffer.end);
+		longBuffer.reset();
+		if(!mode)
+		{
+			menset(longTable, 0, (longMask + 1) * sizeof(LzreLongValue));
+			menset(longHash, 0, (longHashMask + 1) * sizeof(wint));
+		}
+	}
+
+	if(repeats)
+	{
+		repDist.reset();
+		menset(repDist.buf, 0, repDist.bsz * sizeof(uint));
+	}
+
+	if(cmix)
+	{
+		if(history)
+		{
+			stateTable.clear();
+			stateMap.reset();
+		}
+		else
+			contextTable.clear();
+		forn(contextLen)
+		{
+			hashy[i] = 0;
+			hashes[i] = 0;
+		}
+	}
+
+	menset(searchBuffer.buf, 0, used);
+	searchBuffer.reset();
+	forn(4) searchBuffer.push(0);
+	searchBoundLow = 1;
+	searchBoundUp = searchBuffer.cnt + 1;
+
+	forn(contextSize)
+	context[i] = probMid;
+	contextState = 0;
+	contextShift[0] = 0;
+	pmLen = 1;
+	rangeCoder.reset();
+
+	match.reset();
+	forn(20) prefixLab[i] = 0;
+	lookSize = 0;
+	prefixFound = 0;
+	src = 0;
+	dst = 0;
+	srcRead = 0;
+	srcAvail = 0;
+	srcTotal = 0;
+	dstWrite = 0;
+	dstAvail = 0;
+	dstTotal = 0;
+	if(restDec)
+		restDec[0] = 0;
+	eof = 0;
+	flush = 0;
+	repIndex = 0;
+	threadCount = 1;
+	threadRun = 0;
+	distance = 0;
+	distancem = 0;
+	findOpt = 0;
+	rolzIndex = 0;
+	red = 0;
+	longRoll = 0;
+	longInput = 0;
+	longPos = 0;
+	longDistance = 0;
+}
+
 int LzreCoder::impl::initialiseContext()
 {
 	// Context coding bits.
@@ -676,11 +871,12 @@ int LzreCoder::impl::initialiseContext()
 	// | 6 | length type    |  4  |     |
 	// | 7 | length         |  8  | 10  |
 	// | 8 | length short   |  5  |     |
+	// | 9 | long repeat    |  1  |     |
 	// ----------------------------------
 
-	uint contextTypes = 9;
+	uint contextTypes = 10;
 	uint contextTotal = 0;
-	uint contextSpace[9] = { 3, 16, 6, 8, 3, 4, 4, 8, 5 };
+	uint contextSpace[10] = { 3, 16, 6, 8, 3, 4, 4, 8, 5, 1 };
 
 	if(level > 5)
 	{
@@ -693,16 +889,21 @@ int LzreCoder::impl::initialiseContext()
 			contextSpace[CT_LITERA] = 0;
 	}
 
-	uint contextCount[9] = {0};
+	// long prefix code is 1 bit longer
+	if(longs)
+		contextSpace[CT_PREFIX]++;
+
+	uint contextCount[10] = {0};
 	forn(contextTypes) contextCount[i] = maskf[contextSpace[i] + 1];
 
-	// prefixes contexts for 8 states
-	contextCount[CT_PREFIX] += maskf[contextSpace[CT_PREFIX] + 1] * 7;
+	// prefixes contexts for 8 states, state after long match
+	contextCount[CT_PREFIX] += maskf[contextSpace[CT_PREFIX] + 1] * (longs ? 8 : 7);
 
 	// lengths contexts for all match types
-	if(prefixCount > 1)
+	if(prefixCount > 1 or longs)
 	{
-		forn(3) contextCount[CT_LENGTH_TYPE + i] += maskf[contextSpace[CT_LENGTH_TYPE + i] + 1] * 2;
+		byte types = longs ? 3 : 2;
+		forn(3) contextCount[CT_LENGTH_TYPE + i] += maskf[contextSpace[CT_LENGTH_TYPE + i] + 1] * types;
 	}
 
 	contextShift = new uint[contextTypes];
@@ -717,6 +918,7 @@ int LzreCoder::impl::initialiseContext()
 
 	assert(contextTotal < 1 << 20);
 	context = new half[contextTotal];
+	contextSize = contextTotal;
 
 	byte rangeBits = 12;
 	rangeMain = 1 << rangeBits;
@@ -742,7 +944,14 @@ int LzreCoder::impl::initialiseContextMix()
 {
 	if(!cmix) return 0;
 	contextLen = 4;
-	contextTable.initialise(1 << 21);
+	if(history)
+	{
+		stateTable.initialise(1 << 21);
+		stateMap.initialise(contextLen);
+		states = new StateCounter*[contextLen];
+	}
+	else
+		contextTable.initialise(1 << 21);
 	hashy = new uint[contextLen];
 	hashes = new uint[contextLen];
 	weight = new uint[contextLen];
@@ -757,7 +966,7 @@ int LzreCoder::impl::initialiseContextMix()
 
 int LzreCoder::impl::initialisePrefix()
 {
-	forn(4)
+	forn(5)
 	{
 		prefixCode[i] = 0;
 		prefixBit[i] = 0;
@@ -791,6 +1000,17 @@ int LzreCoder::impl::initialisePrefix()
 			prefixBit [MT_REPEAT] = 2;
 		}
 	}
+
+	// long match, last code extended by bit
+	if(longs)
+	{
+		byte last = rolz ? MT_ROLZ : repeats ? MT_REPEAT : MT_MATCH;
+		prefixCode[MT_LONG] = prefixCode[last] << 1 | 1;
+		prefixBit [MT_LONG] = prefixBit[last] + 1;
+		prefixCode[last] <<= 1;
+		prefixBit [last]++;
+		prefixBitMax++;
+	}
 	return 1;
 }
 
@@ -940,13 +1160,36 @@ uint LzreCoder::impl::readCodeDistance()
 	return distance;
 }
 
-void LzreCoder::impl::predict(uint& n0, uint& n1, byte c0)
+uint LzreCoder::impl::predict(byte c0)
 {
+	uint hashKey;
+	if(history)
+	{
+		// mix states in logistic domain,
+		// weight by order and history length
+		int sw = 0;
+		int sp = 0;
+		forn(contextLen)
+		{
+			hashKey = HASHL(hashy[i], c0);
+			StateCounter* sc = &stateTable.get(hashKey, hashKey >> 24);
+			int w = weight[i] * sc->priority();
+			sw += w;
+			sp += w * StateTable::stretch(stateMap.p(i, sc->state));
+			states[i] = sc;
+		}
+		if(sw)
+			sp /= sw;
+		// squash 12 bits result in [1, 4094]
+		return rangeMain - (StateTable::squash(sp) >> 4);
+	}
+
+	uint n0 = 1;
+	uint n1 = 1;
 	uint h0 = 0;
 	uint h1 = 0;
 	uint w = 0;
 	Counter* counter;
-	uint hashKey;
 	forn(contextLen)
 	{
 		h0 = 0;
@@ -971,6 +1214,25 @@ void LzreCoder::impl::predict(uint& n0, uint& n1, byte c0)
 		// update hash
 		hashes[i] = hashKey;
 	}
+	return rangeMain * n0 / (n0+n1);
+}
+
+void LzreCoder::impl::update(byte y)
+{
+	if(history)
+	{
+		// update maps before states
+		forn(contextLen)
+		{
+			stateMap.update(i, states[i]->state, y);
+			states[i]->update(y);
+		}
+		return;
+	}
+
+	// update counters in hash table
+	forn(contextLen)
+	contextTable.get(hashes[i], hashes[i] >> 24).update(y);
 }
 
 int LzreCoder::impl::writeCodeLit()
@@ -979,8 +1241,6 @@ int LzreCoder::impl::writeCodeLit()
 	byte y = 0;    // bit
 	byte c0 = 1;   // context
 	byte c1 = 128; // mask
-	uint n0 = 1;   // count 0
-	uint n1 = 1;   // count 1
 	uint f0 = 0;
 
 	// calculate context hash
@@ -992,14 +1252,10 @@ int LzreCoder::impl::writeCodeLit()
 	{
 		y = (c & c1) != 0;
 
-		n0 = 1;
-		n1 = 1;
-
 		// prediction bits probability
-		predict(n0, n1, c0);
+		f0 = predict(c0);
 
 		// encode bit in range coder
-		f0 = rangeMain * n0 / (n0+n1);
 		rangeCoder.encodeBit(f0, y);
 
 		// update context, shift mask to low
@@ -1007,8 +1263,7 @@ int LzreCoder::impl::writeCodeLit()
 		c1 >>= 1;
 
 		// update counters in hash table
-		form(u, contextLen)
-		contextTable.get(hashes[u], hashes[u] >> 24).update(y);
+		update(y);
 	}
 
 	return 1;
@@ -1020,8 +1275,6 @@ byte LzreCoder::impl::readCodeLit()
 	byte y = 0;    // bit
 	byte c0 = 1;   // context
 	byte c1 = 128; // mask
-	uint n0 = 1;   // count 0
-	uint n1 = 1;   // count 1
 	uint f0 = 0;
 
 	// calculate context hash
@@ -1033,14 +1286,10 @@ byte LzreCoder::impl::readCodeLit()
 	{
 		y = (c & c1) != 0;
 
-		n0 = 1;
-		n1 = 1;
-
 		// prediction bits probability
-		predict(n0, n1, c0);
+		f0 = predict(c0);
 
 		// encode bit in range coder
-		f0 = rangeMain * n0 / (n0+n1);
 		y = rangeCoder.decodeBit(f0);
 
 		// update context, shift mask to low
@@ -1048,8 +1297,7 @@ byte LzreCoder::impl::readCodeLit()
 		c1 >>= 1;
 
 		// update counters in hash table
-		form(u, contextLen)
-		contextTable.get(hashes[u], hashes[u] >> 24).update(y);
+		update(y);
 	}
 
 	return c0;
@@ -1080,8 +1328,16 @@ int LzreCoder::impl::updateLab()
 					lookBuffer.pop(ln - u);
 				break;
 			}
-			lookBuffer.push(src[srcRead++]);
+			byte c = src[srcRead++];
+			lookBuffer.push(c);
 			lookSize++;
+
+			// hash of last LONGN bytes, gear values shifted out after
+			if(longs)
+			{
+				longRoll = (longRoll << 1) + longGear[c];
+				longHash[longInput++ & longHashMask] = longRoll;
+			}
 		}
 	}
 	else
@@ -1140,6 +1396,11 @@ int LzreCoder::impl::findMatch()
 			skip = 1;
 			dn[j]->reset(0);
 		}
+		if(codeStats and !j)
+		{
+			codeStats->lookups++;
+			codeStats->hits += !skip;
+		}
 		if(skip)
 		{
 			dn[j] = 0;
@@ -1221,6 +1482,61 @@ int LzreCoder::impl::findMatch()
 	return findMatchOptimal();
 }
 
+int LzreCoder::impl::findMatchLong()
+{
+	if(lookSize < LONGN)
+		return 0;
+
+	half lenPeak = MIN(maxMatchLen, lookSize);
+	half lenTop = 0;
+	uint distanceTop = 0;
+
+	// continue last long match, else match from sampled position
+	form(j, 2)
+	{
+		uint distance = longDistance;
+		if(j)
+		{
+			wint h = longHash[longPos + LONGN - 1 & longHashMask];
+			if(h >> LONGS)
+				break;
+			LzreLongValue& v = longTable[(uint) (h >> 32 ^ h) & longMask];
+			if(v.chsum != (uint) h)
+				break;
+			distance = (uint) longPos - v.position - 1;
+		}
+
+		// beyond search buffer, inside long window, not overlapped
+		if(distance < searchBuffer.bsz or distance >= longBuffer.cnt)
+			continue;
+		half lenActual = 0;
+		half lenMax = MIN(lenPeak, distance + 1);
+		for(uint i = lookBuffer.beg,
+		        k = longBuffer.lastp(distance);
+		        lenActual < lenMax and
+		        lookBuffer.getp(i) == longBuffer.getp(k);
+		        lenActual++);
+
+		if(lenActual >= LONGN)
+		{
+			lenTop = lenActual;
+			distanceTop = distance;
+			break;
+		}
+	}
+
+	if(!lenTop)
+		return 0;
+
+	match.reset();
+	match.type = MT_LONG;
+	match.distance = distanceTop;
+	match.length = lenTop;
+	if(ngreedy)
+		ngreedy = NG_ENABLE;
+	return 1;
+}
+
 int LzreCoder::impl::findMatchThread(byte thread)
 {
 	half lenStart = prefixMain;
@@ -1568,6 +1884,13 @@ int LzreCoder::impl::writeMatch()
 		{
 			writeCodeDistance(match.distance);
 		}
+		else if(match.type == MT_LONG)
+		{
+			writeCode(match.distance == longDistance, 1, CT_LONG, 1);
+			if(match.distance != longDistance)
+				writeCodeDistance(match.distance);
+			longDistance = match.distance;
+		}
 
 		// length
 		type = match.lengthShort ? CT_LENGTH_SHORT : CT_LENGTH;
@@ -1613,7 +1936,9 @@ int LzreCoder::impl::updateContextState(byte mode)
 	}
 
 	// change context state
-	if(match.type)
+	if(match.type == MT_LONG)
+		contextState = 8;
+	else if(match.type)
 	{
 		if(match.lengthShort)
 			contextState = match.type + 1; // first
@@ -1684,10 +2009,25 @@ int LzreCoder::impl::updateDictionary()
 
 	form(u, count)
 	{
-		if(!mode)
-			searchBuffer.push(lookBuffer.get(u));
-		else
-			searchBuffer.push(streamDec[u]);
+		byte c = !mode ? lookBuffer.get(u) : streamDec[u];
+		searchBuffer.push(c);
+
+		if(longs)
+		{
+			// sampled position by hash of next LONGN bytes in lab
+			if(!mode and longPos + LONGN - 1 < longInput)
+			{
+				wint h = longHash[longPos + LONGN - 1 & longHashMask];
+				if(h >> LONGS == 0)
+				{
+					LzreLongValue& v = longTable[(uint) (h >> 32 ^ h) & longMask];
+					v.position = (uint) longPos;
+					v.chsum = (uint) h;
+				}
+			}
+			longBuffer.push(c);
+			longPos++;
+		}
 
 		if(++searchBoundUp > searchSize)
 			searchBoundLow++;
@@ -1729,7 +2069,11 @@ int LzreCoder::impl::updateDictionary()
 	}
 
 	if(searchBoundUp > 0xFFFF0000)
+	{
+		TRACE_BEGIN("normalise", "coder", searchBoundUp);
 		normaliseDictionary();
+		TRACE_END("normalise", "coder", searchBoundUp);
+	}
 
 	return 1;
 }
@@ -1783,6 +2127,13 @@ int LzreCoder::impl::decodePrefix(byte prefix)
 		match.distance = searchBoundUp - *red - 3;
 		match.distanceBit = rolzBit;
 	}
+	else if(longs and prefix == prefixCode[MT_LONG])
+	{
+		match.type = MT_LONG;
+		if(!readCode(1, CT_LONG, 1))
+			longDistance = readCodeDistance();
+		match.distance = longDistance;
+	}
 	else
 		assert(0 and "wrong prefix code");
 	return 1;
@@ -1803,7 +2154,7 @@ int LzreCoder::impl::logMessage()
 	}
 	if(LZRE_LOG & 4 and match.type == MT_LITERA)
 		fprintf(logc, "%c", !mode ? lookBuffer.get(0) : streamDec[0]);
-	stats[match.type]++;
+	stats[match.type == MT_LONG ? 9 : match.type]++;
 	if(match.type and match.lengthShort)
 		stats[5]++;
 	if(match.type and match.length == minMatchLen)
@@ -1844,12 +2195,31 @@ int LzreCoder::impl::compress(CoderStream* sm, byte flusha)
 			continue;
 		}
 
-		int find = findMatch();
+		// cycles of match finding and coding for part of codes
+		byte sample = codeStats and !(++statsTick & STATS_SAMPLE);
+		wint ticks = sample ? cpuTicks() : 0;
+		wint ticksFind = 0;
+
+		int find = 0;
+		if(longs)
+			find = findMatchLong();
+		if(!find)
+			find = findMatch();
+
+		if(sample)
+			ticksFind = cpuTicks();
 
 		// write code to destination
 		if(!writeMatch())
 			return IS_STREAM_ERROR;
 
+		if(codeStats)
+		{
+			codeStats->codes[match.type]++;
+			if(sample)
+				codeStats->cycles[1] += cpuTicks() - ticksFind;
+		}
+
 		// end of file
 		// last block, founded all matches in lab
 		if(flush and srcRead == srcAvail and !lookSize)
@@ -1861,7 +2231,14 @@ int LzreCoder::impl::compress(CoderStream* sm, byte flusha)
 		}
 
 		// update dictionary
-		updateDictionary();
+		if(sample)
+		{
+			wint ticksCode = cpuTicks();
+			updateDictionary();
+			codeStats->cycles[0] += ticksFind - ticks + cpuTicks() - ticksCode;
+		}
+		else
+			updateDictionary();
 
 		// dest size small
 		if(dstAvail - dstWrite < 40)
@@ -1995,12 +2372,21 @@ int LzreCoder::impl::uncompress(CoderStream* sm, byte flusha)
 			else
 				match.length += maxShortLen;
 
-			if(repeats)
-				repDist.push(match.distance);
+			if(match.type == MT_LONG)
+			{
+				distance = longBuffer.lastp(match.distance);
+				form(u, match.length)
+				streamDec[u] = longBuffer.getp(distance);
+			}
+			else
+			{
+				if(repeats)
+					repDist.push(match.distance);
 
-			distance = searchBuffer.lastp(match.distance);
-			form(u, match.length)
-			streamDec[u] = searchBuffer.getp(distance);
+				distance = searchBuffer.lastp(match.distance);
+				form(u, match.length)
+				streamDec[u] = searchBuffer.getp(distance);
+			}
 
 			/* len >= 8
 			dist align 4 && .bsz - dist >= m.len
@@ -2073,6 +2459,52 @@ int LzreCoder::initialise(LzreParameters* params)
 	return _m->initialise(params);
 }
 
+void LzreCoder::reset()
+{
+	_m->reset();
+}
+
+wint LzreCoder::memory(LzreParameters* params)
+{
+	byte level = clamp(params->level, 9, 1);
+	wint dictSize = params->dictionary;
+	if(!dictSize)
+		dictSize = 1 << 16 << level - 1;
+	else
+		dictSize = clamp(dictSize, 1 << 28, 1 << 16);
+
+	// search buffer, probability contexts not more 1 << 20
+	wint size = dictSize + (1 << 20) * sizeof(half);
+	if(params->mode == 1)
+	{
+		byte prefix = clamp(params->minMatch ? params->minMatch : 4, 4, 2);
+		uint dictNodes = prefix == 2 ? 1 << 16 : 1 << prefix + 15;
+		int levels[] = {1, 4, 8, 16, 32, 48, 64, 96, 128};
+		uint cycles = params->cycles ? params->cycles : levels[level - 1];
+		byte threads = MAX(params->threads, 1);
+		size += dictSize * sizeof(uint); // search links
+		size += dictNodes * sizeof(LzreDictValue);
+		size += threads * cycles * 2 * sizeof(uint); // found distances of thread
+	}
+	if(level >= 7) // rolz
+		size += (REDTS + REDLS) * sizeof(uint);
+	if(params->window > dictSize) // long window, sampled positions
+	{
+		wint window = MIN(params->window, LONGW);
+		size += window;
+		if(params->mode == 1)
+			size += (window >> 6) * sizeof(LzreLongValue);
+	}
+	if(params->cmix)
+	{
+		if(params->history)
+			size += (1 << 21) * sizeof(StateCounter) + 4 * 256 * sizeof(uint);
+		else
+			size += (1 << 21) * sizeof(Counter);
+	}
+	return size;
+}
+
 int LzreCoder::compress(CoderStream* sm, byte flush)
 {
 	return _m->compress(sm, flush);
@@ -2083,6 +2515,11 @@ int LzreCoder::uncompress(CoderStream* sm, byte flush)
 	return _m->uncompress(sm, flush);
 }
 
+void LzreCoder::setStats(CoderStats* stats)
+{
+	_m->codeStats = stats;
+}
+
 LzreParameters::LzreParameters()
 {
 	mode = 0;
@@ -2095,6 +2532,8 @@ LzreParameters::LzreParameters()
 	suffix = 0;
 	threads = 0;
 	cmix = 0;
+	history = 0;
+	window = 0;
 }
 
 void findMatchThread(byte id)
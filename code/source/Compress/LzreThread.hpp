@@ -114,6 +114,7 @@ RETT search_thread(void* param)
 		elif(state == TS_EXIT)
 		break;
 	}
+	allocatorThreadExit();
 	return 0;
 }
 
@@ -35,6 +35,8 @@ struct ArchiveArg
 	byte  cryptState;
 	String cryptStr;
 	String listFiles;
+	String statsName;  // json of stage times and coder counters
+	String traceName;  // chrome trace of job timeline
 	void* eventCallback; // function pointer
 	byte mode;
 
@@ -49,7 +51,9 @@ struct ArchiveArg
 	byte encodeSuffix;
 	byte encodeBigraph;
 	byte encodeCmix;
-
+	wint encodeMemory; // memory limit of compression
+	uint encodeWindow; // long matches window
+	byte sortSimilar;  // order of files by similar data
 	ArchiveArg()
 	{
 		mode = 0;
@@ -68,6 +72,9 @@ struct ArchiveArg
 		encodeSuffix = 0;
 		encodeBigraph = 0;
 		encodeCmix = 0;
+		encodeMemory = 0;
+		encodeWindow = 0;
+		sortSimilar = 0;
 	}
 	~ArchiveArg()
 	{
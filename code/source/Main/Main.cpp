@@ -17,18 +17,25 @@ limitations under the License.
 #include <Common/StringLib.h>
 #include <Common/Allocator.h>
 #include <Compress/Archive.h>
+#include <Compress/ArchiveStream.h>
+#include <Compress/CoderBenchmark.h>
+#include <Common/FileStream.h>
 #include <Common/FileAccess.h>
 #include <Common/TextStream.h>
+#include <Common/Trace.h>
 #include "ArchiveArg.h"
 #include <Common/Md5.h>
 
 #if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
 #include <Common/platform/swindows.h>
 #include <shellapi.h>
+#include <io.h>
+#include <fcntl.h>
 #elif TAA_PLATFORM == TAA_PLATFORM_LINUX
 #include <unistd.h>
 #include <sys/time.h>
 #endif
+#include <stdio.h>
 
 using namespace tas;
 
@@ -41,6 +48,11 @@ void extractFilesFromArchive();
 void deleteFilesFromArchive();
 void renameFilesInArchive();
 void extractFileList();
+void compressStream();
+void uncompressStream();
+void benchmarkCoders();
+void saveStats(Archive& archive);
+void saveTrace();
 void findModule();
 void parseError();
 
@@ -91,14 +103,23 @@ int main_console(int argc, wchar_t* argv[])
 		arcv->mode = 3;
 	else if(argv[1][0] == 'r')
 		arcv->mode = 4;
-
-	if(arcv->mode > 4)
+	else if(argv[1][0] == 's')
+		arcv->mode = 5;
+	else if(argv[1][0] == 'u')
+		arcv->mode = 6;
+	else if(argv[1][0] == 'b')
+		arcv->mode = 7;
+
+	if(arcv->mode > 7)
 	{
 		arcv->errorNum = 2;
 		return 0;
 	}
 
-	if(arcv->mode and !fileExist(argv[2]))
+	// stream name "-" is stdin or stdout, generated data of benchmark
+	byte pipe = argv[2][0] == '-' and !argv[2][1];
+
+	if(arcv->mode and arcv->mode != 5 and !(arcv->mode >= 6 and pipe) and !fileExist(argv[2]))
 	{
 		arcv->errorNum = 3;
 		return 0;
@@ -108,6 +129,9 @@ int main_console(int argc, wchar_t* argv[])
 	args->mode = arcv->mode;
 	args->savePath = savep;
 	args->archiveName = argv[2];
+	// benchmark of all levels without key
+	if(arcv->mode == 7)
+		args->encodeLevel = 0;
 
 	parserCmdLine(argc, argv);
 	findModule();
@@ -118,18 +142,27 @@ int main_console(int argc, wchar_t* argv[])
 		return 0;
 	}
 
-	if(!arcv->mode and args->encodeMethod > 2)
+	if(!arcv->mode and args->encodeMethod > 3)
+	{
+		arcv->errorNum = 5;
+		return 0;
+	}
+
+	if((arcv->mode == 5 or arcv->mode == 7) and args->encodeMethod > 2)
 	{
 		arcv->errorNum = 5;
 		return 0;
 	}
 
-	if(!arcv->mode and args->encodeLevel > 9)
+	if((!arcv->mode or arcv->mode == 5 or arcv->mode == 7) and args->encodeLevel > 9)
 	{
 		arcv->errorNum = 6;
 		return 0;
 	}
 
+	if(args->traceName.length())
+		traceStart(0);
+
 	if(arcv->mode == 0)
 		appendFilesToArchive();
 	else if(arcv->mode == 1)
@@ -140,8 +173,17 @@ int main_console(int argc, wchar_t* argv[])
 		deleteFilesFromArchive();
 	else if(arcv->mode == 4)
 		renameFilesInArchive();
+	else if(arcv->mode == 5)
+		compressStream();
+	else if(arcv->mode == 6)
+		uncompressStream();
+	else if(arcv->mode == 7)
+		benchmarkCoders();
 
-	if(!arcv->errorNum and arcv->mode != 2)
+	if(args->traceName.length())
+		saveTrace();
+
+	if(!arcv->errorNum and arcv->mode != 2 and arcv->mode < 5)
 		stdprintf("\n\nComplete\n\n");
 
 	return 0;
@@ -156,6 +198,7 @@ int wmain(int argc, wchar_t* argv[])
 	allocatorSetMemorySize(1 * MB, 64 * KB); // 1
 
 	byte err = 0;
+	int ret = 0;
 
 	// wchar_t** argw = CommandLineToArgvW(GetCommandLineW(), &argc);
 	main_console(argc, argv);
@@ -163,6 +206,9 @@ int wmain(int argc, wchar_t* argv[])
 	parseError();
 
 	err = arcv->errorNum;
+	// stdout is data of stream, status is only sign of error
+	if(err and (arcv->mode == 5 or arcv->mode == 6))
+		ret = err;
 
 	safe_delete(args);
 	safe_delete(arcv);
@@ -170,7 +216,7 @@ int wmain(int argc, wchar_t* argv[])
 	if(!err) allocatorInfo();
 	allocatorClean();
 
-	return 0;
+	return ret;
 }
 
 void parseError()
@@ -180,6 +226,15 @@ void parseError()
 		help();
 		return;
 	}
+	// stdout is data of stream
+	if(arcv->errorNum and (arcv->mode == 5 or arcv->mode == 6))
+	{
+		if(arcv->errorNum == 7)
+			fprintf(stderr, "Stream error %u.%u\n%ls\n", arcv->errorNum, arcv->errorNumArc, arcv->errorString.p());
+		else
+			fprintf(stderr, "Stream error %u\n", arcv->errorNum);
+		return;
+	}
 	if(arcv->errorNum)
 	{
 		if(arcv->errorNum < 7)
@@ -247,6 +302,9 @@ void appendFilesToArchive()
 		archive.setValue(args->encodeCmix, 21);
 		archive.setValue(args->encodeSuffix, 15);
 		archive.setValue(args->encodeBigraph, 16);
+		archive.setValue(args->encodeMemory, 22);
+		archive.setValue(args->encodeWindow, 23);
+		archive.setValue(args->sortSimilar, 24);
 	}
 
 	if(args->cryptStr.length())
@@ -268,6 +326,7 @@ void appendFilesToArchive()
 		arcv->errorString = archive.getErrorStr();
 		return;
 	}
+	saveStats(archive);
 }
 
 void extractFilesFromArchive()
@@ -301,6 +360,33 @@ void extractFilesFromArchive()
 		arcv->errorNumArc = archive.getError();
 		return;
 	}
+	saveStats(archive);
+}
+
+void saveStats(Archive& archive)
+{
+	if(!args->statsName.length())
+		return;
+
+	char* text = (char*) archive.getValue(20);
+	uint len = stdlen(text);
+	FileStream file;
+	if(!file.open(args->statsName, 0) or file.storeBuffer(text, len) != len)
+	{
+		arcv->errorString = "Can not write statistics";
+		arcv->errorNum = 7;
+	}
+}
+
+void saveTrace()
+{
+	traceStop();
+	if(!traceSave(args->traceName) and !arcv->errorNum)
+	{
+		arcv->errorString = "Can not write trace";
+		arcv->errorNum = 7;
+	}
+	traceClear();
 }
 
 void deleteFilesFromArchive()
@@ -394,6 +480,120 @@ void extractFileList()
 		return;
 }
 
+void compressStream()
+{
+	ArchiveStream stream;
+	stream.setValue(args->encodeMethod, 0);
+	stream.setValue(args->encodeLevel, 1);
+	stream.setValue(args->encodeThreads, 2);
+	stream.setValue(args->encodeDictSize, 3);
+	stream.setValue(args->encodeWordSize, 4);
+	stream.setValue(args->encodeMatchCycle, 5);
+	stream.setValue(args->encodeMatchMin, 9);
+	stream.setValue(args->encodeMatchRolz, 20);
+	stream.setValue(args->encodeCmix, 21);
+	stream.setValue(args->encodeSuffix, 15);
+
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	FileStream src;
+	FileStream dst;
+	src.setf(stdin, 0);
+	if(args->archiveName.compare(L"-") == 0)
+		dst.setf(stdout, 0);
+	else if(!dst.open(args->archiveName, 0))
+	{
+		arcv->errorString = "Can not create stream";
+		arcv->errorNum = 7;
+		return;
+	}
+
+	if(!stream.compress(src, dst))
+	{
+		arcv->errorString = stream.getErrorStr();
+		arcv->errorNum = 7;
+		arcv->errorNumArc = stream.getError();
+	}
+	fflush(stdout);
+}
+
+void uncompressStream()
+{
+	ArchiveStream stream;
+
+#if TAA_PLATFORM == TAA_PLATFORM_WINDOWS
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	FileStream src;
+	FileStream dst;
+	dst.setf(stdout, 0);
+	if(args->archiveName.compare(L"-") == 0)
+		src.setf(stdin, 0);
+	else if(!src.open(args->archiveName, 1))
+	{
+		arcv->errorString = "Can not open stream";
+		arcv->errorNum = 7;
+		return;
+	}
+
+	if(!stream.uncompress(src, dst))
+	{
+		arcv->errorString = stream.getErrorStr();
+		arcv->errorNum = 7;
+		arcv->errorNumArc = stream.getError();
+	}
+	fflush(stdout);
+}
+
+void benchmarkCoders()
+{
+	CoderBenchmark bench;
+	bench.setValue(args->encodeMethod, 0);
+	bench.setValue(args->encodeLevel, 1);
+	bench.setValue(args->encodeThreads, 2);
+	bench.setValue(args->encodeDictSize, 3);
+	bench.setValue(args->encodeBigraph, 16);
+	bench.setValue(args->encodeCmix, 21);
+
+	if(args->archiveName.compare(L"-") == 0)
+		bench.generate(16 * MB);
+	else if(!bench.load(args->archiveName))
+	{
+		arcv->errorString = bench.getErrorStr();
+		arcv->errorNum = 7;
+		arcv->errorNumArc = bench.getError();
+		return;
+	}
+
+	// table columns by tabs, speed in mb of data per second
+	const char* methods[4] = { "", "lzre", "cm", "bigraph" };
+	stdprintf("method\tlevel\tthreads\tsize\tpacked\tratio\tcompress\tuncompress\tmemory\tcheck\n");
+	uint runs = bench.count();
+	forn(runs)
+	{
+		BenchmarkResult res;
+		if(!bench.run(i, res))
+		{
+			arcv->errorString = bench.getErrorStr();
+			arcv->errorNum = 7;
+			arcv->errorNumArc = bench.getError();
+			return;
+		}
+		double mb = (double) res.size / MB;
+		stdprintf("%s\t%u\t%u\t%u\t%u\t%.3f\t%.2f\t%.2f\t%.1f\t%s\n",
+		          methods[res.method], res.level, res.threads, res.size, res.packedSize,
+		          res.size ? (double) res.packedSize / res.size : 0.0,
+		          mb * 1e6 / MAX(res.compressTime, 1), mb * 1e6 / MAX(res.uncompressTime, 1),
+		          (double) res.memory / MB, res.valid ? "ok" : "fail");
+		fflush(stdout);
+	}
+}
+
 void parserCmdLine(int argc, wchar_t* argv[])
 {
 	String pattern;
@@ -431,15 +631,42 @@ void parserCmdLine(int argc, wchar_t* argv[])
 		else if(CMP("-mr", 3))
 			args->encodeMatchRolz = stdwtoi(arg.p() + 3);
 
+		else if(CMP("-mg", 3)) // 2^n bytes
+			args->encodeWindow = 1 << MIN(stdwtoi(arg.p() + 3), 30);
+
 		else if(CMP("-mx", 3))
 			args->encodeCmix = 1;
 
 		else if(CMP("-bg", 3))
 			args->encodeBigraph = 1;
 
+		else if(CMP("-ss", 3))
+			args->sortSimilar = 1;
+
+		else if(CMP("-st", 3))
+			args->statsName = arg.substr(3);
+
+		else if(CMP("-tr", 3))
+			args->traceName = arg.substr(3);
+
 		else if(CMP("-cr", 3))
 			args->cryptState = stdwtoi(arg.p() + 3);
 
+		else if(CMP("-mem", 4))
+		{
+			// size suffixes k, m, g, mega bytes without suffix
+			String memsz = arg.substr(4);
+			byte len = memsz.length();
+			wint scale = MB;
+			byte suffix = len ? memsz[len - 1] : 0;
+			if(suffix == 'k')
+				scale = KB;
+			else if(suffix == 'g')
+				scale = (wint) MB * KB;
+			if(suffix == 'k' or suffix == 'm' or suffix == 'g')
+				memsz[len - 1] = 0;
+			args->encodeMemory = (wint) stdwtoi(memsz.p()) * scale;
+		}
 		else if(CMP("-md", 3))
 		{
 			// parse size suffixes k, m
@@ -588,7 +815,10 @@ void help()
 	    "  a  Append files to archive\n"
 	    "  e  Extract files from archive with full paths\n"
 	    "  x  Extract files from archive without paths\n"
-	    "  l  List archive contents\n\n"
+	    "  l  List archive contents\n"
+	    "  s  Compress stdin to stream, archive name - is stdout\n"
+	    "  u  Uncompress stream to stdout, archive name - is stdin\n"
+	    "  b  Benchmark of coders on file, name - is generated data\n\n"
 
 	    "Keys\n\n"
 
@@ -598,7 +828,9 @@ void help()
 	    "  -mw<n>  Maximum match length\n"
 	    "  -mn<n>  Minimum match length\n"
 	    "  -mt<n>  Compression threads\n"
-	    "  -mc<n>  Cycles count\n\n"
+	    "  -mc<n>  Cycles count\n"
+	    "  -mg<n>  Long matches window\n"
+	    "  -mem<n> Memory limit\n\n"
 
 	    "For detailed information see readme.txt\n\n"
 